@@ -0,0 +1,197 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Minimal harness shared by the benchmark suite. Each benchmark reports one
+// or more metrics, which are printed as JSON lines so that runs can be
+// collected by scripts, and can be compared against the output of a previous
+// run with --baseline.
+
+#ifndef __ENZEN_BENCH_H__
+#define __ENZEN_BENCH_H__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+template <typename T>
+inline void do_not_optimize(T &value) {
+  asm volatile("" : "+m"(value) : : "memory");
+}
+
+struct measurement {
+  std::string metric;
+  double value;
+  bool higherIsBetter;
+};
+
+using steady_clock = std::chrono::steady_clock;
+
+inline double elapsed_ns(steady_clock::time_point start,
+                         steady_clock::time_point end) {
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+/*
+ * @brief Runs benchmarks and reports their median over a number of
+ * repetitions.
+ *
+ * Options:
+ *   --filter <text>      only run benchmarks whose name contains text
+ *   --repetitions <n>    repetitions of each benchmark, default 5
+ *   --baseline <file>    compare against the output of a previous run
+ *   --threshold <pct>    regression threshold for --baseline, default 10
+ */
+class suite {
+ public:
+  suite(int argc, char **argv) : repetitions_{5}, threshold_{10.0} {
+    for (int i = 1; i < argc; ++i) {
+      auto arg = std::string{argv[i]};
+      auto next = [&]() -> std::string {
+        if (i + 1 >= argc) {
+          std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+          std::exit(2);
+        }
+        return argv[++i];
+      };
+      if (arg == "--filter") {
+        filter_ = next();
+      } else if (arg == "--repetitions") {
+        repetitions_ = std::max(1, std::atoi(next().c_str()));
+      } else if (arg == "--baseline") {
+        load_baseline(next());
+      } else if (arg == "--threshold") {
+        threshold_ = std::atof(next().c_str());
+      } else {
+        std::fprintf(stderr,
+                     "usage: %s [--filter text] [--repetitions n] "
+                     "[--baseline file] [--threshold pct]\n",
+                     argv[0]);
+        std::exit(2);
+      }
+    }
+  }
+
+  /*
+   * @brief Runs a benchmark, which returns the measurements of a single
+   * repetition, and prints the median of each measurement.
+   */
+  template <typename Function>
+  void run(const std::string &name, Function &&function) {
+    if (!filter_.empty() && name.find(filter_) == std::string::npos) {
+      return;
+    }
+
+    auto samples = std::vector<std::vector<measurement>>{};
+    for (int i = 0; i < repetitions_; ++i) {
+      samples.push_back(function());
+    }
+
+    for (std::size_t m = 0; m < samples.front().size(); ++m) {
+      auto values = std::vector<double>{};
+      for (auto &sample : samples) {
+        values.push_back(sample[m].value);
+      }
+      std::sort(values.begin(), values.end());
+      auto result = samples.front()[m];
+      result.value = values[values.size() / 2];
+      report(name, result);
+    }
+  }
+
+  /*
+   * @brief Returns the exit code of the suite, which is non-zero if a
+   * baseline was given and a metric regressed by more than the threshold.
+   */
+  int finish() const {
+    if (!baseline_.empty()) {
+      std::fprintf(stderr, "%d regression(s) beyond %.1f%%\n", regressions_,
+                   threshold_);
+    }
+    return regressions_ == 0 ? 0 : 1;
+  }
+
+ private:
+  void report(const std::string &name, const measurement &result) {
+    std::printf(
+        "{\"benchmark\":\"%s\",\"metric\":\"%s\",\"value\":%.6g,"
+        "\"higher_is_better\":%s}\n",
+        name.c_str(), result.metric.c_str(), result.value,
+        result.higherIsBetter ? "true" : "false");
+    std::fflush(stdout);
+
+    auto baseline = baseline_.find(name + "/" + result.metric);
+    if (baseline == baseline_.end() || baseline->second == 0.0) {
+      return;
+    }
+
+    auto change = (result.value - baseline->second) / baseline->second * 100.0;
+    auto regressed =
+        result.higherIsBetter ? change < -threshold_ : change > threshold_;
+    if (regressed) {
+      ++regressions_;
+    }
+    std::fprintf(stderr, "%-60s %-18s %12.6g -> %12.6g (%+6.1f%%)%s\n",
+                 name.c_str(), result.metric.c_str(), baseline->second,
+                 result.value, change, regressed ? " REGRESSION" : "");
+  }
+
+  static std::string string_field(const std::string &line,
+                                  const std::string &key) {
+    auto start = line.find("\"" + key + "\":\"");
+    if (start == std::string::npos) {
+      return {};
+    }
+    start += key.size() + 4;
+    return line.substr(start, line.find('"', start) - start);
+  }
+
+  void load_baseline(const std::string &path) {
+    auto file = std::ifstream{path};
+    if (!file) {
+      std::fprintf(stderr, "failed to open baseline %s\n", path.c_str());
+      std::exit(2);
+    }
+
+    auto line = std::string{};
+    while (std::getline(file, line)) {
+      auto value = line.find("\"value\":");
+      if (value == std::string::npos) {
+        continue;
+      }
+      baseline_[string_field(line, "benchmark") + "/" +
+                string_field(line, "metric")] =
+          std::atof(line.c_str() + value + 8);
+    }
+  }
+
+  std::string filter_;
+  int repetitions_;
+  double threshold_;
+  int regressions_ = 0;
+  std::map<std::string, double> baseline_;
+};
+
+}  // namespace bench
+
+#endif  // __ENZEN_BENCH_H__
@@ -0,0 +1,139 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Measures the cost of copying executors from many threads at once, as tasks
+// and receivers do when submitting work. Executors refer to their context
+// without reference counting; the shared_ptr case copies a shared_ptr to the
+// same back-end, which is how executors were represented previously, and
+// shows the cost of the reference count's cache line moving between cores.
+// The pool cases submit to one shared thread pool from every thread, copying
+// the executor or a shared_ptr for each submission.
+
+#include <algorithm>
+#include <atomic>
+#include <execution>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+
+namespace {
+
+template <typename Function>
+std::vector<bench::measurement> run_threads(std::size_t numThreads,
+                                            std::size_t iterations,
+                                            Function function) {
+  std::atomic<std::size_t> ready{0};
+  std::atomic<bool> go{false};
+
+  auto threads = std::vector<std::thread>{};
+  for (std::size_t t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&]() {
+      ready.fetch_add(1);
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      for (std::size_t i = 0; i < iterations; ++i) {
+        function();
+      }
+    });
+  }
+  while (ready.load() != numThreads) {
+    std::this_thread::yield();
+  }
+
+  auto start = bench::steady_clock::now();
+  go.store(true);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+
+  return {{"ns_per_copy", elapsed / iterations, false}};
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  constexpr std::size_t iterations = 1000000;
+  constexpr std::size_t poolIterations = 100000;
+
+  auto suite = bench::suite{argc, argv};
+
+  enzen::inline_context inlineContext{};
+  auto exec = inlineContext.executor();
+  auto backend = std::make_shared<int>(0);
+
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+  auto poolExec = enzen::require(threadPool.executor(), enzen::blocking.never);
+  auto executed = std::atomic<std::size_t>{0};
+
+  auto maxThreads =
+      std::max<std::size_t>(2, std::thread::hardware_concurrency());
+  for (std::size_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+    auto threads = "/threads:" + std::to_string(numThreads);
+
+    suite.run("shared_ptr_copy" + threads, [&]() {
+      return run_threads(numThreads, iterations, [&]() {
+        auto copy = backend;
+        bench::do_not_optimize(copy);
+      });
+    });
+
+    suite.run("executor_copy" + threads, [&]() {
+      return run_threads(numThreads, iterations, [&]() {
+        auto copy = exec;
+        bench::do_not_optimize(copy);
+      });
+    });
+
+    suite.run("executor_copy_and_execute" + threads, [&]() {
+      return run_threads(numThreads, iterations, [&]() {
+        auto copy = exec;
+        auto value = 0;
+        copy.execute([&value]() { ++value; });
+        bench::do_not_optimize(value);
+      });
+    });
+
+    suite.run("pool_shared_ptr_copy_and_execute" + threads, [&]() {
+      auto result = run_threads(numThreads, poolIterations, [&]() {
+        auto copy = backend;
+        bench::do_not_optimize(copy);
+        poolExec.execute([&executed]() {
+          executed.fetch_add(1, std::memory_order_relaxed);
+        });
+      });
+      threadPool.wait();
+      return result;
+    });
+
+    suite.run("pool_executor_copy_and_execute" + threads, [&]() {
+      auto result = run_threads(numThreads, poolIterations, [&]() {
+        auto copy = poolExec;
+        copy.execute([&executed]() {
+          executed.fetch_add(1, std::memory_order_relaxed);
+        });
+      });
+      threadPool.wait();
+      return result;
+    });
+  }
+
+  return suite.finish();
+}
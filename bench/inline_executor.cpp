@@ -0,0 +1,73 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Measures the overhead of submitting work through an inline executor
+// compared with calling the same lambda directly.
+
+#include <chrono>
+#include <cstdio>
+#include <execution>
+
+template <typename T>
+inline void do_not_optimize(T &value) {
+  asm volatile("" : "+m"(value) : : "memory");
+}
+
+template <typename Function>
+void run_case(const char *name, std::size_t iterations, Function function) {
+  auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < iterations; ++i) {
+    function();
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  auto elapsed = std::chrono::duration<double, std::nano>(end - start).count();
+
+  std::printf("inline_executor case=%s iterations=%zu ns_per_call=%.3f\n",
+              name, iterations, elapsed / iterations);
+}
+
+int main() {
+  constexpr std::size_t iterations = 10000000;
+
+  enzen::inline_context inlineContext{};
+
+  auto exec = inlineContext.executor();
+  auto twowayExec = enzen::require_concept(exec, enzen::twoway);
+
+  int value = 0;
+
+  auto work = [&value]() {
+    value++;
+    do_not_optimize(value);
+  };
+
+  run_case("bare_lambda", iterations, [&]() { work(); });
+
+  run_case("execute", iterations, [&]() { exec.execute(work); });
+
+  run_case("twoway_execute", iterations / 10, [&]() {
+    auto fut = twowayExec.twoway_execute([&]() {
+      work();
+      return value;
+    });
+    auto result = fut.get();
+    do_not_optimize(result);
+  });
+
+  return 0;
+}
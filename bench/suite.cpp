@@ -0,0 +1,486 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Throughput and latency benchmarks of the static thread pool, its queue and
+// sender pipelines. Prints one JSON line per metric; see bench.h for the
+// options, including comparison against a baseline run.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <execution>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+
+namespace {
+
+std::vector<std::size_t> thread_counts() {
+  auto maxThreads =
+      std::max<std::size_t>(2, std::thread::hardware_concurrency());
+  auto counts = std::vector<std::size_t>{};
+  for (std::size_t count = 1; count < maxThreads; count *= 2) {
+    counts.push_back(count);
+  }
+  counts.push_back(maxThreads);
+  return counts;
+}
+
+std::string param(const std::string &name, std::size_t value) {
+  return "/" + name + ":" + std::to_string(value);
+}
+
+// Empty tasks submitted concurrently by a number of producer threads.
+std::vector<bench::measurement> submit_throughput(
+    std::size_t numProducers, std::size_t tasksPerProducer) {
+  enzen::static_thread_pool threadPool{std::thread::hardware_concurrency()};
+  auto exec = enzen::require(threadPool.executor(), enzen::blocking.never);
+
+  std::atomic<std::size_t> executed{0};
+
+  auto start = bench::steady_clock::now();
+
+  auto producers = std::vector<std::thread>{};
+  for (std::size_t p = 0; p < numProducers; ++p) {
+    producers.emplace_back([&]() {
+      for (std::size_t i = 0; i < tasksPerProducer; ++i) {
+        exec.execute([&executed]() {
+          executed.fetch_add(1, std::memory_order_relaxed);
+        });
+      }
+    });
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  threadPool.wait();
+
+  auto elapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+  auto numTasks = static_cast<double>(executed.load());
+
+  return {{"tasks_per_second", numTasks / elapsed * 1e9, true}};
+}
+
+// Tasks whose closures are too large to be stored inline in the queue, so
+// that each is allocated from the slabs of the pool. Half are submitted from
+// outside the pool and half by tasks running on the workers.
+std::vector<bench::measurement> large_closure_throughput(
+    std::size_t numTasks) {
+  enzen::static_thread_pool threadPool{std::thread::hardware_concurrency()};
+  auto exec = enzen::require(threadPool.executor(), enzen::blocking.never);
+
+  std::atomic<std::size_t> executed{0};
+  auto payload = std::array<std::size_t, 16>{};
+  payload.fill(1);
+
+  auto start = bench::steady_clock::now();
+  for (std::size_t i = 0; i < numTasks / 2; ++i) {
+    exec.execute([&executed, exec, payload]() mutable {
+      executed.fetch_add(payload[0], std::memory_order_relaxed);
+      exec.execute([&executed, payload]() {
+        executed.fetch_add(payload[1], std::memory_order_relaxed);
+      });
+    });
+  }
+  threadPool.wait();
+  auto elapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+
+  auto allocator = threadPool.stats().allocator_totals();
+  return {{"tasks_per_second", executed.load() / elapsed * 1e9, true},
+          {"slabs", static_cast<double>(allocator.slabs), false},
+          {"fallback_allocations",
+           static_cast<double>(allocator.fallback_allocations), false},
+          {"remote_free_rate", allocator.remote_free_rate(), false}};
+}
+
+// Time from submitting a task until a worker starts it, with the pool
+// otherwise idle.
+std::vector<bench::measurement> enqueue_to_start(std::size_t numSamples) {
+  enzen::static_thread_pool threadPool{std::thread::hardware_concurrency()};
+  auto exec = enzen::require(threadPool.executor(), enzen::blocking.never);
+
+  auto latencies = std::vector<double>{};
+  latencies.reserve(numSamples);
+
+  for (std::size_t i = 0; i < numSamples; ++i) {
+    std::atomic<bool> started{false};
+    auto startTime = bench::steady_clock::time_point{};
+
+    auto submitTime = bench::steady_clock::now();
+    exec.execute([&]() {
+      startTime = bench::steady_clock::now();
+      started.store(true, std::memory_order_release);
+    });
+    while (!started.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+
+    latencies.push_back(bench::elapsed_ns(submitTime, startTime));
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  return {{"p50_ns", latencies[latencies.size() / 2], false},
+          {"p99_ns", latencies[latencies.size() * 99 / 100], false}};
+}
+
+std::vector<bench::measurement> bulk_execute_scaling(std::size_t numThreads,
+                                                     std::size_t size) {
+  enzen::static_thread_pool threadPool{numThreads};
+  auto bulkExec = enzen::require(
+      enzen::require_concept(threadPool.executor(), enzen::bulk_oneway),
+      enzen::blocking.never);
+
+  auto data = std::vector<float>(size, 1.0f);
+
+  auto start = bench::steady_clock::now();
+  bulkExec.bulk_execute(
+      [ptr = data.data()](enzen::index<1> idx) { ptr[idx[0]] *= 2.0f; },
+      enzen::shape{size});
+  threadPool.wait();
+  auto elapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+
+  return {{"ns_per_element", elapsed / size, false}};
+}
+
+// saxpy over a vector, invoking the kernel once per index through the
+// pool's type-erased tasks, in per-worker loops with an unsequenced bulk
+// guarantee, and once per contiguous range with range_kernel.
+std::vector<bench::measurement> bulk_range_scaling(std::size_t numThreads,
+                                                   std::size_t size) {
+  enzen::static_thread_pool threadPool{numThreads};
+  auto bulkExec = enzen::require(
+      enzen::require_concept(threadPool.executor(), enzen::bulk_oneway),
+      enzen::blocking.never);
+
+  auto x = std::vector<float>(size, 1.0f);
+  auto y = std::vector<float>(size, 2.0f);
+  auto a = 3.0f;
+
+  auto start = bench::steady_clock::now();
+  bulkExec.bulk_execute(
+      [a, x = x.data(), y = y.data()](enzen::index<1> idx) {
+        y[idx[0]] = a * x[idx[0]] + y[idx[0]];
+      },
+      enzen::shape{size});
+  threadPool.wait();
+  auto indexElapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+
+  start = bench::steady_clock::now();
+  enzen::require(bulkExec, enzen::bulk_guarantee.unsequenced)
+      .bulk_execute(
+          [a, x = x.data(), y = y.data()](enzen::index<1> idx) {
+            y[idx[0]] = a * x[idx[0]] + y[idx[0]];
+          },
+          enzen::shape{size});
+  threadPool.wait();
+  auto unseqElapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+
+  start = bench::steady_clock::now();
+  bulkExec.bulk_execute(
+      enzen::range_kernel(
+          [a, x = x.data(), y = y.data()](enzen::index_range<1> range) {
+            for (auto i = range.begin(); i < range.end(); ++i) {
+              y[i] = a * x[i] + y[i];
+            }
+          }),
+      enzen::shape{size});
+  threadPool.wait();
+  auto rangeElapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+  bench::do_not_optimize(y);
+
+  return {{"index_elements_per_s", size * 1e9 / indexElapsed, true},
+          {"unsequenced_elements_per_s", size * 1e9 / unseqElapsed, true},
+          {"range_elements_per_s", size * 1e9 / rangeElapsed, true}};
+}
+
+// Transpose of a square matrix, with one index per element through a tiled
+// mapping, and with a group kernel staging each tile in scratch memory so that
+// both the reads and the writes of a tile are contiguous.
+std::vector<bench::measurement> group_transpose_scaling(std::size_t numThreads,
+                                                        std::size_t edge) {
+  constexpr std::size_t tile = 32;
+  enzen::static_thread_pool threadPool{numThreads};
+  auto bulkExec = enzen::require(
+      enzen::require_concept(threadPool.executor(), enzen::bulk_oneway),
+      enzen::blocking.never);
+
+  auto in = std::vector<float>(edge * edge, 1.0f);
+  auto out = std::vector<float>(edge * edge);
+
+  auto start = bench::steady_clock::now();
+  enzen::require(bulkExec, enzen::mapping.tiled(tile, tile))
+      .bulk_execute(
+          [edge, in = in.data(), out = out.data()](enzen::index<2> idx) {
+            out[idx[1] * edge + idx[0]] = in[idx.linear_id()];
+          },
+          enzen::shape{edge, edge});
+  threadPool.wait();
+  auto tiledElapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+
+  start = bench::steady_clock::now();
+  bulkExec.bulk_execute(
+      enzen::group_kernel(
+          enzen::shape{tile, tile}, tile * tile * sizeof(float),
+          [edge, in = in.data(), out = out.data()](const enzen::group<2> &g) {
+            auto *scratch = g.scratch<float>();
+            g.for_each_item([&](enzen::index<2> local, enzen::index<2> idx) {
+              scratch[local[1] * tile + local[0]] = in[idx.linear_id()];
+            });
+            enzen::group_barrier(g);
+            auto origin0 = g.group_id()[0] * tile;
+            auto origin1 = g.group_id()[1] * tile;
+            auto range = g.local_range();
+            for (std::size_t j = 0; j < range[1]; ++j) {
+              for (std::size_t i = 0; i < range[0]; ++i) {
+                out[(origin1 + j) * edge + origin0 + i] =
+                    scratch[j * tile + i];
+              }
+            }
+          }),
+      enzen::shape{edge, edge});
+  threadPool.wait();
+  auto groupElapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+  bench::do_not_optimize(out);
+
+  auto size = edge * edge;
+  return {{"tiled_elements_per_s", size * 1e9 / tiledElapsed, true},
+          {"group_elements_per_s", size * 1e9 / groupElapsed, true}};
+}
+
+// Sum of a vector with enzen::reduce, which reduces one range per worker,
+// compared against a per-element bulk_execute adding to an atomic.
+std::vector<bench::measurement> reduce_scaling(std::size_t numThreads,
+                                               std::size_t size) {
+  enzen::static_thread_pool threadPool{numThreads};
+  auto exec = threadPool.executor();
+  auto bulkExec = enzen::require(
+      enzen::require_concept(exec, enzen::bulk_oneway), enzen::blocking.never);
+
+  auto data = std::vector<long>(size, 1);
+
+  auto start = bench::steady_clock::now();
+  auto sum = enzen::reduce(exec, data.begin(), data.end(), 0L);
+  auto reduceElapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+  bench::do_not_optimize(sum);
+
+  std::atomic<long> atomicSum{0};
+  start = bench::steady_clock::now();
+  bulkExec.bulk_execute(
+      [&atomicSum, ptr = data.data()](enzen::index<1> idx) {
+        atomicSum.fetch_add(ptr[idx[0]], std::memory_order_relaxed);
+      },
+      enzen::shape{size});
+  threadPool.wait();
+  auto atomicElapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+
+  return {{"reduce_ns_per_element", reduceElapsed / size, false},
+          {"atomic_ns_per_element", atomicElapsed / size, false}};
+}
+
+// Threads each pushing and popping on a shared concurrent_queue.
+std::vector<bench::measurement> queue_contention(std::size_t numThreads,
+                                                 std::size_t opsPerThread) {
+  enzen::concurrent_queue<int> queue;
+
+  auto start = bench::steady_clock::now();
+
+  auto threads = std::vector<std::thread>{};
+  for (std::size_t t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&]() {
+      auto value = 0;
+      for (std::size_t i = 0; i < opsPerThread; ++i) {
+        queue.push(static_cast<int>(i));
+        queue.try_pop(value);
+      }
+      bench::do_not_optimize(value);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  auto elapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+  auto numOps = static_cast<double>(2 * numThreads * opsPerThread);
+
+  return {{"ops_per_second", numOps / elapsed * 1e9, true}};
+}
+
+// Round trip of a twoway_execute and future get, with the shared state of the
+// future allocated by the given allocator.
+template <typename ProtoAllocator>
+std::vector<bench::measurement> future_round_trip(std::size_t iterations,
+                                                  const ProtoAllocator &alloc) {
+  enzen::static_thread_pool threadPool{std::thread::hardware_concurrency()};
+  auto twowayExec = enzen::require(
+      enzen::require(
+          enzen::require_concept(threadPool.executor(), enzen::twoway),
+          enzen::blocking.never),
+      enzen::allocator(alloc));
+
+  auto start = bench::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i) {
+    auto fut = twowayExec.twoway_execute([i]() { return i; });
+    auto result = fut.get();
+    bench::do_not_optimize(result);
+  }
+  auto elapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+
+  return {{"ns_per_round_trip", elapsed / iterations, false}};
+}
+
+template <std::size_t Depth, typename Task>
+auto make_transform_chain(Task task) {
+  if constexpr (Depth == 0) {
+    return task;
+  } else {
+    return make_transform_chain<Depth - 1>(
+        enzen::transform(std::move(task), [](int value) { return value + 1; }));
+  }
+}
+
+// Latency of sync_get on a via followed by a chain of transforms.
+template <std::size_t Depth>
+std::vector<bench::measurement> transform_chain(std::size_t iterations) {
+  enzen::static_thread_pool threadPool{std::thread::hardware_concurrency()};
+  auto lazyExec = enzen::require(
+      enzen::require_concept(threadPool.executor(), enzen::lazy),
+      enzen::blocking.never);
+
+  auto start = bench::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i) {
+    auto result = enzen::sync_get(
+        make_transform_chain<Depth>(enzen::via(lazyExec, enzen::just(0))));
+    bench::do_not_optimize(result);
+  }
+  auto elapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+
+  return {{"ns_per_pipeline", elapsed / iterations, false}};
+}
+
+// Three elementwise stages over vectors too large for the cache, fused into
+// one bulk operation, and run as separate operations by marking the later
+// stages non-pointwise.
+std::vector<bench::measurement> bulk_fusion_scaling(std::size_t numThreads,
+                                                    std::size_t size) {
+  enzen::static_thread_pool threadPool{numThreads};
+  auto lazyExec = enzen::require_concept(
+      enzen::require(threadPool.executor(), enzen::bulk_guarantee.unsequenced),
+      enzen::lazy);
+
+  auto x = std::vector<float>(size, 1.0f);
+  auto y = std::vector<float>(size, 2.0f);
+  auto scale = [x = x.data()](enzen::index<1> idx, float a) {
+    x[idx[0]] *= a;
+  };
+  auto axpy = [x = x.data(), y = y.data()](enzen::index<1> idx, float a) {
+    y[idx[0]] += a * x[idx[0]];
+  };
+  auto clamp = [y = y.data()](enzen::index<1> idx, float) {
+    y[idx[0]] = std::min(y[idx[0]], 1e6f);
+  };
+
+  auto start = bench::steady_clock::now();
+  enzen::sync_wait(enzen::via(lazyExec, enzen::just(1.0f)) |
+                   enzen::bulk(enzen::shape{size}, scale) |
+                   enzen::bulk(enzen::shape{size}, axpy) |
+                   enzen::bulk(enzen::shape{size}, clamp));
+  auto fusedElapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+
+  start = bench::steady_clock::now();
+  enzen::sync_wait(
+      enzen::via(lazyExec, enzen::just(1.0f)) |
+      enzen::bulk(enzen::shape{size}, scale) |
+      enzen::bulk(enzen::shape{size}, enzen::non_pointwise(axpy)) |
+      enzen::bulk(enzen::shape{size}, enzen::non_pointwise(clamp)));
+  auto separateElapsed = bench::elapsed_ns(start, bench::steady_clock::now());
+  bench::do_not_optimize(y);
+
+  return {{"fused_elements_per_s", size * 1e9 / fusedElapsed, true},
+          {"separate_elements_per_s", size * 1e9 / separateElapsed, true}};
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  auto suite = bench::suite{argc, argv};
+
+  for (auto numProducers : thread_counts()) {
+    suite.run("submit_throughput" + param("producers", numProducers),
+              [=]() { return submit_throughput(numProducers, 100000); });
+  }
+
+  suite.run("large_closure_throughput",
+            []() { return large_closure_throughput(200000); });
+
+  suite.run("enqueue_to_start", []() { return enqueue_to_start(10000); });
+
+  for (auto numThreads : thread_counts()) {
+    for (std::size_t size : {1024, 16384, 131072}) {
+      suite.run("bulk_execute" + param("threads", numThreads) +
+                    param("size", size),
+                [=]() { return bulk_execute_scaling(numThreads, size); });
+    }
+  }
+
+  for (auto numThreads : thread_counts()) {
+    for (std::size_t size : {16384, 1048576}) {
+      suite.run("bulk_range" + param("threads", numThreads) +
+                    param("size", size),
+                [=]() { return bulk_range_scaling(numThreads, size); });
+    }
+  }
+
+  for (auto numThreads : thread_counts()) {
+    suite.run("bulk_fusion" + param("threads", numThreads) +
+                  param("size", 8388608),
+              [=]() { return bulk_fusion_scaling(numThreads, 8388608); });
+  }
+
+  for (auto numThreads : thread_counts()) {
+    suite.run("group_transpose" + param("threads", numThreads) +
+                  param("edge", 2048),
+              [=]() { return group_transpose_scaling(numThreads, 2048); });
+  }
+
+  for (auto numThreads : thread_counts()) {
+    suite.run("reduce" + param("threads", numThreads) + param("size", 131072),
+              [=]() { return reduce_scaling(numThreads, 131072); });
+  }
+
+  for (auto numThreads : thread_counts()) {
+    suite.run("queue_contention" + param("threads", numThreads),
+              [=]() { return queue_contention(numThreads, 100000); });
+  }
+
+  suite.run("future_round_trip", []() {
+    return future_round_trip(10000, std::allocator<void>{});
+  });
+  suite.run("future_round_trip/allocator:arena", []() {
+    return future_round_trip(10000, enzen::arena_allocator<void>{});
+  });
+
+  suite.run("transform_chain" + param("depth", 1),
+            []() { return transform_chain<1>(10000); });
+  suite.run("transform_chain" + param("depth", 4),
+            []() { return transform_chain<4>(10000); });
+  suite.run("transform_chain" + param("depth", 16),
+            []() { return transform_chain<16>(10000); });
+
+  return suite.finish();
+}
@@ -0,0 +1,99 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Measures the cost of submitting via/transform pipelines of increasing
+// depth. Built twice: bench_transform_chain with transform fusion enabled and
+// bench_transform_chain_unfused with ENZEN_NO_TRANSFORM_FUSION defined.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <execution>
+#include <thread>
+
+class counting_receiver {
+ public:
+  counting_receiver(std::atomic<int> *sumPtr) : sumPtr_{sumPtr} {}
+
+  void value(int value) {
+    sumPtr_->fetch_add(value, std::memory_order_relaxed);
+  }
+
+  template <typename Error>
+  void error(Error &&error) noexcept {}
+
+  void done() {}
+
+ private:
+  std::atomic<int> *sumPtr_;
+};
+
+template <std::size_t Depth, typename Task>
+auto make_transform_chain(Task task) {
+  if constexpr (Depth == 0) {
+    return task;
+  } else {
+    return make_transform_chain<Depth - 1>(
+        enzen::transform(std::move(task), [](int value) { return value + 1; }));
+  }
+}
+
+template <std::size_t Depth, typename Executor>
+void run_transform_chain(enzen::static_thread_pool &threadPool, Executor exec,
+                         std::size_t numPipelines) {
+  std::atomic<int> sum{0};
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < numPipelines; ++i) {
+    auto pipeline =
+        make_transform_chain<Depth>(enzen::via(exec, enzen::just(0)));
+    enzen::submit(std::move(pipeline), counting_receiver{&sum});
+  }
+
+  threadPool.wait();
+
+  auto end = std::chrono::steady_clock::now();
+  auto elapsed = std::chrono::duration<double, std::nano>(end - start).count();
+
+#ifdef ENZEN_NO_TRANSFORM_FUSION
+  constexpr bool fused = false;
+#else
+  constexpr bool fused = true;
+#endif  // ENZEN_NO_TRANSFORM_FUSION
+
+  std::printf(
+      "transform_chain depth=%zu fused=%d pipelines=%zu "
+      "ns_per_pipeline=%.1f valid=%d\n",
+      Depth, fused, numPipelines, elapsed / numPipelines,
+      sum.load() == static_cast<int>(Depth * numPipelines));
+}
+
+int main() {
+  constexpr std::size_t numPipelines = 100000;
+
+  enzen::static_thread_pool threadPool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require(
+      enzen::require_concept(threadPool.executor(), enzen::lazy),
+      enzen::blocking.never);
+
+  run_transform_chain<1>(threadPool, lazyExec, numPipelines);
+  run_transform_chain<4>(threadPool, lazyExec, numPipelines);
+  run_transform_chain<16>(threadPool, lazyExec, numPipelines);
+
+  return 0;
+}
@@ -21,6 +21,10 @@ function(add_enzen_test test useSYCL)
     target_link_libraries("test_${test}" PRIVATE ${Hwloc_LIBRARIES})
     set_target_properties("test_${test}" PROPERTIES CXX_STANDARD 17 CXX_STANDARD_REQUIRED ON)
 
+    if (ENZEN_USDT)
+        target_compile_definitions("test_${test}" PRIVATE ENZEN_USDT)
+    endif()
+
     if (useSYCL)
         add_sycl_to_target(
           TARGET "test_${test}"
@@ -29,4 +33,17 @@ function(add_enzen_test test useSYCL)
     endif()
 
     add_test("test_${test}" "test_${test}")
-endfunction()
\ No newline at end of file
+endfunction()
+
+function(add_enzen_benchmark bench source)
+	add_executable("bench_${bench}" "${source}")
+    target_include_directories("bench_${bench}" PRIVATE ${PROJECT_SOURCE_DIR}/include ${PROJECT_SOURCE_DIR}/external/propria/include ${Hwloc_INCLUDE_DIRS})
+	target_link_libraries("bench_${bench}" PRIVATE Threads::Threads)
+    target_link_libraries("bench_${bench}" PRIVATE ${Hwloc_LIBRARIES})
+    target_compile_definitions("bench_${bench}" PRIVATE ${ARGN})
+    set_target_properties("bench_${bench}" PROPERTIES CXX_STANDARD 17 CXX_STANDARD_REQUIRED ON)
+
+    if (ENZEN_USDT)
+        target_compile_definitions("bench_${bench}" PRIVATE ENZEN_USDT)
+    endif()
+endfunction()
@@ -0,0 +1,426 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_ALGORITHM_H__
+#define __ENZEN_ALGORITHM_H__
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace enzen {
+
+namespace detail {
+
+template <typename Iterator>
+inline constexpr bool is_random_access_iterator_v = std::is_base_of_v<
+    std::random_access_iterator_tag,
+    typename std::iterator_traits<Iterator>::iterator_category>;
+
+/*
+ * @brief Value computed by a single chunk of an algorithm, padded to a cache
+ * line so that workers writing neighbouring partials do not contend.
+ */
+template <typename T>
+struct alignas(64) chunk_partial {
+  std::optional<T> value;
+};
+
+/*
+ * @brief Returns the number of chunks to split numElements over, one per
+ * worker of the executor's context so that each worker computes a single
+ * partial.
+ */
+template <typename Executor>
+std::size_t num_chunks(const Executor &exec, std::size_t numElements) {
+  return std::min(numElements, exec.get_impl()->num_workers());
+}
+
+/*
+ * @brief Invokes function(chunk, begin, end) for each of numChunks chunks of
+ * [0, numElements) with a single always blocking bulk_execute on exec, one
+ * index per chunk rather than per element. The first exception thrown by any
+ * chunk is rethrown once all chunks have completed.
+ */
+template <typename Executor, typename Function>
+void bulk_for_each_chunk(const Executor &exec, std::size_t numElements,
+                         std::size_t numChunks, Function function) {
+  if (numChunks == 0) {
+    return;
+  }
+
+  auto bulkExec =
+      enzen::require(enzen::require_concept(exec, enzen::bulk_oneway),
+                     enzen::blocking.always);
+
+  auto failed = std::atomic<bool>{false};
+  auto exception = std::exception_ptr{};
+
+  bulkExec.bulk_execute(
+      [&function, &failed, &exception, numElements,
+       numChunks](enzen::index<1> idx) {
+        try {
+          auto chunk = idx.linear_id();
+          auto [begin, end] = chunk_bounds(numElements, numChunks, chunk);
+          function(chunk, begin, end);
+        } catch (...) {
+          if (!failed.exchange(true, std::memory_order_relaxed)) {
+            exception = std::current_exception();
+          }
+        }
+      },
+      enzen::shape{numChunks});
+
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+}  // namespace detail
+
+/*
+ * @brief Invokes function with every element of [first, last), split into one
+ * contiguous range per worker of exec.
+ * @param exec Executor used as the execution policy.
+ * @param first Beginning of the range.
+ * @param last End of the range.
+ * @param function Function invoked as function(element).
+ */
+template <typename Executor, typename Iterator, typename Function>
+void for_each(const Executor &exec, Iterator first, Iterator last,
+              Function function) {
+  static_assert(detail::is_random_access_iterator_v<Iterator>,
+                "enzen algorithms require random access iterators.");
+
+  auto numElements = static_cast<std::size_t>(std::distance(first, last));
+  detail::bulk_for_each_chunk(
+      exec, numElements, detail::num_chunks(exec, numElements),
+      [&](std::size_t, std::size_t begin, std::size_t end) {
+        std::for_each(first + begin, first + end, function);
+      });
+}
+
+/*
+ * @brief Writes op(element) for every element of [first, last) to the range
+ * beginning at dFirst.
+ * @return Iterator to the element past the last element written.
+ */
+template <typename Executor, typename InputIterator, typename OutputIterator,
+          typename UnaryOperation>
+OutputIterator transform(const Executor &exec, InputIterator first,
+                         InputIterator last, OutputIterator dFirst,
+                         UnaryOperation op) {
+  static_assert(detail::is_random_access_iterator_v<InputIterator> &&
+                    detail::is_random_access_iterator_v<OutputIterator>,
+                "enzen algorithms require random access iterators.");
+
+  auto numElements = static_cast<std::size_t>(std::distance(first, last));
+  detail::bulk_for_each_chunk(
+      exec, numElements, detail::num_chunks(exec, numElements),
+      [&](std::size_t, std::size_t begin, std::size_t end) {
+        std::transform(first + begin, first + end, dFirst + begin, op);
+      });
+  return dFirst + numElements;
+}
+
+/*
+ * @brief Writes op(element1, element2) for every pair of elements of
+ * [first1, last1) and the range beginning at first2 to the range beginning at
+ * dFirst.
+ * @return Iterator to the element past the last element written.
+ */
+template <typename Executor, typename InputIterator1, typename InputIterator2,
+          typename OutputIterator, typename BinaryOperation>
+OutputIterator transform(const Executor &exec, InputIterator1 first1,
+                         InputIterator1 last1, InputIterator2 first2,
+                         OutputIterator dFirst, BinaryOperation op) {
+  static_assert(detail::is_random_access_iterator_v<InputIterator1> &&
+                    detail::is_random_access_iterator_v<InputIterator2> &&
+                    detail::is_random_access_iterator_v<OutputIterator>,
+                "enzen algorithms require random access iterators.");
+
+  auto numElements = static_cast<std::size_t>(std::distance(first1, last1));
+  detail::bulk_for_each_chunk(
+      exec, numElements, detail::num_chunks(exec, numElements),
+      [&](std::size_t, std::size_t begin, std::size_t end) {
+        std::transform(first1 + begin, first1 + end, first2 + begin,
+                       dFirst + begin, op);
+      });
+  return dFirst + numElements;
+}
+
+/*
+ * @brief Reduces transform(element) for every element of [first, last) and
+ * init with reduce. Each worker reduces its own range to a partial, and the
+ * partials are then reduced in order on the calling thread, so reduce must be
+ * associative but need not be commutative.
+ * @return The reduced value.
+ */
+template <typename Executor, typename Iterator, typename T,
+          typename BinaryOperation, typename UnaryOperation>
+T transform_reduce(const Executor &exec, Iterator first, Iterator last, T init,
+                   BinaryOperation reduce, UnaryOperation transform) {
+  static_assert(detail::is_random_access_iterator_v<Iterator>,
+                "enzen algorithms require random access iterators.");
+
+  auto numElements = static_cast<std::size_t>(std::distance(first, last));
+  auto numChunks = detail::num_chunks(exec, numElements);
+  auto partials = std::vector<detail::chunk_partial<T>>(numChunks);
+
+  detail::bulk_for_each_chunk(
+      exec, numElements, numChunks,
+      [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        auto partial = T(std::invoke(transform, *(first + begin)));
+        for (auto i = begin + 1; i < end; ++i) {
+          partial = std::invoke(reduce, std::move(partial),
+                                std::invoke(transform, *(first + i)));
+        }
+        partials[chunk].value.emplace(std::move(partial));
+      });
+
+  for (auto &partial : partials) {
+    init = std::invoke(reduce, std::move(init), std::move(*partial.value));
+  }
+  return init;
+}
+
+/*
+ * @brief Reduces transform(element1, element2) for every pair of elements of
+ * [first1, last1) and the range beginning at first2, and init, with reduce.
+ * @return The reduced value.
+ */
+template <typename Executor, typename Iterator1, typename Iterator2,
+          typename T, typename BinaryOperation1, typename BinaryOperation2>
+T transform_reduce(const Executor &exec, Iterator1 first1, Iterator1 last1,
+                   Iterator2 first2, T init, BinaryOperation1 reduce,
+                   BinaryOperation2 transform) {
+  static_assert(detail::is_random_access_iterator_v<Iterator1> &&
+                    detail::is_random_access_iterator_v<Iterator2>,
+                "enzen algorithms require random access iterators.");
+
+  auto numElements = static_cast<std::size_t>(std::distance(first1, last1));
+  auto numChunks = detail::num_chunks(exec, numElements);
+  auto partials = std::vector<detail::chunk_partial<T>>(numChunks);
+
+  detail::bulk_for_each_chunk(
+      exec, numElements, numChunks,
+      [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        auto partial =
+            T(std::invoke(transform, *(first1 + begin), *(first2 + begin)));
+        for (auto i = begin + 1; i < end; ++i) {
+          partial = std::invoke(
+              reduce, std::move(partial),
+              std::invoke(transform, *(first1 + i), *(first2 + i)));
+        }
+        partials[chunk].value.emplace(std::move(partial));
+      });
+
+  for (auto &partial : partials) {
+    init = std::invoke(reduce, std::move(init), std::move(*partial.value));
+  }
+  return init;
+}
+
+/*
+ * @brief Returns the sum of the products of the elements of [first1, last1)
+ * and the range beginning at first2, added to init.
+ */
+template <typename Executor, typename Iterator1, typename Iterator2,
+          typename T>
+T transform_reduce(const Executor &exec, Iterator1 first1, Iterator1 last1,
+                   Iterator2 first2, T init) {
+  return enzen::transform_reduce(exec, first1, last1, first2, std::move(init),
+                                 std::plus<>{}, std::multiplies<>{});
+}
+
+/*
+ * @brief Reduces every element of [first, last) and init with op, which must
+ * be associative.
+ * @return The reduced value.
+ */
+template <typename Executor, typename Iterator, typename T,
+          typename BinaryOperation = std::plus<>>
+T reduce(const Executor &exec, Iterator first, Iterator last, T init,
+         BinaryOperation op = {}) {
+  return enzen::transform_reduce(
+      exec, first, last, std::move(init), op,
+      [](auto &&element) -> decltype(auto) {
+        return static_cast<decltype(element) &&>(element);
+      });
+}
+
+/*
+ * @brief Writes the inclusive prefix reduction of [first, last) with op to the
+ * range beginning at dFirst. Each worker first reduces its range, the
+ * partials are then scanned on the calling thread, and each worker finally
+ * scans its range starting from the partial of the ranges before it.
+ * @return Iterator to the element past the last element written.
+ */
+template <typename Executor, typename InputIterator, typename OutputIterator,
+          typename BinaryOperation = std::plus<>>
+OutputIterator inclusive_scan(const Executor &exec, InputIterator first,
+                              InputIterator last, OutputIterator dFirst,
+                              BinaryOperation op = {}) {
+  static_assert(detail::is_random_access_iterator_v<InputIterator> &&
+                    detail::is_random_access_iterator_v<OutputIterator>,
+                "enzen algorithms require random access iterators.");
+
+  using value_t = typename std::iterator_traits<InputIterator>::value_type;
+
+  auto numElements = static_cast<std::size_t>(std::distance(first, last));
+  auto numChunks = detail::num_chunks(exec, numElements);
+  auto partials = std::vector<detail::chunk_partial<value_t>>(numChunks);
+
+  detail::bulk_for_each_chunk(
+      exec, numElements, numChunks,
+      [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        auto partial = value_t(*(first + begin));
+        for (auto i = begin + 1; i < end; ++i) {
+          partial = std::invoke(op, std::move(partial), *(first + i));
+        }
+        partials[chunk].value.emplace(std::move(partial));
+      });
+
+  // Replace each partial with the reduction of all the ranges before it.
+  for (std::size_t chunk = 1; chunk + 1 < numChunks; ++chunk) {
+    partials[chunk].value = std::invoke(op, *partials[chunk - 1].value,
+                                        std::move(*partials[chunk].value));
+  }
+
+  detail::bulk_for_each_chunk(
+      exec, numElements, numChunks,
+      [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        if (chunk == 0) {
+          std::inclusive_scan(first + begin, first + end, dFirst + begin, op);
+        } else {
+          std::inclusive_scan(first + begin, first + end, dFirst + begin, op,
+                              *partials[chunk - 1].value);
+        }
+      });
+  return dFirst + numElements;
+}
+
+/*
+ * @brief Sorts [first, last) with comp. Each worker sorts its own range, and
+ * neighbouring ranges are then merged in pairs, in parallel, until a single
+ * range remains.
+ */
+template <typename Executor, typename Iterator,
+          typename Compare = std::less<>>
+void sort(const Executor &exec, Iterator first, Iterator last,
+          Compare comp = {}) {
+  static_assert(detail::is_random_access_iterator_v<Iterator>,
+                "enzen algorithms require random access iterators.");
+
+  auto numElements = static_cast<std::size_t>(std::distance(first, last));
+  auto numChunks = detail::num_chunks(exec, numElements);
+
+  auto bounds = std::vector<std::size_t>{};
+  for (std::size_t chunk = 0; chunk < numChunks; ++chunk) {
+    bounds.push_back(detail::chunk_bounds(numElements, numChunks, chunk).first);
+  }
+  bounds.push_back(numElements);
+
+  detail::bulk_for_each_chunk(
+      exec, numElements, numChunks,
+      [&](std::size_t, std::size_t begin, std::size_t end) {
+        std::sort(first + begin, first + end, comp);
+      });
+
+  while (bounds.size() > 2) {
+    auto numRanges = bounds.size() - 1;
+    auto numMerges = numRanges / 2;
+    detail::bulk_for_each_chunk(
+        exec, numMerges, numMerges,
+        [&](std::size_t merge, std::size_t, std::size_t) {
+          std::inplace_merge(first + bounds[2 * merge],
+                             first + bounds[2 * merge + 1],
+                             first + bounds[2 * merge + 2], comp);
+        });
+
+    auto merged = std::vector<std::size_t>{};
+    for (std::size_t i = 0; i < bounds.size(); i += 2) {
+      merged.push_back(bounds[i]);
+    }
+    if (merged.back() != numElements) {
+      merged.push_back(numElements);
+    }
+    bounds = std::move(merged);
+  }
+}
+
+/*
+ * @brief Copies the elements of [first, last) for which pred returns true to
+ * the range beginning at dFirst, preserving their order. Each worker first
+ * evaluates pred over its range and counts its matches, the counts are then
+ * scanned on the calling thread to find where each range's output begins,
+ * and each worker finally copies its matches.
+ * @return Iterator to the element past the last element written.
+ */
+template <typename Executor, typename InputIterator, typename OutputIterator,
+          typename Predicate>
+OutputIterator copy_if(const Executor &exec, InputIterator first,
+                       InputIterator last, OutputIterator dFirst,
+                       Predicate pred) {
+  static_assert(detail::is_random_access_iterator_v<InputIterator> &&
+                    detail::is_random_access_iterator_v<OutputIterator>,
+                "enzen algorithms require random access iterators.");
+
+  auto numElements = static_cast<std::size_t>(std::distance(first, last));
+  auto numChunks = detail::num_chunks(exec, numElements);
+  auto counts = std::vector<detail::chunk_partial<std::size_t>>(numChunks);
+  auto selected = std::vector<unsigned char>(numElements);
+
+  detail::bulk_for_each_chunk(
+      exec, numElements, numChunks,
+      [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        auto count = std::size_t{0};
+        for (auto i = begin; i < end; ++i) {
+          selected[i] = static_cast<bool>(std::invoke(pred, *(first + i)));
+          count += selected[i];
+        }
+        counts[chunk].value.emplace(count);
+      });
+
+  // Replace each count with the number of matches in the ranges before it.
+  auto total = std::size_t{0};
+  for (auto &count : counts) {
+    total += std::exchange(*count.value, total);
+  }
+
+  detail::bulk_for_each_chunk(
+      exec, numElements, numChunks,
+      [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        auto out = dFirst + *counts[chunk].value;
+        for (auto i = begin; i < end; ++i) {
+          if (selected[i]) {
+            *out++ = *(first + i);
+          }
+        }
+      });
+  return dFirst + total;
+}
+
+}  // namespace enzen
+
+#endif  // __ENZEN_ALGORITHM_H__
@@ -0,0 +1,318 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_ARENA_ALLOCATOR_H__
+#define __ENZEN_ARENA_ALLOCATOR_H__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace enzen {
+
+namespace detail {
+
+template <typename ProtoAllocator, typename T>
+using rebind_alloc_t =
+    typename std::allocator_traits<ProtoAllocator>::template rebind_alloc<T>;
+
+/*
+ * @brief Allocates and constructs a single object with an allocator rebound
+ * to its type.
+ */
+template <typename T, typename ProtoAllocator, typename... Args>
+T *allocate_object(const ProtoAllocator &protoAlloc, Args &&... args) {
+  using alloc_t = rebind_alloc_t<ProtoAllocator, T>;
+  using traits_t = std::allocator_traits<alloc_t>;
+
+  auto alloc = alloc_t{protoAlloc};
+  auto ptr = traits_t::allocate(alloc, 1);
+  try {
+    traits_t::construct(alloc, ptr, std::forward<Args>(args)...);
+  } catch (...) {
+    traits_t::deallocate(alloc, ptr, 1);
+    throw;
+  }
+  return ptr;
+}
+
+/*
+ * @brief Destroys and deallocates an object allocated with allocate_object.
+ */
+template <typename T, typename ProtoAllocator>
+void deallocate_object(const ProtoAllocator &protoAlloc, T *ptr) noexcept {
+  using alloc_t = rebind_alloc_t<ProtoAllocator, T>;
+  using traits_t = std::allocator_traits<alloc_t>;
+
+  auto alloc = alloc_t{protoAlloc};
+  traits_t::destroy(alloc, ptr);
+  traits_t::deallocate(alloc, ptr, 1);
+}
+
+/*
+ * @brief Blocks and free lists shared between the arenas of all threads.
+ * Blocks are only released when the program exits, so memory allocated by
+ * one thread may be freed by any other.
+ */
+class arena_depot {
+ public:
+  struct batch {
+    void *head;
+    std::size_t count;
+  };
+
+  static constexpr std::size_t num_size_classes = 7;
+
+  static arena_depot &get() {
+    static arena_depot depot;
+    return depot;
+  }
+
+  void *allocate_block(std::size_t size) {
+    auto block = std::unique_ptr<std::byte[]>{new std::byte[size]};
+    auto ptr = static_cast<void *>(block.get());
+    auto lock = std::lock_guard<std::mutex>{mutex_};
+    blocks_.push_back(std::move(block));
+    return ptr;
+  }
+
+  void push_batch(std::size_t sizeClass, batch freed) {
+    auto lock = std::lock_guard<std::mutex>{mutex_};
+    batches_[sizeClass].push_back(freed);
+  }
+
+  bool try_pop_batch(std::size_t sizeClass, batch &reused) {
+    auto lock = std::lock_guard<std::mutex>{mutex_};
+    auto &batches = batches_[sizeClass];
+    if (batches.empty()) {
+      return false;
+    }
+    reused = batches.back();
+    batches.pop_back();
+    return true;
+  }
+
+ private:
+  arena_depot() = default;
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<std::byte[]>> blocks_;
+  std::array<std::vector<batch>, num_size_classes> batches_;
+};
+
+/*
+ * @brief Arena of the calling thread. Allocations are rounded up to a power
+ * of two size class and served from a free list of that class, or else bumped
+ * from the current block. Frees push onto the free list of the freeing
+ * thread, which hands surplus entries to the depot in batches, so that memory
+ * freed by consumer threads flows back to producer threads without locking on
+ * every allocation.
+ */
+class arena {
+  struct free_node {
+    free_node *next;
+  };
+
+  struct free_list {
+    free_node *head = nullptr;
+    std::size_t count = 0;
+  };
+
+ public:
+  static constexpr std::size_t min_size = 16;
+  static constexpr std::size_t max_size =
+      min_size << (arena_depot::num_size_classes - 1);
+  static constexpr std::size_t max_alignment = 64;
+  static constexpr std::size_t block_size = 64 * 1024;
+  static constexpr std::size_t batch_size = 64;
+
+  static arena &local() {
+    thread_local arena threadArena;
+    return threadArena;
+  }
+
+  /*
+   * @brief Returns whether an allocation can be served by an arena, rather
+   * than by the global operator new.
+   */
+  static constexpr bool is_arena_size(std::size_t size,
+                                      std::size_t alignment) noexcept {
+    return size <= max_size && alignment <= max_alignment;
+  }
+
+  arena(const arena &) = delete;
+  arena &operator=(const arena &) = delete;
+
+  // Hands the free lists of an exiting thread to the depot.
+  ~arena() {
+    for (std::size_t sizeClass = 0; sizeClass < freeLists_.size();
+         ++sizeClass) {
+      if (freeLists_[sizeClass].head) {
+        depot_.push_batch(sizeClass, {freeLists_[sizeClass].head,
+                                      freeLists_[sizeClass].count});
+      }
+    }
+  }
+
+  void *allocate(std::size_t size, std::size_t alignment) {
+    auto sizeClass = size_class(size, alignment);
+    auto &list = freeLists_[sizeClass];
+    if (!list.head) {
+      auto reused = arena_depot::batch{};
+      if (depot_.try_pop_batch(sizeClass, reused)) {
+        list.head = static_cast<free_node *>(reused.head);
+        list.count = reused.count;
+      }
+    }
+    if (list.head) {
+      auto node = list.head;
+      list.head = node->next;
+      --list.count;
+      return node;
+    }
+    return bump(class_size(sizeClass));
+  }
+
+  void deallocate(void *ptr, std::size_t size,
+                  std::size_t alignment) noexcept {
+    auto sizeClass = size_class(size, alignment);
+    auto &list = freeLists_[sizeClass];
+    list.head = ::new (ptr) free_node{list.head};
+    if (++list.count == 2 * batch_size) {
+      release_batch(sizeClass);
+    }
+  }
+
+ private:
+  arena()
+      : depot_{arena_depot::get()}, block_{nullptr}, offset_{block_size} {}
+
+  static constexpr std::size_t class_size(std::size_t sizeClass) noexcept {
+    return min_size << sizeClass;
+  }
+
+  static std::size_t size_class(std::size_t size,
+                                std::size_t alignment) noexcept {
+    auto sizeClass = std::size_t{0};
+    while (class_size(sizeClass) < size || class_size(sizeClass) < alignment) {
+      ++sizeClass;
+    }
+    return sizeClass;
+  }
+
+  // Blocks are aligned to max_alignment, so aligning the offset to the
+  // class size aligns every allocation to its class size or max_alignment.
+  void *bump(std::size_t size) {
+    auto alignment = size < max_alignment ? size : max_alignment;
+    auto offset = (offset_ + alignment - 1) & ~(alignment - 1);
+    if (offset + size > block_size) {
+      block_ = static_cast<std::byte *>(
+          depot_.allocate_block(block_size + max_alignment));
+      block_ += max_alignment -
+                reinterpret_cast<std::uintptr_t>(block_) % max_alignment;
+      offset = 0;
+    }
+    offset_ = offset + size;
+    return block_ + offset;
+  }
+
+  // Moves the most recently freed half of a free list to the depot.
+  void release_batch(std::size_t sizeClass) noexcept {
+    auto &list = freeLists_[sizeClass];
+    auto head = list.head;
+    auto tail = head;
+    for (std::size_t i = 1; i < batch_size; ++i) {
+      tail = tail->next;
+    }
+    list.head = tail->next;
+    list.count -= batch_size;
+    tail->next = nullptr;
+    try {
+      depot_.push_batch(sizeClass, {head, batch_size});
+    } catch (...) {
+      // If the depot cannot grow, keep the batch local instead.
+      tail->next = list.head;
+      list.head = head;
+      list.count += batch_size;
+    }
+  }
+
+  arena_depot &depot_;
+  std::array<free_list, arena_depot::num_size_classes> freeLists_;
+  std::byte *block_;
+  std::size_t offset_;
+};
+
+}  // namespace detail
+
+/*
+ * @brief Allocator which serves small allocations from an arena of the
+ * calling thread, using a bump pointer and per size class free lists, and
+ * larger or over-aligned allocations from the global operator new. It is
+ * intended for the short lived task and shared state allocations made by
+ * executors, and can be selected with require(exec, allocator(
+ * arena_allocator<void>{})).
+ * @tparam T Type of the allocated objects.
+ */
+template <typename T>
+class arena_allocator {
+ public:
+  using value_type = T;
+
+  arena_allocator() noexcept = default;
+
+  template <typename U>
+  arena_allocator(const arena_allocator<U> &) noexcept {}
+
+  T *allocate(std::size_t n) {
+    auto size = n * sizeof(T);
+    if (detail::arena::is_arena_size(size, alignof(T))) {
+      return static_cast<T *>(
+          detail::arena::local().allocate(size, alignof(T)));
+    }
+    return static_cast<T *>(
+        ::operator new(size, std::align_val_t{alignof(T)}));
+  }
+
+  void deallocate(T *ptr, std::size_t n) noexcept {
+    auto size = n * sizeof(T);
+    if (detail::arena::is_arena_size(size, alignof(T))) {
+      detail::arena::local().deallocate(ptr, size, alignof(T));
+    } else {
+      ::operator delete(ptr, std::align_val_t{alignof(T)});
+    }
+  }
+
+  template <typename U>
+  friend bool operator==(const arena_allocator &,
+                         const arena_allocator<U> &) noexcept {
+    return true;
+  }
+
+  template <typename U>
+  friend bool operator!=(const arena_allocator &,
+                         const arena_allocator<U> &) noexcept {
+    return false;
+  }
+};
+
+}  // namespace enzen
+
+#endif  // __ENZEN_ARENA_ALLOCATOR_H__
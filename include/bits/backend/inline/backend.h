@@ -0,0 +1,103 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_INLINE_BACKEND_H__
+#define __ENZEN_INLINE_BACKEND_H__
+
+#include <exception>
+#include <type_traits>
+
+namespace enzen::detail {
+
+/*
+ * @brief Back-end which runs all work directly on the calling thread, so that
+ * submitting work through an executor reduces to a direct function call.
+ */
+class inline_backend {
+ public:
+  template <typename Task, typename Function>
+  using transform_task_t =
+      typename thread_pool_transform_fusion<Task, Function>::type;
+
+  template <typename Executor, typename Task>
+  using via_task_t = enzen::thread_pool_via_task<Executor, Task>;
+
+  template <typename Task, typename Function>
+  using let_value_task_t = enzen::thread_pool_let_value_task<Task, Function>;
+
+  template <typename Task, typename Function, std::size_t Rank>
+  using bulk_task_t = enzen::thread_pool_bulk_task<Task, Function, Rank>;
+
+  using executor_t = basic_executor<detail::inline_backend,
+                                    detail::executor_interface::oneway, void>;
+
+  using sub_executor_t =
+      basic_executor<detail::inline_backend,
+                     detail::executor_interface::oneway, void>;
+
+  inline_backend() = default;
+
+  inline_backend(const inline_backend &) = delete;
+  inline_backend(inline_backend &&) = delete;
+  inline_backend &operator=(const inline_backend &) = delete;
+  inline_backend &operator=(inline_backend &&) = delete;
+
+  std::size_t num_workers() const noexcept { return 1; }
+
+  // Functions run in place, so no task storage is allocated.
+  template <typename KernelName, detail::executor_blocking Blocking,
+            typename Function, typename ProtoAllocator>
+  void execute(Function &&f, const ProtoAllocator &) {
+    f();
+  }
+
+  template <typename KernelName, detail::executor_blocking Blocking,
+            typename Function, std::size_t Rank, typename ProtoAllocator>
+  void bulk_execute(Function &&f, enzen::shape<Rank> shape,
+                    const mapping_t &mapping,
+                    const bulk_guarantee_t &bulkGuarantee,
+                    const ProtoAllocator &) {
+    detail::invoke_bulk(f, shape, mapping, bulkGuarantee);
+  }
+
+  template <typename KernelName, detail::executor_blocking Blocking,
+            typename Function, typename ProtoAllocator>
+  auto twoway_execute(Function &&f, const ProtoAllocator &alloc) {
+    using return_type =
+        std::remove_cv_t<std::decay_t<decltype(std::declval<Function &&>()())>>;
+
+    auto prom = promise<return_type>{std::allocator_arg, alloc};
+    auto fut = prom.get_future();
+
+    try {
+      prom.set_value(f());
+    } catch (...) {
+      prom.set_exception(std::current_exception());
+    }
+    return fut;
+  }
+};
+
+/*
+ * @brief Functions run in place on the inline back-end, so its executors
+ * always block, even when never or possibly blocking is required.
+ */
+template <>
+struct is_always_blocking_backend<inline_backend> : public std::true_type {};
+
+}  // namespace enzen::detail
+
+#endif  // __ENZEN_INLINE_BACKEND_H__
@@ -0,0 +1,47 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_INLINE_EXECUTION_CONTEXT_H__
+#define __ENZEN_INLINE_EXECUTION_CONTEXT_H__
+
+namespace enzen {
+
+/*
+ * @brief Execution context which runs all work directly on the thread which
+ * submits it.
+ */
+class inline_context {
+ public:
+  using executor_type = inline_executor;
+
+  inline_context() : impl_{std::make_shared<detail::inline_backend>()} {}
+
+  inline_context(const inline_context &) = delete;
+  inline_context(inline_context &&) = default;
+  inline_context &operator=(const inline_context &) = delete;
+  inline_context &operator=(inline_context &&) = default;
+
+  executor_type executor() noexcept {
+    return executor_type{impl_};
+  }
+
+ private:
+  std::shared_ptr<detail::inline_backend> impl_;
+};
+
+}  // namespace enzen
+
+#endif  // __ENZEN_INLINE_EXECUTION_CONTEXT_H__
@@ -0,0 +1,29 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_BACKEND_IO_H__
+#define __ENZEN_BACKEND_IO_H__
+
+#if !defined(__linux__)
+#error "I/O back-end requires Linux"
+#endif  // !defined(__linux__)
+
+#include <bits/backend/io/tasks.h>
+#include <bits/backend/io/backend.h>
+#include <bits/backend/io/executor.h>
+#include <bits/backend/io/execution_context.h>
+
+#endif  // __ENZEN_BACKEND_IO_H__
@@ -0,0 +1,188 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_IO_BACKEND_H__
+#define __ENZEN_IO_BACKEND_H__
+
+#include <atomic>
+#include <cerrno>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+#include <bits/backend/io/epoll_reactor.h>
+#include <bits/backend/io/io_uring_reactor.h>
+#include <bits/backend/io/operation.h>
+#include <bits/backend/run_loop/backend.h>
+#include <bits/event.h>
+#include <bits/mpsc_queue.h>
+
+namespace enzen {
+
+/*
+ * @brief Mechanism used by an io_context to perform I/O. automatic uses
+ * io_uring where the kernel supports it and falls back to epoll otherwise.
+ */
+enum class io_reactor_type { automatic, io_uring, epoll };
+
+}  // namespace enzen
+
+namespace enzen::detail {
+
+/*
+ * @brief Back-end of an I/O execution context. A single reactor thread waits
+ * for I/O completions and runs any tasks submitted to the context's
+ * executors, so that receivers of I/O tasks are completed on it.
+ */
+class io_backend {
+ public:
+  template <typename Task, typename Function>
+  using transform_task_t =
+      typename thread_pool_transform_fusion<Task, Function>::type;
+
+  template <typename Executor, typename Task>
+  using via_task_t = enzen::thread_pool_via_task<Executor, Task>;
+
+  template <typename Task, typename Function>
+  using let_value_task_t = enzen::thread_pool_let_value_task<Task, Function>;
+
+  template <typename Task, typename Function, std::size_t Rank>
+  using bulk_task_t = enzen::thread_pool_bulk_task<Task, Function, Rank>;
+
+  using executor_t = basic_executor<detail::io_backend,
+                                    detail::executor_interface::oneway, void>;
+
+  using sub_executor_t =
+      basic_executor<detail::io_backend, detail::executor_interface::oneway,
+                     void>;
+
+  io_backend(io_reactor_type reactorType) : stopping_{false} {
+    if (reactorType != io_reactor_type::epoll) {
+      try {
+        reactor_ = std::make_unique<io_uring_reactor>();
+        reactorType_ = io_reactor_type::io_uring;
+      } catch (std::system_error &) {
+        if (reactorType == io_reactor_type::io_uring) {
+          throw;
+        }
+      }
+    }
+    if (!reactor_) {
+      reactor_ = std::make_unique<epoll_reactor>();
+      reactorType_ = io_reactor_type::epoll;
+    }
+  }
+
+  io_backend(const io_backend &) = delete;
+  io_backend(io_backend &&) = delete;
+  io_backend &operator=(const io_backend &) = delete;
+  io_backend &operator=(io_backend &&) = delete;
+
+  ~io_backend() {
+    while (auto task = queue_.try_pop()) {
+      task->execute_and_destroy(false);
+    }
+  }
+
+  void start() {
+    if (!reactorThread_.joinable()) {
+      stopping_.store(false, std::memory_order_release);
+      reactorThread_ = std::thread{[this]() { this->run(); }};
+    }
+  }
+
+  /*
+   * @brief Stops the reactor thread, completing any outstanding operations
+   * with an operation_canceled error.
+   */
+  void stop() {
+    if (reactorThread_.joinable()) {
+      stopping_.store(true, std::memory_order_release);
+      reactor_->wake();
+      reactorThread_.join();
+    }
+  }
+
+  io_reactor_type reactor_type() const noexcept { return reactorType_; }
+
+  std::size_t num_workers() const noexcept { return 1; }
+
+  // Once stopped, the reactor no longer performs or cancels operations, so
+  // those submitted afterwards are completed straight away with
+  // operation_canceled, as cancel_all() completes those outstanding at stop.
+  void submit_operation(io_operation *op) {
+    if (stopping_.load(std::memory_order_acquire)) {
+      op->complete(-ECANCELED);
+      return;
+    }
+    reactor_->submit(op);
+  }
+
+  template <typename KernelName, detail::executor_blocking Blocking,
+            typename Function, typename ProtoAllocator>
+  void execute(Function &&f, const ProtoAllocator &alloc) {
+    if constexpr (Blocking == detail::executor_blocking::always) {
+      if (std::this_thread::get_id() == reactorThread_.get_id()) {
+        f();
+      } else {
+        auto complete = detail::event{};
+        this->enqueue_task(
+            [&f, &complete]() {
+              f();
+              complete.set();
+            },
+            alloc);
+        complete.wait();
+      }
+    } else {
+      this->enqueue_task(std::forward<Function>(f), alloc);
+    }
+  }
+
+ private:
+  template <typename Function, typename ProtoAllocator>
+  void enqueue_task(Function &&f, const ProtoAllocator &alloc) {
+    queue_.push(run_loop_task<std::decay_t<Function>, ProtoAllocator>::allocate(
+        std::forward<Function>(f), alloc));
+    reactor_->wake();
+  }
+
+  void run_tasks() {
+    while (auto task = queue_.try_pop()) {
+      task->execute_and_destroy(true);
+    }
+  }
+
+  void run() {
+    while (!stopping_.load(std::memory_order_acquire)) {
+      run_tasks();
+      reactor_->wait_and_dispatch();
+    }
+    run_tasks();
+    reactor_->cancel_all();
+    run_tasks();
+  }
+
+  std::unique_ptr<io_reactor> reactor_;
+  io_reactor_type reactorType_;
+  std::atomic<bool> stopping_;
+  std::thread reactorThread_;
+  intrusive_mpsc_queue<run_loop_task_base> queue_;
+};
+
+}  // namespace enzen::detail
+
+#endif  // __ENZEN_IO_BACKEND_H__
@@ -0,0 +1,256 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_IO_EPOLL_REACTOR_H__
+#define __ENZEN_IO_EPOLL_REACTOR_H__
+
+#include <cerrno>
+#include <cstdint>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <bits/backend/io/operation.h>
+
+namespace enzen::detail {
+
+/*
+ * @brief Reactor which waits for file descriptors to become ready with epoll
+ * and then performs the operations on the reactor thread. File descriptors
+ * which epoll does not support, such as regular files, are accessed
+ * synchronously on the reactor thread.
+ */
+class epoll_reactor : public io_reactor {
+  struct fd_state {
+    io_operation_list inputs;
+    io_operation_list outputs;
+    std::uint32_t registeredEvents = 0;
+  };
+
+ public:
+  epoll_reactor() {
+    epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd_ < 0) {
+      throw std::system_error(errno, std::system_category(),
+                              "Failed to create epoll instance.");
+    }
+
+    wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0) {
+      ::close(epollFd_);
+      throw std::system_error(errno, std::system_category(),
+                              "Failed to create eventfd.");
+    }
+
+    auto event = epoll_event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event);
+  }
+
+  epoll_reactor(const epoll_reactor &) = delete;
+  epoll_reactor &operator=(const epoll_reactor &) = delete;
+
+  ~epoll_reactor() override {
+    ::close(wakeFd_);
+    ::close(epollFd_);
+  }
+
+  void submit(io_operation *op) override {
+    {
+      auto lock = std::lock_guard<std::mutex>{pendingMutex_};
+      pending_.push_back(op);
+    }
+    wake();
+  }
+
+  void wake() override {
+    auto value = std::uint64_t{1};
+    [[maybe_unused]] auto res = ::write(wakeFd_, &value, sizeof(value));
+  }
+
+  void wait_and_dispatch() override {
+    register_pending();
+
+    epoll_event events[64];
+    auto numEvents = ::epoll_wait(epollFd_, events, 64, -1);
+
+    for (int e = 0; e < numEvents; ++e) {
+      if (events[e].data.ptr == nullptr) {
+        auto value = std::uint64_t{};
+        [[maybe_unused]] auto res = ::read(wakeFd_, &value, sizeof(value));
+        continue;
+      }
+
+      auto fd = static_cast<int>(
+          reinterpret_cast<std::intptr_t>(events[e].data.ptr) - 1);
+      auto it = fds_.find(fd);
+      if (it == fds_.end()) {
+        continue;
+      }
+
+      // Only one operation per direction is performed per notification, as
+      // the file descriptor may be blocking and readiness only guarantees
+      // that a single operation will not block.
+      auto ready = events[e].events;
+      if (ready & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        perform_one(it->second.inputs);
+      }
+      if (ready & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+        perform_one(it->second.outputs);
+      }
+      update_registration(fd);
+    }
+  }
+
+  void cancel_all() override {
+    register_pending();
+
+    for (auto &[fd, state] : fds_) {
+      while (auto op = state.inputs.pop_front()) {
+        op->complete(-ECANCELED);
+      }
+      while (auto op = state.outputs.pop_front()) {
+        op->complete(-ECANCELED);
+      }
+      ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    fds_.clear();
+  }
+
+ private:
+  void register_pending() {
+    auto pending = std::vector<io_operation *>{};
+    {
+      auto lock = std::lock_guard<std::mutex>{pendingMutex_};
+      pending.swap(pending_);
+    }
+
+    for (auto op : pending) {
+      auto &state = fds_[op->fd()];
+      if (op->is_input()) {
+        state.inputs.push_back(op);
+      } else {
+        state.outputs.push_back(op);
+      }
+      update_registration(op->fd());
+    }
+  }
+
+  void update_registration(int fd) {
+    auto it = fds_.find(fd);
+    auto &state = it->second;
+
+    auto events = std::uint32_t{0};
+    if (!state.inputs.empty()) {
+      events |= EPOLLIN;
+    }
+    if (!state.outputs.empty()) {
+      events |= EPOLLOUT;
+    }
+
+    if (events == state.registeredEvents) {
+      if (events == 0) {
+        fds_.erase(it);
+      }
+      return;
+    }
+
+    auto event = epoll_event{};
+    event.events = events;
+    event.data.ptr =
+        reinterpret_cast<void *>(static_cast<std::intptr_t>(fd) + 1);
+
+    auto res = 0;
+    if (events == 0) {
+      res = ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    } else if (state.registeredEvents == 0) {
+      res = ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+    } else {
+      res = ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    if (res < 0 && events != 0) {
+      // epoll does not support this file descriptor (EPERM for regular
+      // files), or it is invalid, so perform the operations synchronously.
+      auto error = errno;
+      state.registeredEvents = 0;
+      while (auto op = state.inputs.pop_front()) {
+        op->complete(error == EPERM ? perform(op) : -error);
+      }
+      while (auto op = state.outputs.pop_front()) {
+        op->complete(error == EPERM ? perform(op) : -error);
+      }
+      fds_.erase(fd);
+      return;
+    }
+
+    state.registeredEvents = events;
+    if (events == 0) {
+      fds_.erase(it);
+    }
+  }
+
+  void perform_one(io_operation_list &ops) {
+    if (auto op = ops.front()) {
+      auto result = perform(op);
+      if (result != -EAGAIN && result != -EWOULDBLOCK) {
+        ops.pop_front();
+        op->complete(result);
+      }
+    }
+  }
+
+  static std::int64_t perform(io_operation *op) {
+    auto result = ssize_t{-1};
+    do {
+      switch (op->opcode()) {
+        case io_opcode::read:
+          result = op->offset() < 0
+                       ? ::read(op->fd(), op->buffer(), op->size())
+                       : ::pread(op->fd(), op->buffer(), op->size(),
+                                 op->offset());
+          break;
+        case io_opcode::write:
+          result = op->offset() < 0
+                       ? ::write(op->fd(), op->buffer(), op->size())
+                       : ::pwrite(op->fd(), op->buffer(), op->size(),
+                                  op->offset());
+          break;
+        case io_opcode::accept:
+          result = ::accept4(op->fd(), nullptr, nullptr, SOCK_CLOEXEC);
+          break;
+      }
+    } while (result < 0 && errno == EINTR);
+    return result < 0 ? -errno : result;
+  }
+
+  int epollFd_;
+  int wakeFd_;
+  std::mutex pendingMutex_;
+  std::vector<io_operation *> pending_;
+  std::unordered_map<int, fd_state> fds_;
+};
+
+}  // namespace enzen::detail
+
+#endif  // __ENZEN_IO_EPOLL_REACTOR_H__
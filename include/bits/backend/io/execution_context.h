@@ -0,0 +1,68 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_IO_EXECUTION_CONTEXT_H__
+#define __ENZEN_IO_EXECUTION_CONTEXT_H__
+
+namespace enzen {
+
+/*
+ * @brief Execution context for asynchronous file and socket I/O, performed by
+ * a reactor thread using io_uring or epoll. I/O tasks are created with
+ * async_read, async_write and async_accept, and complete on the reactor
+ * thread; use via to continue on another executor.
+ */
+class io_context {
+ public:
+  using executor_type = io_executor;
+
+  io_context(io_reactor_type reactorType = io_reactor_type::automatic)
+      : impl_{std::make_shared<detail::io_backend>(reactorType)} {
+    impl_->start();
+  }
+
+  io_context(const io_context &) = delete;
+  io_context(io_context &&) = default;
+  io_context &operator=(const io_context &) = delete;
+  io_context &operator=(io_context &&) = default;
+
+  ~io_context() {
+    if (impl_) {
+      impl_->stop();
+    }
+  }
+
+  /*
+   * @brief Stops the reactor thread, completing any outstanding operations
+   * with an operation_canceled error.
+   */
+  void stop() { impl_->stop(); }
+
+  io_reactor_type reactor_type() const noexcept {
+    return impl_->reactor_type();
+  }
+
+  executor_type executor() noexcept {
+    return executor_type{impl_};
+  }
+
+ private:
+  std::shared_ptr<detail::io_backend> impl_;
+};
+
+}  // namespace enzen
+
+#endif  // __ENZEN_IO_EXECUTION_CONTEXT_H__
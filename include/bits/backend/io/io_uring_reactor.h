@@ -0,0 +1,323 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_IO_URING_REACTOR_H__
+#define __ENZEN_IO_URING_REACTOR_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <bits/backend/io/operation.h>
+
+namespace enzen::detail {
+
+/*
+ * @brief Reactor which performs operations with Linux io_uring, using the raw
+ * system call interface. Submissions from any thread are serialised on the
+ * submission queue, and completions are reaped on the reactor thread. The
+ * outstanding operations are tracked under a separate mutex, so that reaping
+ * never waits on a thread which is waiting for room in the submission queue.
+ */
+class io_uring_reactor : public io_reactor {
+ public:
+  /*
+   * @brief Sets up an io_uring instance.
+   * @throw std::system_error If io_uring is not available, or does not
+   * support every operation the reactor submits.
+   */
+  io_uring_reactor(unsigned entries = 256) {
+    auto params = io_uring_params{};
+    std::memset(&params, 0, sizeof(params));
+
+    ringFd_ =
+        static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd_ < 0) {
+      throw std::system_error(errno, std::system_category(),
+                              "Failed to set up io_uring.");
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    singleMmap_ = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap_) {
+      sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    // The rings are released if mapping any of them fails, so that a caller
+    // which falls back to another reactor does not leak them.
+    try {
+      sqRing_ = map(sqRingSize_, IORING_OFF_SQ_RING);
+      cqRing_ = singleMmap_ ? sqRing_ : map(cqRingSize_, IORING_OFF_CQ_RING);
+      sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+      sqes_ = static_cast<io_uring_sqe *>(map(sqesSize_, IORING_OFF_SQES));
+      probe_operations();
+    } catch (...) {
+      release();
+      throw;
+    }
+
+    auto sq = static_cast<char *>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    auto cq = static_cast<char *>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  }
+
+  io_uring_reactor(const io_uring_reactor &) = delete;
+  io_uring_reactor &operator=(const io_uring_reactor &) = delete;
+
+  ~io_uring_reactor() override { release(); }
+
+  void submit(io_operation *op) override {
+    auto lock = std::lock_guard<std::mutex>{sqMutex_};
+    auto sqe = next_sqe();
+    switch (op->opcode()) {
+      case io_opcode::read:
+        sqe->opcode = IORING_OP_READ;
+        break;
+      case io_opcode::write:
+        sqe->opcode = IORING_OP_WRITE;
+        break;
+      case io_opcode::accept:
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        break;
+    }
+    sqe->fd = op->fd();
+    if (op->opcode() != io_opcode::accept) {
+      sqe->addr = reinterpret_cast<std::uint64_t>(op->buffer());
+      sqe->len = static_cast<std::uint32_t>(op->size());
+      sqe->off = static_cast<std::uint64_t>(op->offset());
+    }
+    sqe->user_data = reinterpret_cast<std::uint64_t>(op);
+
+    // The operation is tracked before the kernel can complete it, and after
+    // it was last read here, so that the reactor which frees it on completion
+    // is ordered after this thread.
+    {
+      auto inFlightLock = std::lock_guard<std::mutex>{inFlightMutex_};
+      inFlight_.push_back(op);
+    }
+    flush_sqe();
+  }
+
+  // Only the first wake-up after the reactor last returned from waiting posts
+  // a NOP, so a burst of submissions costs one entry and one system call.
+  void wake() override {
+    if (wakePending_.exchange(true, std::memory_order_acq_rel)) {
+      return;
+    }
+    auto lock = std::lock_guard<std::mutex>{sqMutex_};
+    auto sqe = next_sqe();
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = 0;
+    flush_sqe();
+  }
+
+  void wait_and_dispatch() override {
+    ::syscall(__NR_io_uring_enter, ringFd_, 0, 1, IORING_ENTER_GETEVENTS,
+              nullptr, 0);
+    // Anything enqueued before a pending wake-up was posted is seen by the
+    // caller once this returns, so later wake-ups must post again.
+    wakePending_.exchange(false, std::memory_order_acq_rel);
+
+    auto head = __atomic_load_n(cqHead_, __ATOMIC_RELAXED);
+    while (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+      auto &cqe = cqes_[head & cqMask_];
+      auto op = reinterpret_cast<io_operation *>(cqe.user_data);
+      auto result = static_cast<std::int64_t>(cqe.res);
+      __atomic_store_n(cqHead_, ++head, __ATOMIC_RELEASE);
+
+      // Completions with no operation are wake-ups and cancellation requests.
+      if (op != nullptr) {
+        {
+          auto lock = std::lock_guard<std::mutex>{inFlightMutex_};
+          inFlight_.erase(op);
+        }
+        op->complete(result);
+      }
+    }
+  }
+
+  void cancel_all() override {
+    // Operations are only removed on this thread, so they stay valid after
+    // the lock is released.
+    auto ops = std::vector<io_operation *>{};
+    {
+      auto lock = std::lock_guard<std::mutex>{inFlightMutex_};
+      for (auto op = inFlight_.front(); op != nullptr;
+           op = io_operation_list::next(op)) {
+        ops.push_back(op);
+      }
+    }
+
+    {
+      auto lock = std::lock_guard<std::mutex>{sqMutex_};
+      for (auto op : ops) {
+        auto sqe = next_sqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = reinterpret_cast<std::uint64_t>(op);
+        sqe->user_data = 0;
+        flush_sqe();
+      }
+    }
+
+    while (true) {
+      {
+        auto lock = std::lock_guard<std::mutex>{inFlightMutex_};
+        if (inFlight_.empty()) {
+          break;
+        }
+      }
+      wait_and_dispatch();
+    }
+  }
+
+ private:
+  void *map(std::size_t size, std::uint64_t offset) {
+    auto ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd_, offset);
+    if (ptr == MAP_FAILED) {
+      throw std::system_error(errno, std::system_category(),
+                              "Failed to map io_uring ring.");
+    }
+    return ptr;
+  }
+
+  // Asks the kernel which operations it supports, as kernels before 5.6
+  // set up a ring but reject IORING_OP_READ and IORING_OP_WRITE. Those
+  // kernels also lack IORING_REGISTER_PROBE, so a failed probe is treated as
+  // no support.
+  void probe_operations() {
+    constexpr unsigned numOps = 256;
+    alignas(io_uring_probe) char
+        buffer[sizeof(io_uring_probe) + numOps * sizeof(io_uring_probe_op)];
+    std::memset(buffer, 0, sizeof(buffer));
+    auto probe = reinterpret_cast<io_uring_probe *>(buffer);
+
+    if (::syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PROBE,
+                  probe, numOps) < 0) {
+      throw std::system_error(errno, std::system_category(),
+                              "Failed to probe io_uring operations.");
+    }
+    for (auto opcode : {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_ACCEPT,
+                        IORING_OP_ASYNC_CANCEL}) {
+      if (opcode > probe->last_op ||
+          (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) == 0) {
+        throw std::system_error(ENOSYS, std::system_category(),
+                                "io_uring operation not supported.");
+      }
+    }
+  }
+
+  // Unmaps whichever rings have been mapped and closes the ring.
+  void release() noexcept {
+    if (sqes_ != nullptr) {
+      ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != nullptr && cqRing_ != sqRing_) {
+      ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != nullptr) {
+      ::munmap(sqRing_, sqRingSize_);
+    }
+    ::close(ringFd_);
+  }
+
+  // Must be called with sqMutex_ held. Every entry is submitted as soon as it
+  // is filled, so the kernel consumes the submission queue before it fills.
+  // Completions are reaped without sqMutex_, so waiting here for room does
+  // not stop the reactor thread from draining the completion queue.
+  io_uring_sqe *next_sqe() {
+    auto tail = *sqTail_;
+    while (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+      enter_unsubmitted();
+    }
+    auto index = tail & sqMask_;
+    auto sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    return sqe;
+  }
+
+  // Must be called with sqMutex_ held. Entries the kernel could not accept,
+  // for example while the completion queue is overflowing, are submitted with
+  // the next entry.
+  void flush_sqe() {
+    __atomic_store_n(sqTail_, *sqTail_ + 1, __ATOMIC_RELEASE);
+    ++unsubmitted_;
+    enter_unsubmitted();
+  }
+
+  void enter_unsubmitted() {
+    auto res = long{0};
+    do {
+      res = ::syscall(__NR_io_uring_enter, ringFd_, unsubmitted_, 0, 0,
+                      nullptr, 0);
+    } while (res < 0 && errno == EINTR);
+
+    if (res > 0) {
+      unsubmitted_ -= static_cast<unsigned>(res);
+    }
+  }
+
+  int ringFd_;
+  bool singleMmap_;
+  std::size_t sqRingSize_;
+  std::size_t cqRingSize_;
+  std::size_t sqesSize_;
+  void *sqRing_ = nullptr;
+  void *cqRing_ = nullptr;
+  io_uring_sqe *sqes_ = nullptr;
+  unsigned *sqHead_;
+  unsigned *sqTail_;
+  unsigned sqMask_;
+  unsigned sqEntries_;
+  unsigned *sqArray_;
+  unsigned unsubmitted_ = 0;
+  unsigned *cqHead_;
+  unsigned *cqTail_;
+  unsigned cqMask_;
+  io_uring_cqe *cqes_;
+  std::mutex sqMutex_;
+  std::atomic<bool> wakePending_{false};
+  std::mutex inFlightMutex_;
+  io_operation_list inFlight_;
+};
+
+}  // namespace enzen::detail
+
+#endif  // __ENZEN_IO_URING_REACTOR_H__
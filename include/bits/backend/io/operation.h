@@ -0,0 +1,158 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_IO_OPERATION_H__
+#define __ENZEN_IO_OPERATION_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace enzen::detail {
+
+enum class io_opcode : int { read, write, accept };
+
+/*
+ * @brief An asynchronous I/O operation submitted to an io_reactor. The
+ * operation is owned by the reactor from submission until it calls complete(),
+ * which destroys it.
+ */
+class io_operation {
+ public:
+  using complete_fn_t = void (*)(io_operation *, std::int64_t);
+
+  io_operation(io_opcode opcode, int fd, void *buffer, std::size_t size,
+               std::int64_t offset, complete_fn_t completeFn)
+      : opcode_{opcode},
+        fd_{fd},
+        buffer_{buffer},
+        size_{size},
+        offset_{offset},
+        completeFn_{completeFn},
+        prev_{nullptr},
+        next_{nullptr} {}
+
+  /*
+   * @brief Completes the operation with the number of bytes transferred, the
+   * accepted file descriptor or a negated errno value, and destroys it.
+   */
+  void complete(std::int64_t result) { completeFn_(this, result); }
+
+  io_opcode opcode() const noexcept { return opcode_; }
+
+  int fd() const noexcept { return fd_; }
+
+  void *buffer() const noexcept { return buffer_; }
+
+  std::size_t size() const noexcept { return size_; }
+
+  // A negative offset uses and updates the current file position.
+  std::int64_t offset() const noexcept { return offset_; }
+
+  bool is_input() const noexcept { return opcode_ != io_opcode::write; }
+
+ private:
+  friend class io_operation_list;
+
+  io_opcode opcode_;
+  int fd_;
+  void *buffer_;
+  std::size_t size_;
+  std::int64_t offset_;
+  complete_fn_t completeFn_;
+  io_operation *prev_;
+  io_operation *next_;
+};
+
+/*
+ * @brief Intrusive doubly linked list of operations, used by the reactors to
+ * track outstanding operations without allocating.
+ */
+class io_operation_list {
+ public:
+  io_operation_list() : head_{nullptr}, tail_{nullptr} {}
+
+  bool empty() const noexcept { return head_ == nullptr; }
+
+  io_operation *front() const noexcept { return head_; }
+
+  void push_back(io_operation *op) noexcept {
+    op->prev_ = tail_;
+    op->next_ = nullptr;
+    if (tail_ != nullptr) {
+      tail_->next_ = op;
+    } else {
+      head_ = op;
+    }
+    tail_ = op;
+  }
+
+  void erase(io_operation *op) noexcept {
+    if (op->prev_ != nullptr) {
+      op->prev_->next_ = op->next_;
+    } else {
+      head_ = op->next_;
+    }
+    if (op->next_ != nullptr) {
+      op->next_->prev_ = op->prev_;
+    } else {
+      tail_ = op->prev_;
+    }
+    op->prev_ = nullptr;
+    op->next_ = nullptr;
+  }
+
+  io_operation *pop_front() noexcept {
+    auto op = head_;
+    if (op != nullptr) {
+      erase(op);
+    }
+    return op;
+  }
+
+  static io_operation *next(io_operation *op) noexcept { return op->next_; }
+
+ private:
+  io_operation *head_;
+  io_operation *tail_;
+};
+
+/*
+ * @brief Interface of the mechanism an io_backend uses to perform operations
+ * and wait for their completion.
+ */
+class io_reactor {
+ public:
+  virtual ~io_reactor() = default;
+
+  // Starts an operation, may be called from any thread.
+  virtual void submit(io_operation *op) = 0;
+
+  // Wakes the thread blocked in wait_and_dispatch(), may be called from any
+  // thread.
+  virtual void wake() = 0;
+
+  // Blocks until at least one operation completes or wake() is called, and
+  // completes the operations which are ready on the calling thread.
+  virtual void wait_and_dispatch() = 0;
+
+  // Completes every outstanding operation, with -ECANCELED if it has not yet
+  // been performed.
+  virtual void cancel_all() = 0;
+};
+
+}  // namespace enzen::detail
+
+#endif  // __ENZEN_IO_OPERATION_H__
@@ -0,0 +1,164 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_IO_TASKS_H__
+#define __ENZEN_IO_TASKS_H__
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <system_error>
+
+#include <bits/arena_allocator.h>
+#include <bits/backend/io/operation.h>
+
+namespace enzen {
+
+namespace detail {
+
+/*
+ * @brief Operation which completes a receiver. It is allocated with the
+ * allocator of the executor the task was created with.
+ */
+template <typename Receiver, typename Value, typename ProtoAllocator>
+class io_receiver_operation : public io_operation {
+ public:
+  io_receiver_operation(io_opcode opcode, int fd, void *buffer,
+                        std::size_t size, std::int64_t offset,
+                        Receiver receiver, const ProtoAllocator &alloc)
+      : io_operation{opcode, fd, buffer, size, offset,
+                     &io_receiver_operation::complete_receiver},
+        receiver_{std::move(receiver)},
+        allocator_{alloc} {}
+
+ private:
+  struct deleter {
+    void operator()(io_receiver_operation *op) const noexcept {
+      auto alloc = op->allocator_;
+      detail::deallocate_object(alloc, op);
+    }
+  };
+
+  static void complete_receiver(io_operation *base, std::int64_t result) {
+    auto op = std::unique_ptr<io_receiver_operation, deleter>{
+        static_cast<io_receiver_operation *>(base)};
+    if (result < 0) {
+      enzen::set_error(op->receiver_,
+                       std::make_exception_ptr(std::system_error(
+                           static_cast<int>(-result), std::system_category())));
+    } else {
+      enzen::set_value(op->receiver_, static_cast<Value>(result));
+    }
+  }
+
+  Receiver receiver_;
+  ProtoAllocator allocator_;
+};
+
+}  // namespace detail
+
+/*
+ * @brief Task which performs an I/O operation on the reactor thread of an
+ * io_context, and completes with the number of bytes transferred or the
+ * accepted file descriptor. Errors are delivered as a std::system_error.
+ */
+template <typename Executor, typename Value>
+class io_task {
+ public:
+  using executor_t = Executor;
+  using value_t = Value;
+
+  io_task(Executor executor, detail::io_opcode opcode, int fd, void *buffer,
+          std::size_t size, std::int64_t offset)
+      : executor_{std::move(executor)},
+        opcode_{opcode},
+        fd_{fd},
+        buffer_{buffer},
+        size_{size},
+        offset_{offset} {}
+
+  template <typename Receiver>
+  void submit(Receiver receiver) noexcept {
+    try {
+      auto alloc = executor_.query(enzen::allocator);
+      using operation_t =
+          detail::io_receiver_operation<Receiver, Value, decltype(alloc)>;
+      auto op = detail::allocate_object<operation_t>(
+          alloc, opcode_, fd_, buffer_, size_, offset_, receiver, alloc);
+      try {
+        executor_.get_impl()->submit_operation(op);
+      } catch (...) {
+        detail::deallocate_object(alloc, op);
+        throw;
+      }
+    } catch (...) {
+      enzen::set_error(receiver, std::current_exception());
+    }
+  }
+
+  Executor get_executor() const noexcept { return executor_; }
+
+ private:
+  Executor executor_;
+  detail::io_opcode opcode_;
+  int fd_;
+  void *buffer_;
+  std::size_t size_;
+  std::int64_t offset_;
+};
+
+/*
+ * @brief Returns a task which reads up to size bytes from fd into buffer.
+ * @param executor Executor of the io_context to perform the read on.
+ * @param offset File offset to read from, or -1 to read from the current
+ * position.
+ */
+template <typename Executor>
+io_task<Executor, std::size_t> async_read(Executor executor, int fd,
+                                          void *buffer, std::size_t size,
+                                          std::int64_t offset = -1) {
+  return {std::move(executor), detail::io_opcode::read, fd, buffer, size,
+          offset};
+}
+
+/*
+ * @brief Returns a task which writes up to size bytes from buffer to fd.
+ * @param executor Executor of the io_context to perform the write on.
+ * @param offset File offset to write to, or -1 to write at the current
+ * position.
+ */
+template <typename Executor>
+io_task<Executor, std::size_t> async_write(Executor executor, int fd,
+                                           const void *buffer,
+                                           std::size_t size,
+                                           std::int64_t offset = -1) {
+  return {std::move(executor), detail::io_opcode::write, fd,
+          const_cast<void *>(buffer), size, offset};
+}
+
+/*
+ * @brief Returns a task which accepts a connection on the listening socket fd
+ * and completes with the connected socket.
+ * @param executor Executor of the io_context to perform the accept on.
+ */
+template <typename Executor>
+io_task<Executor, int> async_accept(Executor executor, int fd) {
+  return {std::move(executor), detail::io_opcode::accept, fd, nullptr, 0, 0};
+}
+
+}  // namespace enzen
+
+#endif  // __ENZEN_IO_TASKS_H__
@@ -17,8 +17,6 @@ limitations under the License.
 #ifndef __ENZEN_BACKEND_OPENCL_EXECUTION_CONTEXT_H__
 #define __ENZEN_BACKEND_OPENCL_EXECUTION_CONTEXT_H__
 
-#include <bits/debug.h>
-
 namespace enzen {
 
 class opencl_context {
@@ -45,7 +43,7 @@ class opencl_context {
   void wait() { impl_->wait(); }
 
   executor_type executor() noexcept {
-    return executor_type{impl_, detail::executor_blocking::possibly};
+    return executor_type{impl_};
   }
 
  private:
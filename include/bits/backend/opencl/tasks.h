@@ -81,7 +81,7 @@ class opencl_transform_task {
       auto openclTransformReceiver =
           this->get_executor()
               .template lazy_execute<param_t, Function, IncomingReceiver>(
-                  function_, incomingReceiver, enzen::shape{1, 1, 1});
+                  function_, incomingReceiver, enzen::shape{1});
 
       enzen::submit(std::move(nextTask_), openclTransformReceiver);
     } catch (...) {
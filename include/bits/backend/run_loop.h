@@ -0,0 +1,24 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_BACKEND_RUN_LOOP_H__
+#define __ENZEN_BACKEND_RUN_LOOP_H__
+
+#include <bits/backend/run_loop/backend.h>
+#include <bits/backend/run_loop/executor.h>
+#include <bits/backend/run_loop/execution_context.h>
+
+#endif  // __ENZEN_BACKEND_RUN_LOOP_H__
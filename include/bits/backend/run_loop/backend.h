@@ -0,0 +1,315 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_RUN_LOOP_BACKEND_H__
+#define __ENZEN_RUN_LOOP_BACKEND_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#if !defined(__cpp_lib_atomic_wait)
+#include <condition_variable>
+#include <mutex>
+#endif  // !defined(__cpp_lib_atomic_wait)
+
+#include <bits/arena_allocator.h>
+#include <bits/event.h>
+#include <bits/mpsc_queue.h>
+
+namespace enzen::detail {
+
+/*
+ * @brief Node of the run loop queue. Tasks are allocated with their function
+ * embedded, using the allocator of the executor which submitted them, so
+ * enqueuing a task performs a single allocation and no locking.
+ */
+class run_loop_task_base : public mpsc_queue_node {
+ public:
+  using execute_fn_t = void (*)(run_loop_task_base *, bool);
+
+  run_loop_task_base(execute_fn_t executeFn) : executeFn_{executeFn} {}
+
+  // Runs the function of the task if invoke is true, and destroys the task.
+  void execute_and_destroy(bool invoke) { executeFn_(this, invoke); }
+
+ private:
+  execute_fn_t executeFn_;
+};
+
+template <typename Function, typename ProtoAllocator>
+class run_loop_task : public run_loop_task_base {
+ public:
+  run_loop_task(Function function, const ProtoAllocator &alloc)
+      : run_loop_task_base{&run_loop_task::execute},
+        function_{std::move(function)},
+        allocator_{alloc} {}
+
+  template <typename F>
+  static run_loop_task *allocate(F &&function, const ProtoAllocator &alloc) {
+    return detail::allocate_object<run_loop_task>(
+        alloc, std::forward<F>(function), alloc);
+  }
+
+ private:
+  struct deleter {
+    void operator()(run_loop_task *task) const noexcept {
+      auto alloc = task->allocator_;
+      detail::deallocate_object(alloc, task);
+    }
+  };
+
+  static void execute(run_loop_task_base *base, bool invoke) {
+    auto task = std::unique_ptr<run_loop_task, deleter>{
+        static_cast<run_loop_task *>(base)};
+    if (invoke) {
+      task->function_();
+    }
+  }
+
+  Function function_;
+  ProtoAllocator allocator_;
+};
+
+/*
+ * @brief Back-end of an execution context whose tasks are run by the thread
+ * which drives it through run(), run_one() or poll(). Any thread may enqueue
+ * tasks through a lock-free intrusive queue. While there is no work the
+ * driving thread parks on an atomic until a task is enqueued or the loop is
+ * finished.
+ */
+class run_loop_backend {
+ public:
+  template <typename Task, typename Function>
+  using transform_task_t =
+      typename thread_pool_transform_fusion<Task, Function>::type;
+
+  template <typename Executor, typename Task>
+  using via_task_t = enzen::thread_pool_via_task<Executor, Task>;
+
+  template <typename Task, typename Function>
+  using let_value_task_t = enzen::thread_pool_let_value_task<Task, Function>;
+
+  template <typename Task, typename Function, std::size_t Rank>
+  using bulk_task_t = enzen::thread_pool_bulk_task<Task, Function, Rank>;
+
+  using executor_t = basic_executor<detail::run_loop_backend,
+                                    detail::executor_interface::oneway, void>;
+
+  using sub_executor_t =
+      basic_executor<detail::run_loop_backend,
+                     detail::executor_interface::oneway, void>;
+
+  run_loop_backend() : epoch_{0}, finishing_{false}, drivingThread_{} {}
+
+  run_loop_backend(const run_loop_backend &) = delete;
+  run_loop_backend(run_loop_backend &&) = delete;
+  run_loop_backend &operator=(const run_loop_backend &) = delete;
+  run_loop_backend &operator=(run_loop_backend &&) = delete;
+
+  ~run_loop_backend() {
+    while (auto task = queue_.try_pop()) {
+      task->execute_and_destroy(false);
+    }
+  }
+
+  /*
+   * @brief Runs tasks on the calling thread until finish() has been called and
+   * no tasks remain.
+   * @return The number of tasks run.
+   */
+  std::size_t run() {
+    auto driver = driving_thread_guard{this};
+    auto numTasks = std::size_t{0};
+    while (run_one_task(true)) {
+      ++numTasks;
+    }
+    return numTasks;
+  }
+
+  /*
+   * @brief Runs at most one task on the calling thread, parking until a task
+   * is available unless finish() has been called.
+   * @return The number of tasks run.
+   */
+  std::size_t run_one() {
+    auto driver = driving_thread_guard{this};
+    return run_one_task(true) ? 1 : 0;
+  }
+
+  /*
+   * @brief Runs the tasks that are ready on the calling thread without
+   * parking.
+   * @return The number of tasks run.
+   */
+  std::size_t poll() {
+    auto driver = driving_thread_guard{this};
+    auto numTasks = std::size_t{0};
+    while (run_one_task(false)) {
+      ++numTasks;
+    }
+    return numTasks;
+  }
+
+  /*
+   * @brief Requests that run() returns once no tasks remain.
+   */
+  void finish() {
+    finishing_.store(true, std::memory_order_release);
+    wake();
+  }
+
+  std::size_t num_workers() const noexcept { return 1; }
+
+  template <typename KernelName, detail::executor_blocking Blocking,
+            typename Function, typename ProtoAllocator>
+  void execute(Function &&f, const ProtoAllocator &alloc) {
+    if constexpr (Blocking == detail::executor_blocking::always) {
+      // Blocking on the driving thread would never complete, so run the
+      // function in place instead.
+      if (is_driving_thread()) {
+        f();
+      } else {
+        auto complete = detail::event{};
+        this->enqueue_task(
+            [&f, &complete]() {
+              f();
+              complete.set();
+            },
+            alloc);
+        complete.wait();
+      }
+    } else {
+      this->enqueue_task(std::forward<Function>(f), alloc);
+    }
+  }
+
+  template <typename KernelName, detail::executor_blocking Blocking,
+            typename Function, std::size_t Rank, typename ProtoAllocator>
+  void bulk_execute(Function &&f, enzen::shape<Rank> shape,
+                    const mapping_t &mapping,
+                    const bulk_guarantee_t &bulkGuarantee,
+                    const ProtoAllocator &alloc) {
+    this->template execute<KernelName, Blocking>(
+        [f = std::forward<Function>(f), shape, mapping,
+         bulkGuarantee]() mutable {
+          detail::invoke_bulk(f, shape, mapping, bulkGuarantee);
+        },
+        alloc);
+  }
+
+  template <typename KernelName, detail::executor_blocking Blocking,
+            typename Function, typename ProtoAllocator>
+  auto twoway_execute(Function &&f, const ProtoAllocator &alloc) {
+    using return_type =
+        std::remove_cv_t<std::decay_t<decltype(std::declval<Function &&>()())>>;
+
+    auto prom = promise<return_type>{std::allocator_arg, alloc};
+    auto fut = prom.get_future();
+
+    this->template execute<KernelName, Blocking>(
+        [f = std::forward<Function>(f), prom = std::move(prom)]() mutable {
+          try {
+            prom.set_value(f());
+          } catch (...) {
+            prom.set_exception(std::current_exception());
+          }
+        },
+        alloc);
+    return fut;
+  }
+
+ private:
+  class driving_thread_guard {
+   public:
+    driving_thread_guard(run_loop_backend *loop) : loop_{loop} {
+      loop_->drivingThread_.store(std::this_thread::get_id(),
+                                  std::memory_order_relaxed);
+    }
+
+    ~driving_thread_guard() {
+      loop_->drivingThread_.store(std::thread::id{},
+                                  std::memory_order_relaxed);
+    }
+
+   private:
+    run_loop_backend *loop_;
+  };
+
+  template <typename Function, typename ProtoAllocator>
+  void enqueue_task(Function &&f, const ProtoAllocator &alloc) {
+    queue_.push(run_loop_task<std::decay_t<Function>, ProtoAllocator>::allocate(
+        std::forward<Function>(f), alloc));
+    wake();
+  }
+
+  bool run_one_task(bool parkWhenEmpty) {
+    while (true) {
+      auto epoch = epoch_.load(std::memory_order_acquire);
+
+      if (auto task = queue_.try_pop()) {
+        task->execute_and_destroy(true);
+        return true;
+      }
+
+      if (!parkWhenEmpty || finishing_.load(std::memory_order_acquire)) {
+        return false;
+      }
+
+      park(epoch);
+    }
+  }
+
+  bool is_driving_thread() const noexcept {
+    return drivingThread_.load(std::memory_order_relaxed) ==
+           std::this_thread::get_id();
+  }
+
+  void wake() {
+    epoch_.fetch_add(1, std::memory_order_acq_rel);
+#if defined(__cpp_lib_atomic_wait)
+    epoch_.notify_one();
+#else
+    auto lock = std::lock_guard<std::mutex>{parkMutex_};
+    parkCV_.notify_one();
+#endif  // defined(__cpp_lib_atomic_wait)
+  }
+
+  void park(std::uint32_t epoch) {
+#if defined(__cpp_lib_atomic_wait)
+    epoch_.wait(epoch, std::memory_order_acquire);
+#else
+    auto lock = std::unique_lock<std::mutex>{parkMutex_};
+    parkCV_.wait(lock, [&]() {
+      return epoch_.load(std::memory_order_acquire) != epoch;
+    });
+#endif  // defined(__cpp_lib_atomic_wait)
+  }
+
+  intrusive_mpsc_queue<run_loop_task_base> queue_;
+  std::atomic<std::uint32_t> epoch_;
+  std::atomic<bool> finishing_;
+  std::atomic<std::thread::id> drivingThread_;
+#if !defined(__cpp_lib_atomic_wait)
+  std::mutex parkMutex_;
+  std::condition_variable parkCV_;
+#endif  // !defined(__cpp_lib_atomic_wait)
+};
+
+}  // namespace enzen::detail
+
+#endif  // __ENZEN_RUN_LOOP_BACKEND_H__
@@ -0,0 +1,69 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_RUN_LOOP_EXECUTION_CONTEXT_H__
+#define __ENZEN_RUN_LOOP_EXECUTION_CONTEXT_H__
+
+namespace enzen {
+
+/*
+ * @brief Single threaded execution context whose tasks are run by the thread
+ * which drives it through run(), run_one() or poll(). Tasks may be submitted
+ * from any thread without locking.
+ */
+class run_loop {
+ public:
+  using executor_type = run_loop_executor;
+
+  run_loop() : impl_{std::make_shared<detail::run_loop_backend>()} {}
+
+  run_loop(const run_loop &) = delete;
+  run_loop(run_loop &&) = default;
+  run_loop &operator=(const run_loop &) = delete;
+  run_loop &operator=(run_loop &&) = default;
+
+  /*
+   * @brief Runs tasks until finish() has been called and no tasks remain.
+   * @return The number of tasks run.
+   */
+  std::size_t run() { return impl_->run(); }
+
+  /*
+   * @brief Runs at most one task, waiting for one unless finish() has been
+   * called.
+   * @return The number of tasks run.
+   */
+  std::size_t run_one() { return impl_->run_one(); }
+
+  /*
+   * @brief Runs the tasks which are ready without waiting.
+   * @return The number of tasks run.
+   */
+  std::size_t poll() { return impl_->poll(); }
+
+  void finish() { impl_->finish(); }
+
+  executor_type executor() noexcept {
+    return executor_type{impl_};
+  }
+
+ private:
+  std::shared_ptr<detail::run_loop_backend> impl_;
+};
+
+}  // namespace enzen
+
+#endif  // __ENZEN_RUN_LOOP_EXECUTION_CONTEXT_H__
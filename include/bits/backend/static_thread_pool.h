@@ -17,6 +17,9 @@ limitations under the License.
 #ifndef __ENZEN_BACKEND_STATIC_THREAD_POOL_H__
 #define __ENZEN_BACKEND_STATIC_THREAD_POOL_H__
 
+#include <bits/backend/static_thread_pool/stats.h>
+#include <bits/backend/static_thread_pool/slab_allocator.h>
+#include <bits/backend/static_thread_pool/partitioner.h>
 #include <bits/backend/static_thread_pool/tasks.h>
 #include <bits/backend/static_thread_pool/backend.h>
 #include <bits/backend/static_thread_pool/executor.h>
@@ -18,23 +18,164 @@ limitations under the License.
 #define __ENZEN_STATIC_THREAD_POOL_BACKEND_H__
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
-
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <bits/arena_allocator.h>
+#include <bits/backend/static_thread_pool/partitioner.h>
+#include <bits/backend/static_thread_pool/slab_allocator.h>
+#include <bits/backend/static_thread_pool/stats.h>
 #include <bits/concurrent_queue.h>
-#include <bits/debug.h>
+#include <bits/latency_histogram.h>
+#include <bits/probes.h>
+#include <bits/trace.h>
 
 namespace enzen::detail {
 
 enum class thread_pool_status : int { idle, running, shutdown, waiting, error };
 
+/*
+ * @brief Move-only function stored in the thread pool queue. Functions which
+ * fit in the inline buffer are stored in place without allocating, and larger
+ * functions are allocated with the allocator of the executor which submitted
+ * them.
+ */
+class thread_pool_task {
+  static constexpr std::size_t inline_size = 6 * sizeof(void *);
+
+  using storage_t =
+      std::aligned_storage_t<inline_size, alignof(std::max_align_t)>;
+
+  struct operations {
+    void (*invoke)(storage_t &);
+    // Move constructs the function into the destination and destroys the
+    // source.
+    void (*relocate)(storage_t &, storage_t &) noexcept;
+    void (*destroy)(storage_t &) noexcept;
+  };
+
+  template <typename Function>
+  static constexpr bool is_inline_v =
+      sizeof(Function) <= inline_size &&
+      alignof(Function) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible_v<Function>;
+
+  template <typename Function>
+  static Function &inline_function(storage_t &storage) noexcept {
+    return *std::launder(reinterpret_cast<Function *>(&storage));
+  }
+
+  template <typename Function, typename ProtoAllocator>
+  struct allocated_function {
+    Function function;
+    ProtoAllocator allocator;
+  };
+
+  template <typename Node>
+  static Node *&allocated_node(storage_t &storage) noexcept {
+    return *std::launder(reinterpret_cast<Node **>(&storage));
+  }
+
+  template <typename Function>
+  static constexpr operations inline_operations = {
+      [](storage_t &storage) { inline_function<Function>(storage)(); },
+      [](storage_t &from, storage_t &to) noexcept {
+        ::new (&to) Function(std::move(inline_function<Function>(from)));
+        inline_function<Function>(from).~Function();
+      },
+      [](storage_t &storage) noexcept {
+        inline_function<Function>(storage).~Function();
+      }};
+
+  template <typename Node>
+  static constexpr operations allocated_operations = {
+      [](storage_t &storage) { allocated_node<Node>(storage)->function(); },
+      [](storage_t &from, storage_t &to) noexcept {
+        ::new (&to) Node *{allocated_node<Node>(from)};
+      },
+      [](storage_t &storage) noexcept {
+        auto node = allocated_node<Node>(storage);
+        auto alloc = node->allocator;
+        detail::deallocate_object(alloc, node);
+      }};
+
+ public:
+  thread_pool_task() noexcept : operations_{nullptr} {}
+
+  template <typename Function, typename ProtoAllocator>
+  thread_pool_task(Function &&f, const ProtoAllocator &alloc) {
+    using function_t = std::decay_t<Function>;
+    if constexpr (is_inline_v<function_t>) {
+      ::new (&storage_) function_t(std::forward<Function>(f));
+      operations_ = &inline_operations<function_t>;
+    } else {
+      using node_t = allocated_function<function_t, ProtoAllocator>;
+      ::new (&storage_) node_t *{detail::allocate_object<node_t>(
+          alloc, node_t{std::forward<Function>(f), alloc})};
+      operations_ = &allocated_operations<node_t>;
+    }
+  }
+
+  thread_pool_task(thread_pool_task &&other) noexcept
+      : operations_{other.operations_} {
+    if (operations_) {
+      operations_->relocate(other.storage_, storage_);
+      other.operations_ = nullptr;
+    }
+  }
+
+  thread_pool_task &operator=(thread_pool_task &&other) noexcept {
+    if (this != &other) {
+      reset();
+      if (other.operations_) {
+        other.operations_->relocate(other.storage_, storage_);
+        operations_ = std::exchange(other.operations_, nullptr);
+      }
+    }
+    return *this;
+  }
+
+  thread_pool_task(const thread_pool_task &) = delete;
+  thread_pool_task &operator=(const thread_pool_task &) = delete;
+
+  ~thread_pool_task() { reset(); }
+
+  explicit operator bool() const noexcept { return operations_ != nullptr; }
+
+  void operator()() { operations_->invoke(storage_); }
+
+ private:
+  void reset() noexcept {
+    if (operations_) {
+      operations_->destroy(storage_);
+      operations_ = nullptr;
+    }
+  }
+
+  storage_t storage_;
+  const operations *operations_;
+};
+
 class thread_pool_backend {
  public:
   template <typename Task, typename Function>
-  using transform_task_t = enzen::thread_pool_transform_task<Task, Function>;
+  using transform_task_t =
+      typename thread_pool_transform_fusion<Task, Function>::type;
 
   template <typename Executor, typename Task>
   using via_task_t = enzen::thread_pool_via_task<Executor, Task>;
 
+  template <typename Task, typename Function>
+  using let_value_task_t = enzen::thread_pool_let_value_task<Task, Function>;
+
+  template <typename Task, typename Function, std::size_t Rank>
+  using bulk_task_t = enzen::thread_pool_bulk_task<Task, Function, Rank>;
+
   using executor_t = basic_executor<detail::thread_pool_backend,
                                     detail::executor_interface::oneway, void>;
 
@@ -42,7 +183,11 @@ class thread_pool_backend {
       basic_executor<detail::thread_pool_backend,
                      detail::executor_interface::oneway, void>;
 
-  thread_pool_backend(std::size_t numThreads) : numThreads_{numThreads} {
+  thread_pool_backend(std::size_t numThreads)
+      : numThreads_{numThreads},
+        workerCounters_{
+            std::make_unique<thread_pool_worker_counters[]>(numThreads)},
+        slabAllocator_{numThreads} {
     threadPoolStatus_ = thread_pool_status::idle;
     runningTasks_ = 0;
 
@@ -57,62 +202,74 @@ class thread_pool_backend {
   void start() {
     if (threadPoolStatus_ == thread_pool_status::idle) {
       auto workerFunc = [this](int threadPoolId) {
-        auto threadId = std::this_thread::get_id();
+        ENZEN_TRACE_WORKER(threadPoolId)
+        this->slabAllocator_.bind_worker(threadPoolId);
 
-        ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "startup ")
+        using clock_t = thread_pool_worker_counters::clock_t;
+        auto &counters = this->workerCounters_[threadPoolId];
 
         while (true) {
+          auto woken = false;
           {
             auto deferredLock =
                 std::unique_lock<std::mutex>{this->signalWorkersMutex_};
-            signalWorkersCV_.wait(deferredLock, [&]() {
-              return this->is_thread_wakeup_condition_met();
-            });
-            ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "wake up ")
+            if (!this->is_thread_wakeup_condition_met()) {
+              ENZEN_TRACE_EVENT(park, 0)
+              ENZEN_PROBE2(worker_park, this, threadPoolId)
+              auto parkTime = clock_t::now();
+              signalWorkersCV_.wait(deferredLock, [&]() {
+                return this->is_thread_wakeup_condition_met();
+              });
+              counters.woken(clock_t::now() - parkTime);
+              woken = true;
+              ENZEN_TRACE_EVENT(wake, 0)
+              ENZEN_PROBE2(worker_unpark, this, threadPoolId)
+            }
             deferredLock.unlock();
           }
 
           // No work left
           if (this->threadPoolStatus_ == thread_pool_status::waiting &&
               this->concurrentQueue_.empty()) {
-            ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "wait sat") {
-              auto lock = std::lock_guard<std::mutex>{signalHostMutex_};
-              signalHostCV_.notify_all();
-            }
+            auto lock = std::lock_guard<std::mutex>{signalHostMutex_};
+            signalHostCV_.notify_all();
           }
 
           // Exit condition
           if (concurrentQueue_.empty() &&
               this->threadPoolStatus_ == thread_pool_status::shutdown) {
-            ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "exit sat")
             break;
           }
 
-          auto currentTask = std::function<void()>{};
+          auto currentTask = thread_pool_task{};
 
           if (!this->concurrentQueue_.empty()) {
-            ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "inc task")
             this->runningTasks_++;
-            auto res = concurrentQueue_.try_pop(currentTask);
-            if (res) {
-              ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "pop     ")
-            } else {
-              ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "pop fail")
+            if (concurrentQueue_.try_pop(currentTask)) {
+              ENZEN_TRACE_EVENT(dequeue, 0)
+              ENZEN_PROBE2(task_dequeue, this, threadPoolId)
             }
 
             if (currentTask) {
-              ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "new task")
+              ENZEN_TRACE_EVENT(start, 0)
+              ENZEN_PROBE2(task_start, this, threadPoolId)
+              auto startTime = clock_t::now();
               currentTask();
-              ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "end task")
+              counters.task_executed(clock_t::now() - startTime);
+              ENZEN_TRACE_EVENT(end, 0)
+              ENZEN_PROBE2(task_finish, this, threadPoolId)
+            } else if (woken) {
+              counters.spurious_wakeup();
             }
-            ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "dec task")
+            // Free the closure before the task counts as finished, so that
+            // waiting on the pool also waits for the closures to be freed.
+            currentTask = thread_pool_task{};
             this->runningTasks_--;
-          } else {
-            ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "no tasks")
+          } else if (woken &&
+                     this->threadPoolStatus_ == thread_pool_status::running) {
+            counters.spurious_wakeup();
           }
         }
-
-        ENZEN_DEBUG_LOG(indent((threadPoolId + 1) * 9), "shutdown")
       };
 
       for (int i = 0; i < numThreads_; ++i) {
@@ -130,7 +287,6 @@ class thread_pool_backend {
         threadPoolStatus_ == thread_pool_status::waiting) {
       threadPoolStatus_ = thread_pool_status::shutdown;
       {
-        ENZEN_DEBUG_LOG(indent(0), "-> stop ")
         auto lock = std::lock_guard<std::mutex>{signalWorkersMutex_};
         signalWorkersCV_.notify_all();
       }
@@ -141,8 +297,8 @@ class thread_pool_backend {
 
   void wait() {
     if (threadPoolStatus_ == thread_pool_status::running) {
+      ENZEN_PROBE1(pool_wait_begin, this)
       {
-        ENZEN_DEBUG_LOG(indent(0), "-> wait ")
         auto lock = std::lock_guard<std::mutex>{signalWorkersMutex_};
         threadPoolStatus_ = thread_pool_status::waiting;
         signalWorkersCV_.notify_all();
@@ -152,30 +308,26 @@ class thread_pool_backend {
         auto deferredLock =
             std::unique_lock<std::mutex>{this->signalHostMutex_};
         signalHostCV_.wait(deferredLock, [&]() {
-          ENZEN_DEBUG_LOG(indent(0), "?? done ")
           return this->is_wait_complete_condition_met();
         });
         deferredLock.unlock();
-        ENZEN_DEBUG_LOG(indent(0), "<- done ")
       }
 
       {
         auto lock = std::lock_guard<std::mutex>{signalWorkersMutex_};
         threadPoolStatus_ = thread_pool_status::running;
-        ENZEN_DEBUG_LOG(indent(0), "-> run  ")
       }
+      ENZEN_PROBE1(pool_wait_end, this)
     }
   }
 
   void join() {
     {
-      ENZEN_DEBUG_LOG(indent(0), "-> shut ")
       auto lock = std::lock_guard<std::mutex>{signalWorkersMutex_};
       threadPoolStatus_ = thread_pool_status::shutdown;
       signalWorkersCV_.notify_all();
     }
 
-    ENZEN_DEBUG_LOG(indent(0), "= join =")
     for (auto &worker : workerThreads_) {
       if (worker.joinable()) {
         worker.join();
@@ -183,56 +335,87 @@ class thread_pool_backend {
     }
 
     {
-      ENZEN_DEBUG_LOG(indent(0), "-> idle ")
       auto lock = std::lock_guard<std::mutex>{signalWorkersMutex_};
       threadPoolStatus_ = thread_pool_status::idle;
     }
   }
 
-  template <typename KernalName, typename Function>
-  void execute(Function &&f, detail::executor_blocking blockingSemantics) {
-    this->enqueue_task(f);
+  template <typename KernalName, detail::executor_blocking Blocking,
+            typename Function, typename ProtoAllocator>
+  void execute(Function &&f, const ProtoAllocator &alloc) {
+    this->template enqueue_task<KernalName>(f, alloc);
     // TODO(Gordon): Should only wait on this task, not the context.
-    if (blockingSemantics == detail::executor_blocking::always ||
-        blockingSemantics == detail::executor_blocking::possibly) {
+    if constexpr (Blocking != detail::executor_blocking::never) {
       this->wait();
     }
   }
 
-  template <typename KernalName, typename Function>
-  void bulk_execute(Function &&f, shape shape,
-                    detail::executor_blocking blockingSemantics) {
-    this->bulk_enqueue_task(f, shape);
+  template <typename KernalName, detail::executor_blocking Blocking,
+            typename Function, std::size_t Rank, typename ProtoAllocator>
+  void bulk_execute(Function &&f, enzen::shape<Rank> shape,
+                    const mapping_t &mapping,
+                    const bulk_guarantee_t &bulkGuarantee,
+                    const ProtoAllocator &alloc) {
+    this->template bulk_enqueue_task<KernalName>(f, shape, mapping,
+                                                 bulkGuarantee, alloc);
     // TODO(Gordon): Should only wait on this task, not the context.
-    if (blockingSemantics == detail::executor_blocking::always ||
-        blockingSemantics == detail::executor_blocking::possibly) {
+    if constexpr (Blocking != detail::executor_blocking::never) {
       this->wait();
     }
   }
 
-  template <typename KernalName, typename Function>
-  auto twoway_execute(Function &&f,
-                      detail::executor_blocking blockingSemantics) {
+  template <typename KernalName, detail::executor_blocking Blocking,
+            typename Function, typename ProtoAllocator>
+  auto twoway_execute(Function &&f, const ProtoAllocator &alloc) {
     using return_type =
         std::remove_cv_t<std::decay_t<decltype(std::declval<Function &&>()())>>;
 
-    auto prom = promise<return_type>{};
+    auto prom = promise<return_type>{std::allocator_arg, alloc};
     auto fut = prom.get_future();
 
-    this->enqueue_task(
+    this->template enqueue_task<KernalName>(
         [f = std::forward<Function &&>(f), prom = std::move(prom)]() mutable {
           prom.set_value(f());
-        });
+        },
+        alloc);
     return fut;
   }
 
- private:
   std::size_t num_workers() const noexcept { return numThreads_; }
 
-  template <typename Function>
-  void enqueue_task(Function &&f) {
-    if (threadPoolStatus_ == thread_pool_status::running) {
-      concurrentQueue_.push(f);
+  thread_pool_stats stats() const {
+    auto stats = thread_pool_stats{concurrentQueue_.size(), runningTasks_, {},
+                                   slabAllocator_.external_stats()};
+    stats.workers.reserve(numThreads_);
+    for (std::size_t i = 0; i < numThreads_; ++i) {
+      stats.workers.push_back(workerCounters_[i].snapshot());
+      stats.workers.back().allocator = slabAllocator_.worker_stats(i);
+    }
+    return stats;
+  }
+
+ private:
+  /*
+   * @brief Returns the allocator for the closures of tasks submitted through
+   * an executor with the given allocator. With the default allocator,
+   * closures are allocated from the slabs of the pool.
+   */
+  template <typename ProtoAllocator>
+  auto task_allocator(const ProtoAllocator &alloc) noexcept {
+    if constexpr (std::is_same_v<ProtoAllocator, std::allocator<void>>) {
+      return thread_pool_task_allocator<void>{&slabAllocator_};
+    } else {
+      return alloc;
+    }
+  }
+
+  template <typename KernelName, typename Function, typename ProtoAllocator>
+  void enqueue_task(Function &&f, const ProtoAllocator &alloc) {
+    if (is_accepting_tasks()) {
+      concurrentQueue_.push(thread_pool_task{
+          detail::record_kernel_latency<KernelName>(f), task_allocator(alloc)});
+      ENZEN_TRACE_EVENT(enqueue, 1)
+      ENZEN_PROBE2(task_enqueue, this, 1)
       {
         auto lock = std::lock_guard<std::mutex>{signalWorkersMutex_};
         signalWorkersCV_.notify_one();
@@ -242,26 +425,106 @@ class thread_pool_backend {
     }
   }
 
-  template <typename Function>
-  void bulk_enqueue_task(Function &&f, shape shape) {
-    if (threadPoolStatus_ == thread_pool_status::running) {
-      for (size_t i = 0; i < shape[0]; ++i) {
-        for (size_t j = 0; j < shape[1]; ++j) {
-          for (size_t k = 0; k < shape[2]; ++k) {
-            auto idx = enzen::index{shape, i, j, k};
-            concurrentQueue_.push([f, idx]() { f(idx); });
-          }
+  template <typename KernelName, typename Function, std::size_t Rank,
+            typename ProtoAllocator>
+  void bulk_enqueue_task(Function &&f, enzen::shape<Rank> shape,
+                         const mapping_t &mapping,
+                         const bulk_guarantee_t &bulkGuarantee,
+                         const ProtoAllocator &alloc) {
+    if (is_accepting_tasks()) {
+      auto taskAlloc = task_allocator(alloc);
+      auto numTasks = shape.size();
+      if constexpr (detail::is_group_kernel_v<Function>) {
+        // One task per worker, each running its contiguous range of groups
+        // with the scratch memory of that worker, or a single task running
+        // every group in order when they are sequenced.
+        auto numGroups = detail::num_groups(f, shape);
+        numTasks = bulkGuarantee == bulk_guarantee_t::sequenced
+                       ? std::min<std::size_t>(numGroups, 1)
+                       : std::min(numGroups, numThreads_);
+        for (std::size_t chunk = 0; chunk < numTasks; ++chunk) {
+          auto [begin, end] = detail::chunk_bounds(numGroups, numTasks, chunk);
+          concurrentQueue_.push(thread_pool_task{
+              detail::record_kernel_latency<KernelName>(
+                  [f, shape, begin = begin, end = end]() mutable {
+                    detail::invoke_group_bulk(f, shape, begin, end);
+                  }),
+              taskAlloc});
+        }
+      } else if (bulkGuarantee == bulk_guarantee_t::sequenced) {
+        // A single task visiting every index in order on one worker.
+        numTasks = 1;
+        concurrentQueue_.push(thread_pool_task{
+            detail::record_kernel_latency<KernelName>(
+                [f, shape, mapping]() mutable {
+                  detail::invoke_bulk(f, shape, mapping);
+                }),
+            taskAlloc});
+      } else if (!detail::is_row_major<Rank>(mapping)) {
+        // One task per tile, so that neighbouring indices run on one worker.
+        auto tiling = std::allocate_shared<detail::bulk_tiling<Rank>>(
+            alloc, shape, mapping);
+        numTasks = tiling->num_tiles();
+        for (std::size_t tile = 0; tile < numTasks; ++tile) {
+          concurrentQueue_.push(thread_pool_task{
+              detail::record_kernel_latency<KernelName>(
+                  [f, tiling, tile]() mutable {
+                    tiling->invoke_bulk(f, tile, tile + 1);
+                  }),
+              taskAlloc});
+        }
+      } else {
+        // At most one task per worker, each claiming chunks of the iteration
+        // space which start coarse and are split finer as it runs out, no
+        // smaller than the grain size learned from previous launches of the
+        // kernel. Unsequenced invocations run in loops which can be
+        // vectorized.
+        auto partition = std::allocate_shared<detail::auto_partition>(
+            alloc, shape.size(), numThreads_,
+            detail::learned_grain_size<
+                detail::grain_size_key_t<KernelName, Function>>());
+        auto unsequenced = detail::is_range_kernel_v<Function> ||
+                           bulkGuarantee == bulk_guarantee_t::unsequenced;
+        numTasks = partition->num_tasks();
+        for (std::size_t task = 0; task < numTasks; ++task) {
+          concurrentQueue_.push(thread_pool_task{
+              detail::record_kernel_latency<KernelName>(
+                  [f, shape, partition, unsequenced]() mutable {
+                    partition->run([&](std::size_t begin, std::size_t end) {
+                      if (unsequenced) {
+                        detail::invoke_bulk_unsequenced(f, shape, begin, end);
+                      } else {
+                        detail::invoke_bulk(f, shape, begin, end);
+                      }
+                    });
+                  }),
+              taskAlloc});
         }
       }
+      ENZEN_TRACE_EVENT(enqueue, numTasks)
+      ENZEN_PROBE2(task_enqueue, this, numTasks)
       {
+        // Wake a worker for each task, so that they run concurrently rather
+        // than only once the host waits on the pool.
         auto lock = std::lock_guard<std::mutex>{signalWorkersMutex_};
-        signalWorkersCV_.notify_one();
+        if (numTasks > 1) {
+          signalWorkersCV_.notify_all();
+        } else {
+          signalWorkersCV_.notify_one();
+        }
       }
     } else {
       throw std::exception("Failed to schedule task, thread pool not running.");
     }
   }
 
+  // Tasks may also be enqueued while the host waits on the pool, so that
+  // running tasks can schedule further work.
+  bool is_accepting_tasks() const noexcept {
+    return (this->threadPoolStatus_ == thread_pool_status::running ||
+            this->threadPoolStatus_ == thread_pool_status::waiting);
+  }
+
   bool is_thread_wakeup_condition_met() const noexcept {
     if (this->threadPoolStatus_ == thread_pool_status::running) {
       return !concurrentQueue_.empty();
@@ -279,7 +542,11 @@ class thread_pool_backend {
   std::atomic<size_t> runningTasks_;
   std::size_t numThreads_;
   std::vector<std::thread> workerThreads_;
-  concurrent_queue<std::function<void()>> concurrentQueue_;
+  std::unique_ptr<thread_pool_worker_counters[]> workerCounters_;
+  // Declared before the queue, so that the closures of tasks which are still
+  // queued are freed before the slabs.
+  thread_pool_slab_allocator slabAllocator_;
+  concurrent_queue<thread_pool_task> concurrentQueue_;
   std::condition_variable signalWorkersCV_;
   std::condition_variable signalHostCV_;
   std::mutex signalWorkersMutex_;
@@ -17,8 +17,6 @@ limitations under the License.
 #ifndef __ENZEN_STATIC_THREAD_POOL_EXECUTION_CONTEXT_H__
 #define __ENZEN_STATIC_THREAD_POOL_EXECUTION_CONTEXT_H__
 
-#include <bits/debug.h>
-
 namespace enzen {
 
 class static_thread_pool {
@@ -27,7 +25,6 @@ class static_thread_pool {
 
   static_thread_pool(std::size_t numThreads)
       : impl_{std::make_shared<detail::thread_pool_backend>(numThreads)} {
-    ENZEN_LINE_BREAK()
     impl_->start();
   }
 
@@ -40,7 +37,6 @@ class static_thread_pool {
     impl_->stop();
     impl_->wait();
     impl_->join();
-    ENZEN_LINE_BREAK()
   }
 
   void attach() { impl_->attach(); }
@@ -49,8 +45,14 @@ class static_thread_pool {
 
   void wait() { impl_->wait(); }
 
+  /*
+   * @brief Returns a snapshot of the queue depth and of the counters of each
+   * worker.
+   */
+  thread_pool_stats stats() const { return impl_->stats(); }
+
   executor_type executor() noexcept {
-    return executor_type{impl_, detail::executor_blocking::possibly};
+    return executor_type{impl_};
   }
 
  private:
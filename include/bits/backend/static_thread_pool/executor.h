@@ -31,6 +31,13 @@ using static_thread_pool_executor =
 template <>
 struct is_executor<static_thread_pool_executor> : public std::true_type {};
 
+#if !ENZEN_CHECK_EXECUTOR_LIFETIME
+// Executors are copied by every task and receiver, so without lifetime
+// checking they must stay plain handles which fit in a cache line.
+static_assert(std::is_trivially_copyable_v<static_thread_pool_executor>);
+static_assert(sizeof(static_thread_pool_executor) <= 64);
+#endif  // !ENZEN_CHECK_EXECUTOR_LIFETIME
+
 }  // namespace enzen
 
 #endif  // __ENZEN_STATIC_THREAD_POOL_EXECUTOR_H__
\ No newline at end of file
@@ -0,0 +1,182 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_STATIC_THREAD_POOL_PARTITIONER_H__
+#define __ENZEN_STATIC_THREAD_POOL_PARTITIONER_H__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace enzen::detail {
+
+/*
+ * @brief Time in nanoseconds that a chunk of an auto-partitioned bulk
+ * operation should take once the grain size of its kernel has been learned,
+ * long enough for the cost of claiming the chunk to be negligible.
+ */
+inline constexpr std::uint64_t auto_partition_target_ns = 20000;
+
+/*
+ * @brief Each claim takes this fraction of the unclaimed indices divided by
+ * the number of workers, so that chunks start coarse and shrink as the
+ * iteration space runs out.
+ */
+inline constexpr std::size_t auto_partition_split = 2;
+
+/*
+ * @brief Returns the grain size learned from the previous launches of the
+ * bulk kernel identified by Kernel, or 0 if it has never completed a launch.
+ */
+template <typename Kernel>
+std::atomic<std::size_t> &learned_grain_size() noexcept {
+  static std::atomic<std::size_t> grainSize{0};
+  return grainSize;
+}
+
+/*
+ * @brief Type identifying a bulk kernel for grain size feedback: its kernel
+ * name, or the type of the function for a kernel without a name.
+ */
+template <typename KernelName, typename Function>
+using grain_size_key_t =
+    std::conditional_t<std::is_void_v<KernelName>, std::decay_t<Function>,
+                       KernelName>;
+
+/*
+ * @brief Shared state of an auto-partitioned bulk operation over the linear
+ * ids [0, size). Each of up to one task per worker claims chunks from a shared
+ * cursor until none are left. A claim takes 1 / (numWorkers *
+ * auto_partition_split) of what is unclaimed, but never less than the grain
+ * size, so the first chunks are coarse and later ones are split finer, which
+ * keeps every worker busy until the end without a task per index. The time
+ * spent running chunks is fed back into the learned grain size of the kernel
+ * once the operation completes, so that later launches start with chunks of
+ * about auto_partition_target_ns.
+ */
+class auto_partition {
+  using clock_t = std::chrono::steady_clock;
+
+ public:
+  /*
+   * @brief Constructs the partition of size indices over numWorkers workers,
+   * using and then updating learnedGrainSize.
+   */
+  auto_partition(std::size_t size, std::size_t numWorkers,
+                 std::atomic<std::size_t> &learnedGrainSize) noexcept
+      : size_{size},
+        numWorkers_{std::max<std::size_t>(numWorkers, 1)},
+        grainSize_{std::max<std::size_t>(
+            learnedGrainSize.load(std::memory_order_relaxed), 1)},
+        learnedGrainSize_{learnedGrainSize},
+        next_{0},
+        busyNanoseconds_{0},
+        remainingTasks_{num_tasks()} {}
+
+  /*
+   * @brief Returns the number of tasks to run the partition with: one per
+   * worker, but no more than there are grains.
+   */
+  std::size_t num_tasks() const noexcept {
+    return std::min(numWorkers_, (size_ + grainSize_ - 1) / grainSize_);
+  }
+
+  /*
+   * @brief Returns the minimum number of indices of a chunk.
+   */
+  std::size_t grain_size() const noexcept { return grainSize_; }
+
+  /*
+   * @brief Claims the next chunk [begin, end), returning false once every
+   * index has been claimed.
+   */
+  bool claim(std::size_t &begin, std::size_t &end) noexcept {
+    auto current = next_.load(std::memory_order_relaxed);
+    while (current < size_) {
+      auto remaining = size_ - current;
+      auto chunk = std::min(
+          remaining,
+          std::max(grainSize_,
+                   remaining / (numWorkers_ * auto_partition_split)));
+      if (next_.compare_exchange_weak(current, current + chunk,
+                                      std::memory_order_relaxed)) {
+        begin = current;
+        end = current + chunk;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /*
+   * @brief Runs one of the tasks of the partition, invoking
+   * runChunk(begin, end) for every chunk it claims. The last task to finish
+   * updates the learned grain size.
+   */
+  template <typename Function>
+  void run(Function &&runChunk) {
+    auto busyNanoseconds = std::uint64_t{0};
+    auto begin = std::size_t{0};
+    auto end = std::size_t{0};
+    while (claim(begin, end)) {
+      auto start = clock_t::now();
+      runChunk(begin, end);
+      busyNanoseconds += static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() -
+                                                               start)
+              .count());
+    }
+
+    busyNanoseconds_.fetch_add(busyNanoseconds, std::memory_order_relaxed);
+    if (remainingTasks_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      learn();
+    }
+  }
+
+ private:
+  // Sets the grain size to the number of indices which take
+  // auto_partition_target_ns at the rate measured for this launch, averaged
+  // with what was learned before to smooth out noisy launches.
+  void learn() noexcept {
+    auto busyNanoseconds = busyNanoseconds_.load(std::memory_order_relaxed);
+    auto measured =
+        busyNanoseconds == 0
+            ? size_
+            : static_cast<std::size_t>(auto_partition_target_ns * size_ /
+                                       busyNanoseconds);
+    measured = std::max<std::size_t>(measured, 1);
+
+    auto previous = learnedGrainSize_.load(std::memory_order_relaxed);
+    learnedGrainSize_.store(
+        previous == 0 ? measured : previous / 2 + measured / 2 + 1,
+        std::memory_order_relaxed);
+  }
+
+  std::size_t size_;
+  std::size_t numWorkers_;
+  std::size_t grainSize_;
+  std::atomic<std::size_t> &learnedGrainSize_;
+  std::atomic<std::size_t> next_;
+  std::atomic<std::uint64_t> busyNanoseconds_;
+  std::atomic<std::size_t> remainingTasks_;
+};
+
+}  // namespace enzen::detail
+
+#endif  // __ENZEN_STATIC_THREAD_POOL_PARTITIONER_H__
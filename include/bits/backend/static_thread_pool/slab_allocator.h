@@ -0,0 +1,397 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_STATIC_THREAD_POOL_SLAB_ALLOCATOR_H__
+#define __ENZEN_STATIC_THREAD_POOL_SLAB_ALLOCATOR_H__
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(ENZEN_THREAD_POOL_HUGE_PAGES) && defined(__linux__)
+#include <sys/mman.h>
+#endif  // defined(ENZEN_THREAD_POOL_HUGE_PAGES) && defined(__linux__)
+
+#include <bits/backend/static_thread_pool/stats.h>
+
+namespace enzen::detail {
+
+/*
+ * @brief Allocator of the task closures of a thread pool which do not fit
+ * inline in a queue entry. Each worker owns a heap of size-classed slabs
+ * which it allocates from without synchronisation, and threads outside the
+ * pool share a further heap guarded by a mutex. A block freed by a thread
+ * other than the owner of its heap is pushed onto a lock-free remote-free
+ * list of that heap, which the owner reclaims in one batch when a size class
+ * runs out of free blocks. Slabs are carved from large chunks, which are
+ * backed by huge pages when ENZEN_THREAD_POOL_HUGE_PAGES is defined, and are
+ * only released when the pool is destroyed.
+ */
+class thread_pool_slab_allocator {
+ public:
+  static constexpr std::size_t slab_size = 64 * 1024;
+  static constexpr std::size_t block_alignment = 64;
+  static constexpr std::size_t min_block_size = 64;
+  static constexpr std::size_t num_size_classes = 6;
+  static constexpr std::size_t max_block_size =
+      min_block_size << (num_size_classes - 1);
+#ifdef ENZEN_THREAD_POOL_HUGE_PAGES
+  static constexpr std::size_t chunk_size = 2 * 1024 * 1024;
+#else
+  static constexpr std::size_t chunk_size = 1024 * 1024;
+#endif  // ENZEN_THREAD_POOL_HUGE_PAGES
+
+ private:
+  struct free_node {
+    free_node *next;
+  };
+
+  class heap;
+
+  // Header at the start of each slab, so that a freed block can find the
+  // heap which owns it and its size class from its address alone.
+  struct slab_header {
+    heap *owner;
+    std::size_t sizeClass;
+  };
+
+  static constexpr std::size_t header_size = block_alignment;
+  static_assert(sizeof(slab_header) <= header_size);
+
+  class alignas(64) heap {
+    struct size_class_state {
+      free_node *freeList = nullptr;
+      std::byte *slab = nullptr;
+      std::size_t nextOffset = slab_size;
+    };
+
+   public:
+    void *allocate(std::size_t size, std::size_t alignment,
+                   thread_pool_slab_allocator &source) {
+      add(allocations_, 1);
+      add(bytesAllocated_, size);
+      if (size > max_block_size) {
+        add(fallbackAllocations_, 1);
+        return ::operator new(size, std::align_val_t{alignment});
+      }
+
+      auto sizeClass = size_class(size);
+      auto &state = classes_[sizeClass];
+      if (!state.freeList) {
+        reclaim_remote_frees();
+      }
+      if (auto node = state.freeList) {
+        state.freeList = node->next;
+        return node;
+      }
+
+      auto blockSize = block_size(sizeClass);
+      if (state.nextOffset + blockSize > slab_size) {
+        state.slab = source.acquire_slab();
+        ::new (state.slab) slab_header{this, sizeClass};
+        state.nextOffset = header_size;
+        add(slabs_, 1);
+      }
+      auto block = state.slab + state.nextOffset;
+      state.nextOffset += blockSize;
+      return block;
+    }
+
+    void free_local(void *ptr, std::size_t sizeClass) noexcept {
+      auto &state = classes_[sizeClass];
+      state.freeList = ::new (ptr) free_node{state.freeList};
+      add(localFrees_, 1);
+    }
+
+    void free_remote(void *ptr) noexcept {
+      auto node = ::new (ptr) free_node{
+          remoteFreeList_.load(std::memory_order_relaxed)};
+      while (!remoteFreeList_.compare_exchange_weak(
+          node->next, node, std::memory_order_release,
+          std::memory_order_relaxed)) {
+      }
+    }
+
+    thread_pool_allocator_stats snapshot() const noexcept {
+      return {allocations_.load(std::memory_order_relaxed),
+              bytesAllocated_.load(std::memory_order_relaxed),
+              fallbackAllocations_.load(std::memory_order_relaxed),
+              localFrees_.load(std::memory_order_relaxed),
+              remoteFreeCount_.load(std::memory_order_relaxed),
+              reclaimBatches_.load(std::memory_order_relaxed),
+              slabs_.load(std::memory_order_relaxed)};
+    }
+
+   private:
+    // Takes the whole remote-free list at once and returns its blocks to
+    // the free lists of their size classes.
+    void reclaim_remote_frees() noexcept {
+      auto node =
+          remoteFreeList_.exchange(nullptr, std::memory_order_acquire);
+      if (!node) {
+        return;
+      }
+      auto numFrees = std::uint64_t{0};
+      while (node) {
+        auto next = node->next;
+        auto &state = classes_[slab_of(node)->sizeClass];
+        node->next = state.freeList;
+        state.freeList = node;
+        node = next;
+        ++numFrees;
+      }
+      add(remoteFreeCount_, numFrees);
+      add(reclaimBatches_, 1);
+    }
+
+    // Counters are only written by the thread which owns the heap.
+    static void add(std::atomic<std::uint64_t> &counter,
+                    std::uint64_t value) noexcept {
+      counter.store(counter.load(std::memory_order_relaxed) + value,
+                    std::memory_order_relaxed);
+    }
+
+    std::array<size_class_state, num_size_classes> classes_;
+    std::atomic<std::uint64_t> allocations_{0};
+    std::atomic<std::uint64_t> bytesAllocated_{0};
+    std::atomic<std::uint64_t> fallbackAllocations_{0};
+    std::atomic<std::uint64_t> localFrees_{0};
+    std::atomic<std::uint64_t> remoteFreeCount_{0};
+    std::atomic<std::uint64_t> reclaimBatches_{0};
+    std::atomic<std::uint64_t> slabs_{0};
+
+    // Written by other threads, so kept off the cache lines of the owner.
+    alignas(64) std::atomic<free_node *> remoteFreeList_{nullptr};
+  };
+
+  struct chunk {
+    std::byte *memory;
+    bool mapped;
+  };
+
+  struct worker_binding {
+    const thread_pool_slab_allocator *allocator;
+    heap *workerHeap;
+  };
+
+ public:
+  explicit thread_pool_slab_allocator(std::size_t numWorkers)
+      : numWorkers_{numWorkers},
+        heaps_{std::make_unique<heap[]>(numWorkers + 1)},
+        chunkOffset_{chunk_size} {}
+
+  thread_pool_slab_allocator(const thread_pool_slab_allocator &) = delete;
+  thread_pool_slab_allocator &operator=(const thread_pool_slab_allocator &) =
+      delete;
+
+  ~thread_pool_slab_allocator() {
+    for (auto &c : chunks_) {
+      release_chunk(c);
+    }
+  }
+
+  /*
+   * @brief Makes the calling thread allocate from the heap of a worker. Must
+   * be called by each worker thread before it runs any task.
+   */
+  void bind_worker(std::size_t workerId) noexcept {
+    binding() = {this, &heaps_[workerId]};
+  }
+
+  /*
+   * @brief Allocates a block of size bytes aligned to alignment, which must
+   * be no greater than block_alignment. Blocks larger than max_block_size
+   * are allocated with the aligned global operator new.
+   */
+  void *allocate(std::size_t size,
+                 std::size_t alignment = alignof(std::max_align_t)) {
+    if (auto workerHeap = local_heap()) {
+      return workerHeap->allocate(size, alignment, *this);
+    }
+    auto lock = std::lock_guard<std::mutex>{externalMutex_};
+    return external_heap().allocate(size, alignment, *this);
+  }
+
+  /*
+   * @brief Frees a block returned by allocate with the same size and
+   * alignment.
+   */
+  void deallocate(void *ptr, std::size_t size,
+                  std::size_t alignment = alignof(std::max_align_t)) noexcept {
+    if (size > max_block_size) {
+      ::operator delete(ptr, std::align_val_t{alignment});
+      return;
+    }
+    auto header = slab_of(ptr);
+    if (header->owner == local_heap()) {
+      header->owner->free_local(ptr, header->sizeClass);
+    } else {
+      header->owner->free_remote(ptr);
+    }
+  }
+
+  thread_pool_allocator_stats worker_stats(std::size_t workerId) const {
+    return heaps_[workerId].snapshot();
+  }
+
+  thread_pool_allocator_stats external_stats() const {
+    return heaps_[numWorkers_].snapshot();
+  }
+
+ private:
+  static std::size_t size_class(std::size_t size) noexcept {
+    auto sizeClass = std::size_t{0};
+    while (block_size(sizeClass) < size) {
+      ++sizeClass;
+    }
+    return sizeClass;
+  }
+
+  static constexpr std::size_t block_size(std::size_t sizeClass) noexcept {
+    return min_block_size << sizeClass;
+  }
+
+  static slab_header *slab_of(void *ptr) noexcept {
+    return reinterpret_cast<slab_header *>(
+        reinterpret_cast<std::uintptr_t>(ptr) & ~(slab_size - 1));
+  }
+
+  static worker_binding &binding() noexcept {
+    thread_local worker_binding threadBinding{nullptr, nullptr};
+    return threadBinding;
+  }
+
+  heap *local_heap() const noexcept {
+    auto &threadBinding = binding();
+    return threadBinding.allocator == this ? threadBinding.workerHeap
+                                           : nullptr;
+  }
+
+  heap &external_heap() noexcept { return heaps_[numWorkers_]; }
+
+  std::byte *acquire_slab() {
+    auto lock = std::lock_guard<std::mutex>{chunkMutex_};
+    if (chunkOffset_ == chunk_size) {
+      chunks_.reserve(chunks_.size() + 1);
+      chunks_.push_back(allocate_chunk());
+      chunkOffset_ = 0;
+    }
+    auto slab = chunks_.back().memory + chunkOffset_;
+    chunkOffset_ += slab_size;
+    return slab;
+  }
+
+  // Chunks are aligned to the slab size, so that every slab is too.
+  static chunk allocate_chunk() {
+#if defined(ENZEN_THREAD_POOL_HUGE_PAGES) && defined(__linux__)
+    auto mapped = ::mmap(nullptr, chunk_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mapped != MAP_FAILED) {
+      return {static_cast<std::byte *>(mapped), true};
+    }
+    // Without reserved huge pages, ask for transparent huge pages instead.
+    auto memory = ::operator new(chunk_size, std::align_val_t{chunk_size});
+    ::madvise(memory, chunk_size, MADV_HUGEPAGE);
+    return {static_cast<std::byte *>(memory), false};
+#else
+    return {static_cast<std::byte *>(
+                ::operator new(chunk_size, std::align_val_t{chunk_size})),
+            false};
+#endif  // defined(ENZEN_THREAD_POOL_HUGE_PAGES) && defined(__linux__)
+  }
+
+  static void release_chunk(const chunk &c) noexcept {
+#if defined(ENZEN_THREAD_POOL_HUGE_PAGES) && defined(__linux__)
+    if (c.mapped) {
+      ::munmap(c.memory, chunk_size);
+      return;
+    }
+#endif  // defined(ENZEN_THREAD_POOL_HUGE_PAGES) && defined(__linux__)
+    ::operator delete(c.memory, std::align_val_t{chunk_size});
+  }
+
+  std::size_t numWorkers_;
+  std::unique_ptr<heap[]> heaps_;
+  std::mutex externalMutex_;
+  std::mutex chunkMutex_;
+  std::vector<chunk> chunks_;
+  std::size_t chunkOffset_;
+};
+
+/*
+ * @brief Allocator of the task closures submitted to a thread pool through
+ * an executor with the default allocator, which allocates from the slabs of
+ * the pool.
+ * @tparam T Type of the allocated objects.
+ */
+template <typename T>
+class thread_pool_task_allocator {
+ public:
+  using value_type = T;
+
+  explicit thread_pool_task_allocator(
+      thread_pool_slab_allocator *slabs) noexcept
+      : slabs_{slabs} {}
+
+  template <typename U>
+  thread_pool_task_allocator(
+      const thread_pool_task_allocator<U> &other) noexcept
+      : slabs_{other.slabs_} {}
+
+  T *allocate(std::size_t n) {
+    if constexpr (alignof(T) > thread_pool_slab_allocator::block_alignment) {
+      return static_cast<T *>(
+          ::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+    } else {
+      return static_cast<T *>(slabs_->allocate(n * sizeof(T), alignof(T)));
+    }
+  }
+
+  void deallocate(T *ptr, std::size_t n) noexcept {
+    if constexpr (alignof(T) > thread_pool_slab_allocator::block_alignment) {
+      ::operator delete(ptr, std::align_val_t{alignof(T)});
+    } else {
+      slabs_->deallocate(ptr, n * sizeof(T), alignof(T));
+    }
+  }
+
+  template <typename U>
+  friend bool operator==(const thread_pool_task_allocator &lhs,
+                         const thread_pool_task_allocator<U> &rhs) noexcept {
+    return lhs.slabs_ == rhs.slabs_;
+  }
+
+  template <typename U>
+  friend bool operator!=(const thread_pool_task_allocator &lhs,
+                         const thread_pool_task_allocator<U> &rhs) noexcept {
+    return lhs.slabs_ != rhs.slabs_;
+  }
+
+ private:
+  template <typename U>
+  friend class thread_pool_task_allocator;
+
+  thread_pool_slab_allocator *slabs_;
+};
+
+}  // namespace enzen::detail
+
+#endif  // __ENZEN_STATIC_THREAD_POOL_SLAB_ALLOCATOR_H__
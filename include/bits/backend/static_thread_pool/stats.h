@@ -0,0 +1,165 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_STATIC_THREAD_POOL_STATS_H__
+#define __ENZEN_STATIC_THREAD_POOL_STATS_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace enzen {
+
+/*
+ * @brief Counters of the slab heap from which a worker of a
+ * static_thread_pool, or the threads outside it, allocate task closures that
+ * do not fit inline in a queue entry.
+ */
+struct thread_pool_allocator_stats {
+  std::uint64_t allocations;
+  std::uint64_t bytes_allocated;
+  // Allocations larger than the largest size class, served by operator new.
+  std::uint64_t fallback_allocations;
+  // Frees by the thread which owns the heap.
+  std::uint64_t local_frees;
+  // Frees by other threads, counted once the owner reclaims them from its
+  // remote-free list.
+  std::uint64_t remote_frees;
+  std::uint64_t reclaim_batches;
+  std::uint64_t slabs;
+
+  double remote_free_rate() const noexcept {
+    auto frees = local_frees + remote_frees;
+    return frees == 0 ? 0.0 : static_cast<double>(remote_frees) / frees;
+  }
+
+  thread_pool_allocator_stats &operator+=(
+      const thread_pool_allocator_stats &other) noexcept {
+    allocations += other.allocations;
+    bytes_allocated += other.bytes_allocated;
+    fallback_allocations += other.fallback_allocations;
+    local_frees += other.local_frees;
+    remote_frees += other.remote_frees;
+    reclaim_batches += other.reclaim_batches;
+    slabs += other.slabs;
+    return *this;
+  }
+};
+
+/*
+ * @brief Counters of a single worker of a static_thread_pool.
+ */
+struct thread_pool_worker_stats {
+  std::uint64_t tasks_executed;
+  std::chrono::nanoseconds busy_time;
+  std::chrono::nanoseconds idle_time;
+  std::uint64_t wakeups;
+  // Wakeups after which the worker found no task to run, because another
+  // worker took it first.
+  std::uint64_t spurious_wakeups;
+  thread_pool_allocator_stats allocator;
+};
+
+/*
+ * @brief Snapshot of the state of a static_thread_pool. Counters are read
+ * individually without synchronising with the workers, so a snapshot taken
+ * while tasks are running is approximate.
+ */
+struct thread_pool_stats {
+  std::size_t queue_depth;
+  std::size_t running_tasks;
+  std::vector<thread_pool_worker_stats> workers;
+  // Allocations by threads outside the pool.
+  thread_pool_allocator_stats external_allocator;
+
+  std::uint64_t tasks_executed() const noexcept {
+    auto total = std::uint64_t{0};
+    for (auto &worker : workers) {
+      total += worker.tasks_executed;
+    }
+    return total;
+  }
+
+  thread_pool_allocator_stats allocator_totals() const noexcept {
+    auto total = external_allocator;
+    for (auto &worker : workers) {
+      total += worker.allocator;
+    }
+    return total;
+  }
+};
+
+namespace detail {
+
+/*
+ * @brief Counters of a worker, padded to a cache line so that workers do not
+ * contend on each other's counters. Each counter is written only by its
+ * worker, so it is updated with a relaxed load and store rather than a locked
+ * read-modify-write.
+ */
+class alignas(64) thread_pool_worker_counters {
+ public:
+  using clock_t = std::chrono::steady_clock;
+
+  void task_executed(clock_t::duration busyTime) noexcept {
+    add(tasksExecuted_, 1);
+    add(busyNanoseconds_, to_nanoseconds(busyTime));
+  }
+
+  void woken(clock_t::duration idleTime) noexcept {
+    add(wakeups_, 1);
+    add(idleNanoseconds_, to_nanoseconds(idleTime));
+  }
+
+  void spurious_wakeup() noexcept { add(spuriousWakeups_, 1); }
+
+  thread_pool_worker_stats snapshot() const noexcept {
+    return {tasksExecuted_.load(std::memory_order_relaxed),
+            std::chrono::nanoseconds{
+                busyNanoseconds_.load(std::memory_order_relaxed)},
+            std::chrono::nanoseconds{
+                idleNanoseconds_.load(std::memory_order_relaxed)},
+            wakeups_.load(std::memory_order_relaxed),
+            spuriousWakeups_.load(std::memory_order_relaxed),
+            {}};
+  }
+
+ private:
+  static std::uint64_t to_nanoseconds(clock_t::duration duration) noexcept {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+            .count());
+  }
+
+  static void add(std::atomic<std::uint64_t> &counter,
+                  std::uint64_t value) noexcept {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+
+  std::atomic<std::uint64_t> tasksExecuted_{0};
+  std::atomic<std::uint64_t> busyNanoseconds_{0};
+  std::atomic<std::uint64_t> idleNanoseconds_{0};
+  std::atomic<std::uint64_t> wakeups_{0};
+  std::atomic<std::uint64_t> spuriousWakeups_{0};
+};
+
+}  // namespace detail
+
+}  // namespace enzen
+
+#endif  // __ENZEN_STATIC_THREAD_POOL_STATS_H__
@@ -17,20 +17,92 @@ limitations under the License.
 #ifndef __ENZEN_STATIC_THREAD_POOL_TASKS_H__
 #define __ENZEN_STATIC_THREAD_POOL_TASKS_H__
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
 namespace enzen {
 
+template <typename Task, typename Function>
+class thread_pool_transform_task;
+
+namespace detail {
+
+/*
+ * @brief Function object which composes two transform functions into a single
+ * callable, so that a run of transform stages executes as one invocation.
+ * @tparam First Function applied to the incoming value.
+ * @tparam Second Function applied to the result of First.
+ */
+template <typename First, typename Second>
+class composed_function {
+ public:
+  composed_function(First first, Second second)
+      : first_{std::move(first)}, second_{std::move(second)} {}
+
+  template <typename Value>
+  auto operator()(Value &&value) {
+    return std::invoke(second_,
+                       std::invoke(first_, static_cast<Value &&>(value)));
+  }
+
+ private:
+  First first_;
+  Second second_;
+};
+
+/*
+ * @brief Trait which computes the task type produced by applying a transform
+ * to a task. A transform of a transform task is fused with it at compile time,
+ * so nested transforms collapse into a single task and a single receiver.
+ * Defining ENZEN_NO_TRANSFORM_FUSION disables this.
+ * @tparam Task Task being transformed.
+ * @tparam Function Function of the new transform stage.
+ */
+template <typename Task, typename Function>
+struct thread_pool_transform_fusion {
+  using type = thread_pool_transform_task<Task, Function>;
+};
+
+#ifndef ENZEN_NO_TRANSFORM_FUSION
+template <typename Task, typename First, typename Second>
+struct thread_pool_transform_fusion<thread_pool_transform_task<Task, First>,
+                                    Second> {
+  using type =
+      thread_pool_transform_task<Task, composed_function<First, Second>>;
+};
+#endif  // ENZEN_NO_TRANSFORM_FUSION
+
+}  // namespace detail
+
 template <typename Task, typename Function>
 class thread_pool_transform_task {
+  template <typename, typename>
+  friend class thread_pool_transform_task;
+
   template <typename Receiver>
   class wrapped_receiver {
    public:
     wrapped_receiver(Function function, Receiver receiver)
         : function_{function}, receiver_{receiver} {}
 
+    // Only exceptions thrown by the function complete the receiver with an
+    // error, as one thrown by the receiver itself follows a completion.
     template <typename Value>
     void value(Value &&value) {
-      enzen::set_value(receiver_, std::invoke(std::move(function_),
-                                              static_cast<Value &&>(value)));
+      auto result = std::optional<std::invoke_result_t<Function, Value &&>>{};
+      try {
+        result.emplace(std::invoke(std::move(function_),
+                                   static_cast<Value &&>(value)));
+      } catch (...) {
+        enzen::set_error(receiver_, std::current_exception());
+        return;
+      }
+      enzen::set_value(receiver_, std::move(*result));
     }
 
     void done() { enzen::set_done(receiver_); }
@@ -46,10 +118,23 @@ class thread_pool_transform_task {
 
  public:
   using executor_t = typename Task::executor_t;
+  using value_t = std::invoke_result_t<Function, typename Task::value_t>;
 
   thread_pool_transform_task(Task task, Function function)
       : task_{task}, function_{function} {}
 
+  /*
+   * @brief Constructs a transform task by fusing the function of an existing
+   * transform task with a further function.
+   */
+  template <typename First, typename Second,
+            typename = std::enable_if_t<std::is_same_v<
+                Function, detail::composed_function<First, Second>>>>
+  thread_pool_transform_task(thread_pool_transform_task<Task, First> task,
+                             Second function)
+      : task_{std::move(task.task_)},
+        function_{std::move(task.function_), std::move(function)} {}
+
   template <typename Receiver>
   void submit(Receiver receiver) noexcept {
     try {
@@ -61,6 +146,14 @@ class thread_pool_transform_task {
     }
   }
 
+  executor_t get_executor() const noexcept { return task_.get_executor(); }
+
+  auto require_never_blocking() const {
+    auto task = detail::require_never_blocking(task_);
+    return thread_pool_transform_task<decltype(task), Function>{
+        std::move(task), function_};
+  }
+
  private:
   Task task_;
   Function function_;
@@ -99,7 +192,7 @@ class thread_pool_via_task {
 
     template <typename SubExecutor>
     void value([[maybe_unused]] SubExecutor subExecutor) {
-      enzen::set_error(receiver_, std::forward<ErrorType>(error));
+      enzen::set_error(receiver_, std::move(error_));
     }
 
     template <typename SchedulingError>
@@ -150,7 +243,7 @@ class thread_pool_via_task {
     void done() {
       if (!valueCalled_) {
         enzen::submit(executor_.schedule(),
-                      done_receiver<R>{std::move(receiver_)});
+                      done_receiver<Receiver>{std::move(receiver_)});
       }
     }
 
@@ -173,6 +266,7 @@ class thread_pool_via_task {
 
  public:
   using executor_t = Executor;
+  using value_t = typename Task::value_t;
 
   thread_pool_via_task(Executor executor, Task task)
       : executor_{std::move(executor)}, task_{std::move(task)} {}
@@ -189,11 +283,307 @@ class thread_pool_via_task {
     }
   }
 
+  Executor get_executor() const noexcept { return executor_; }
+
+  auto require_never_blocking() const {
+    auto executor = enzen::require(executor_, enzen::blocking.never);
+    auto task = detail::require_never_blocking(task_);
+    return thread_pool_via_task<decltype(executor), decltype(task)>{
+        std::move(executor), std::move(task)};
+  }
+
  private:
   Executor executor_;
   Task task_;
 };
 
+template <typename Task, typename Function>
+class thread_pool_let_value_task {
+  template <typename Receiver>
+  class let_value_receiver {
+   public:
+    let_value_receiver(Function function, Receiver receiver)
+        : function_{function}, receiver_{receiver} {}
+
+    // The task returned by the function is submitted directly with the
+    // downstream receiver, so no thread is held while the nested work is
+    // outstanding. The value is moved into the function, so the returned task
+    // must own any state it requires. The receiver is copied rather than
+    // moved, so that it can still be completed with an error if the function
+    // or the submission throws.
+    template <typename Value>
+    void value(Value &&value) {
+      try {
+        enzen::submit(
+            std::invoke(std::move(function_), static_cast<Value &&>(value)),
+            receiver_);
+      } catch (...) {
+        enzen::set_error(receiver_, std::current_exception());
+      }
+    }
+
+    void done() { enzen::set_done(receiver_); }
+
+    template <typename Error>
+    void error(Error &&error) noexcept {
+      enzen::set_error(receiver_, static_cast<Error &&>(error));
+    }
+
+   private:
+    Function function_;
+    Receiver receiver_;
+  };
+
+ public:
+  using executor_t = typename Task::executor_t;
+  using next_task_t = std::invoke_result_t<Function, typename Task::value_t>;
+  using value_t = typename next_task_t::value_t;
+
+  thread_pool_let_value_task(Task task, Function function)
+      : task_{std::move(task)}, function_{std::move(function)} {}
+
+  template <typename Receiver>
+  void submit(Receiver receiver) noexcept {
+    try {
+      enzen::submit(std::move(task_),
+                    let_value_receiver<Receiver>{std::move(function_),
+                                                 std::move(receiver)});
+    } catch (...) {
+      enzen::set_error(receiver, std::current_exception());
+    }
+  }
+
+  executor_t get_executor() const noexcept { return task_.get_executor(); }
+
+  // The tasks returned by the function are required to be never blocking as
+  // well, as they are submitted from wherever the value is produced.
+  auto require_never_blocking() const {
+    auto task = detail::require_never_blocking(task_);
+    auto function = [function = function_](auto &&value) mutable {
+      return detail::require_never_blocking(std::invoke(
+          std::move(function), static_cast<decltype(value) &&>(value)));
+    };
+    return thread_pool_let_value_task<decltype(task), decltype(function)>{
+        std::move(task), std::move(function)};
+  }
+
+ private:
+  Task task_;
+  Function function_;
+};
+
+template <typename Task, typename Function, std::size_t Rank>
+class thread_pool_bulk_task {
+  /*
+   * @brief State shared between the chunks of a single bulk operation. The
+   * last chunk to finish completes the downstream receiver.
+   */
+  template <typename Value, typename Receiver>
+  class bulk_state {
+   public:
+    bulk_state(Value value, Function function, Receiver receiver,
+               std::optional<detail::bulk_tiling<Rank>> tiling,
+               bulk_guarantee_t bulkGuarantee, std::size_t numChunks)
+        : value_{std::move(value)},
+          function_{std::move(function)},
+          receiver_{std::move(receiver)},
+          tiling_{std::move(tiling)},
+          bulkGuarantee_{bulkGuarantee},
+          remainingChunks_{numChunks},
+          failed_{false} {}
+
+    // Runs the indices [begin, end) of a row-major mapping, the tiles
+    // [begin, end) of any other mapping, or the groups [begin, end) of a
+    // group kernel. The stages of a fused bulk function are run one block of
+    // indices, or one tile, at a time.
+    void run_chunk(enzen::shape<Rank> shape, std::size_t begin,
+                   std::size_t end) noexcept {
+      auto runStage = [&](auto &function, std::size_t first,
+                          std::size_t last) {
+        if (tiling_) {
+          tiling_->invoke_bulk(function, first, last, value_);
+        } else if (bulkGuarantee_ == bulk_guarantee_t::unsequenced) {
+          detail::invoke_bulk_unsequenced(function, shape, first, last,
+                                          value_);
+        } else {
+          detail::invoke_bulk(function, shape, first, last, value_);
+        }
+      };
+
+      try {
+        if constexpr (detail::is_group_kernel_v<Function>) {
+          detail::invoke_group_bulk(function_, shape, begin, end, value_);
+        } else if constexpr (detail::is_fused_bulk_v<Function>) {
+          function_.invoke_blocks(
+              begin, end, tiling_ ? 1 : detail::fused_bulk_block_size,
+              runStage);
+        } else {
+          runStage(function_, begin, end);
+        }
+      } catch (...) {
+        fail(std::current_exception());
+      }
+
+      finish_chunks(1);
+    }
+
+    // Records the first exception thrown by any of the chunks.
+    void fail(std::exception_ptr exception) noexcept {
+      if (!failed_.exchange(true, std::memory_order_relaxed)) {
+        exception_ = std::move(exception);
+      }
+    }
+
+    // Counts numChunks chunks as finished, and completes the downstream
+    // receiver if they were the last.
+    void finish_chunks(std::size_t numChunks) {
+      if (remainingChunks_.fetch_sub(numChunks, std::memory_order_acq_rel) ==
+          numChunks) {
+        complete();
+      }
+    }
+
+    void complete() {
+      if (failed_.load(std::memory_order_relaxed)) {
+        enzen::set_error(receiver_, exception_);
+      } else {
+        enzen::set_value(receiver_, std::move(value_));
+      }
+    }
+
+   private:
+    Value value_;
+    Function function_;
+    Receiver receiver_;
+    std::optional<detail::bulk_tiling<Rank>> tiling_;
+    bulk_guarantee_t bulkGuarantee_;
+    std::atomic<std::size_t> remainingChunks_;
+    std::atomic<bool> failed_;
+    std::exception_ptr exception_;
+  };
+
+  template <typename Receiver>
+  class bulk_receiver {
+   public:
+    bulk_receiver(typename Task::executor_t executor,
+                  enzen::shape<Rank> shape,
+                  Function function, Receiver receiver)
+        : executor_{std::move(executor)},
+          shape_{shape},
+          function_{std::move(function)},
+          receiver_{std::move(receiver)} {}
+
+    template <typename Value>
+    void value(Value value) {
+      using state_t = bulk_state<std::decay_t<Value>, Receiver>;
+
+      // Chunks are ranges of indices for a row-major mapping, ranges of
+      // tiles for any other mapping, and ranges of groups for a group kernel.
+      auto mapping = executor_.query(enzen::mapping);
+      auto tiling = std::optional<detail::bulk_tiling<Rank>>{};
+      auto numElements = shape_.size();
+      if constexpr (detail::is_group_kernel_v<Function>) {
+        numElements = detail::num_groups(function_, shape_);
+      } else if (!detail::is_row_major<Rank>(mapping)) {
+        tiling.emplace(shape_, mapping);
+        numElements = tiling->num_tiles();
+      }
+
+      // Sequenced invocations all run in order in a single chunk.
+      auto bulkGuarantee = executor_.query(enzen::bulk_guarantee);
+      auto numChunks =
+          bulkGuarantee == bulk_guarantee_t::sequenced
+              ? std::min<std::size_t>(numElements, 1)
+              : std::min(numElements, executor_.get_impl()->num_workers());
+
+      // The state is allocated with the allocator of the executor, as are the
+      // tasks which run the chunks.
+      auto state = std::allocate_shared<state_t>(
+          executor_.query(enzen::allocator), std::move(value),
+          std::move(function_), std::move(receiver_), std::move(tiling),
+          bulkGuarantee, numChunks);
+
+      if (numChunks == 0) {
+        state->complete();
+        return;
+      }
+
+      auto chunkExec = enzen::require(
+          enzen::require_concept(executor_, enzen::oneway),
+          enzen::blocking.never);
+
+      // Split the iteration space into contiguous ranges, one per chunk, with
+      // the remainder spread over the leading chunks.
+      auto chunkSize = numElements / numChunks;
+      auto remainder = numElements % numChunks;
+      auto begin = std::size_t{0};
+      for (std::size_t chunk = 0; chunk < numChunks; ++chunk) {
+        auto end = begin + chunkSize + (chunk < remainder ? 1 : 0);
+        try {
+          chunkExec.execute([state, shape = shape_, begin, end]() {
+            state->run_chunk(shape, begin, end);
+          });
+        } catch (...) {
+          // The chunks which were never enqueued count as finished, so that
+          // the receiver is completed with the error once those which were
+          // have run.
+          state->fail(std::current_exception());
+          state->finish_chunks(numChunks - chunk);
+          return;
+        }
+        begin = end;
+      }
+    }
+
+    void done() { enzen::set_done(receiver_); }
+
+    template <typename Error>
+    void error(Error &&error) noexcept {
+      enzen::set_error(receiver_, static_cast<Error &&>(error));
+    }
+
+   private:
+    typename Task::executor_t executor_;
+    enzen::shape<Rank> shape_;
+    Function function_;
+    Receiver receiver_;
+  };
+
+ public:
+  using executor_t = typename Task::executor_t;
+  using value_t = typename Task::value_t;
+
+  thread_pool_bulk_task(Task task, enzen::shape<Rank> shape,
+                        Function function)
+      : task_{std::move(task)}, shape_{shape}, function_{std::move(function)} {}
+
+  template <typename Receiver>
+  void submit(Receiver receiver) noexcept {
+    try {
+      auto executor = task_.get_executor();
+      enzen::submit(std::move(task_),
+                    bulk_receiver<Receiver>{std::move(executor), shape_,
+                                            std::move(function_),
+                                            std::move(receiver)});
+    } catch (...) {
+      enzen::set_error(receiver, std::current_exception());
+    }
+  }
+
+  executor_t get_executor() const noexcept { return task_.get_executor(); }
+
+  auto require_never_blocking() const {
+    auto task = detail::require_never_blocking(task_);
+    return thread_pool_bulk_task<decltype(task), Function, Rank>{
+        std::move(task), shape_, function_};
+  }
+
+ private:
+  Task task_;
+  enzen::shape<Rank> shape_;
+  Function function_;
+};
+
 }  // namespace enzen
 
 #endif  // __ENZEN_STATIC_THREAD_POOL_TASKS_H__
\ No newline at end of file
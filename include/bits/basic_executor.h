@@ -17,9 +17,19 @@ limitations under the License.
 #ifndef __ENZEN_BASIC_EXECUTOR_H__
 #define __ENZEN_BASIC_EXECUTOR_H__
 
+#include <cassert>
 #include <iterator>
-
-#include <bits/debug.h>
+#include <memory>
+
+// Executors do not own their back-end. In debug builds they also hold a weak
+// reference to it, to detect use after the execution context is destroyed.
+#ifndef ENZEN_CHECK_EXECUTOR_LIFETIME
+#ifdef NDEBUG
+#define ENZEN_CHECK_EXECUTOR_LIFETIME 0
+#else
+#define ENZEN_CHECK_EXECUTOR_LIFETIME 1
+#endif  // NDEBUG
+#endif  // ENZEN_CHECK_EXECUTOR_LIFETIME
 
 namespace enzen {
 
@@ -35,33 +45,110 @@ enum class executor_interface {
 
 enum class executor_blocking { always, never, possibly };
 
+/*
+ * @brief Trait for whether a back-end runs every function to completion
+ * before the submission returns, whatever blocking semantics are required.
+ */
+template <typename Backend>
+struct is_always_blocking_backend : public std::false_type {};
+
+/*
+ * @brief Non-owning reference from an executor to the back-end of its
+ * execution context. Copying it is a pointer copy, so executors can be copied
+ * freely by tasks and receivers without contending on a reference count. The
+ * back-end must outlive every executor referring to it.
+ */
+template <typename Backend>
+class backend_ref {
+ public:
+  backend_ref() : impl_{nullptr} {}
+
+  backend_ref(const std::shared_ptr<Backend> &impl) : impl_{impl.get()} {
+#if ENZEN_CHECK_EXECUTOR_LIFETIME
+    lifetime_ = impl;
+#endif  // ENZEN_CHECK_EXECUTOR_LIFETIME
+  }
+
+  Backend *get() const noexcept {
+#if ENZEN_CHECK_EXECUTOR_LIFETIME
+    assert(!lifetime_.expired() &&
+           "executor used after its execution context was destroyed");
+#endif  // ENZEN_CHECK_EXECUTOR_LIFETIME
+    return impl_;
+  }
+
+  Backend *operator->() const noexcept { return get(); }
+
+  friend bool operator==(const backend_ref &lhs,
+                         const backend_ref &rhs) noexcept {
+    return lhs.impl_ == rhs.impl_;
+  }
+
+ private:
+  Backend *impl_;
+#if ENZEN_CHECK_EXECUTOR_LIFETIME
+  std::weak_ptr<Backend> lifetime_;
+#endif  // ENZEN_CHECK_EXECUTOR_LIFETIME
+};
+
 }  // namespace detail
 
+/*
+ * @brief Executor of a back-end. The interface, kernel name, blocking
+ * semantics and allocator are all part of the executor type, so requiring a
+ * property returns an executor of a different type and the back-end can
+ * resolve the blocking semantics of each submission at compile time.
+ */
 template <typename Backend,
           detail::executor_interface Interface =
               detail::executor_interface::oneway,
-          typename KernelName = void>
+          typename KernelName = void,
+          detail::executor_blocking Blocking =
+              detail::executor_blocking::possibly,
+          typename ProtoAllocator = std::allocator<void>>
 class basic_executor {
  public:
   using backend_t = Backend;
-  using sub_executor_t = typename Backend::sub_executor_t;
   using kernel_name_t = KernelName;
 
+  using allocator_type = ProtoAllocator;
+
+  template <detail::executor_blocking OtherBlocking>
+  using rebind_blocking_t = basic_executor<Backend, Interface, KernelName,
+                                           OtherBlocking, ProtoAllocator>;
+
+  template <typename OtherProtoAllocator>
+  using rebind_allocator_t = basic_executor<Backend, Interface, KernelName,
+                                            Blocking, OtherProtoAllocator>;
+
+  using sub_executor_t = typename Backend::sub_executor_t::
+      template rebind_blocking_t<Blocking>::template rebind_allocator_t<
+          ProtoAllocator>;
+
   struct schedule_task {
-    schedule_task(basic_executor<Backend, Interface, KernelName> taskExec)
-        : taskExec_{taskExec} {}
+    using executor_t = basic_executor<Backend, Interface, KernelName,
+                                      Blocking, ProtoAllocator>;
+    using value_t = sub_executor_t;
+
+    schedule_task(executor_t taskExec) : taskExec_{taskExec} {}
 
     template <typename Receiver>
     void submit(Receiver &&receiver) {
-      taskExec_.impl_->template execute<KernelName>(
+      taskExec_.impl_->template execute<KernelName, Blocking>(
           [receiver = std::forward<Receiver &&>(receiver),
            subExec = taskExec_.get_sub_executor()]() {
             set_value(receiver, subExec);
           },
-          taskExec_.get_blocking_semantics());
+          taskExec_.allocator_);
     }
 
-    basic_executor<Backend, Interface, KernelName> taskExec_;
+    executor_t get_executor() const noexcept { return taskExec_; }
+
+    auto require_never_blocking() const {
+      return taskExec_.require(blocking_t::never_t{}).schedule();
+    }
+
+    executor_t taskExec_;
   };
 
   basic_executor() = default;
@@ -72,73 +159,133 @@ class basic_executor {
 
   inline friend bool operator==(const basic_executor &lhs,
                                 const basic_executor &rhs) {
-    return true;
+    return lhs.impl_ == rhs.impl_;
   }
 
   // TODO (Gordon): This constructor should be private, needs to be fixed.
-  basic_executor(std::shared_ptr<Backend> impl,
-                 detail::executor_blocking blockingSemantics)
-      : impl_{impl}, blockingSemantics_{blockingSemantics} {}
+  explicit basic_executor(detail::backend_ref<Backend> impl,
+                          mapping_t mapping = {},
+                          bulk_guarantee_t bulkGuarantee = {},
+                          ProtoAllocator alloc = {})
+      : impl_{impl},
+        mapping_{mapping},
+        bulkGuarantee_{bulkGuarantee},
+        allocator_{std::move(alloc)} {}
 
  public:
-  virtual ~basic_executor() = default;
-
   auto require_concept(oneway_t) const noexcept {
     return basic_executor<Backend, detail::executor_interface::oneway,
-                          KernelName>{impl_, blockingSemantics_};
+                          KernelName, Blocking, ProtoAllocator>{
+        impl_, mapping_, bulkGuarantee_, allocator_};
   }
 
   auto require_concept(twoway_t) const noexcept {
     return basic_executor<Backend, detail::executor_interface::twoway,
-                          KernelName>{impl_, blockingSemantics_};
+                          KernelName, Blocking, ProtoAllocator>{
+        impl_, mapping_, bulkGuarantee_, allocator_};
   }
 
   auto require_concept(bulk_oneway_t) const noexcept {
     return basic_executor<Backend, detail::executor_interface::bulk_oneway,
-                          KernelName>{impl_, blockingSemantics_};
+                          KernelName, Blocking, ProtoAllocator>{
+        impl_, mapping_, bulkGuarantee_, allocator_};
   }
 
   auto require_concept(bulk_twoway_t) const noexcept {
     return basic_executor<Backend, detail::executor_interface::bulk_twoway,
-                          KernelName>{impl_, blockingSemantics_};
+                          KernelName, Blocking, ProtoAllocator>{
+        impl_, mapping_, bulkGuarantee_, allocator_};
   }
 
   auto require_concept(lazy_t) const noexcept {
     return basic_executor<Backend, detail::executor_interface::lazy,
-                          KernelName>{impl_, blockingSemantics_};
+                          KernelName, Blocking, ProtoAllocator>{
+        impl_, mapping_, bulkGuarantee_, allocator_};
   }
 
   auto require(blocking_t::always_t) const noexcept {
-    return basic_executor<Backend, Interface, KernelName>{
-        impl_, detail::executor_blocking::always};
+    return rebind_blocking_t<detail::executor_blocking::always>{
+        impl_, mapping_, bulkGuarantee_, allocator_};
   }
 
   auto require(blocking_t::never_t) const noexcept {
-    return basic_executor<Backend, Interface, KernelName>{
-        impl_, detail::executor_blocking::never};
+    return rebind_blocking_t<detail::executor_blocking::never>{
+        impl_, mapping_, bulkGuarantee_, allocator_};
   }
 
   auto require(blocking_t::possibly_t) const noexcept {
-    return basic_executor<Backend, Interface, KernelName>{
-        impl_, detail::executor_blocking::possibly};
-  }
-
-  template <typename KernelName>
-  auto require(name_t<KernelName>) const noexcept {
-    return basic_executor<Backend, Interface, KernelName>{impl_,
-                                                          blockingSemantics_};
-  }
-
-  constexpr blocking_t query(blocking_t) const noexcept {
-    switch (blockingSemantics_) {
-      case detail::executor_blocking::always:
-        return blocking_t::always_t{};
-      case detail::executor_blocking::never:
-        return blocking_t::never_t{};
-      case detail::executor_blocking::possibly:
-        return blocking_t::possibly_t{};
-      default:
-        return blocking_t{};
+    return rebind_blocking_t<detail::executor_blocking::possibly>{
+        impl_, mapping_, bulkGuarantee_, allocator_};
+  }
+
+  template <typename OtherKernelName>
+  auto require(name_t<OtherKernelName>) const noexcept {
+    return basic_executor<Backend, Interface, OtherKernelName, Blocking,
+                          ProtoAllocator>{impl_, mapping_, bulkGuarantee_,
+                                          allocator_};
+  }
+
+  auto require(mapping_t::row_major_t) const noexcept {
+    return basic_executor{impl_, mapping_t::row_major, bulkGuarantee_,
+                          allocator_};
+  }
+
+  auto require(mapping_t::column_major_t) const noexcept {
+    return basic_executor{impl_, mapping_t::column_major, bulkGuarantee_,
+                          allocator_};
+  }
+
+  auto require(mapping_t::tiled_t tile) const noexcept {
+    return basic_executor{impl_, tile, bulkGuarantee_, allocator_};
+  }
+
+  auto require(mapping_t::morton_t) const noexcept {
+    return basic_executor{impl_, mapping_t::morton, bulkGuarantee_,
+                          allocator_};
+  }
+
+  auto require(bulk_guarantee_t::unsequenced_t) const noexcept {
+    return basic_executor{impl_, mapping_, bulk_guarantee_t::unsequenced,
+                          allocator_};
+  }
+
+  auto require(bulk_guarantee_t::sequenced_t) const noexcept {
+    return basic_executor{impl_, mapping_, bulk_guarantee_t::sequenced,
+                          allocator_};
+  }
+
+  auto require(bulk_guarantee_t::parallel_t) const noexcept {
+    return basic_executor{impl_, mapping_, bulk_guarantee_t::parallel,
+                          allocator_};
+  }
+
+  template <typename OtherProtoAllocator>
+  auto require(const allocator_t<OtherProtoAllocator> &alloc) const noexcept {
+    return rebind_allocator_t<OtherProtoAllocator>{
+        impl_, mapping_, bulkGuarantee_, alloc.value()};
+  }
+
+  auto require(const allocator_t<void> &) const noexcept {
+    return rebind_allocator_t<std::allocator<void>>{impl_, mapping_,
+                                                    bulkGuarantee_};
+  }
+
+  mapping_t query(mapping_t) const noexcept { return mapping_; }
+
+  bulk_guarantee_t query(bulk_guarantee_t) const noexcept {
+    return bulkGuarantee_;
+  }
+
+  ProtoAllocator query(allocator_t<void>) const noexcept { return allocator_; }
+
+  static constexpr blocking_t query(blocking_t) noexcept {
+    if constexpr (Blocking == detail::executor_blocking::always ||
+                  detail::is_always_blocking_backend<Backend>::value) {
+      return blocking_t::always_t{};
+    } else if constexpr (Blocking == detail::executor_blocking::never) {
+      return blocking_t::never_t{};
+    } else {
+      return blocking_t::possibly_t{};
     }
   }
 
@@ -147,17 +294,19 @@ class basic_executor {
                 std::is_same_v<AlwaysDeduced, KernelName> &&
                 Interface == detail::executor_interface::oneway>>
   void execute(Function &&func) {
-    impl_->template execute<KernelName>(std::forward<Function &&>(func),
-                                        blockingSemantics_);
+    impl_->template execute<KernelName, Blocking>(
+        std::forward<Function &&>(func), allocator_);
   }
 
-  template <typename Function, typename AlwaysDeduced = KernelName,
+  template <typename Function, std::size_t Rank,
+            typename AlwaysDeduced = KernelName,
             typename = typename std::enable_if_t<
                 std::is_same_v<AlwaysDeduced, KernelName> &&
                 Interface == detail::executor_interface::bulk_oneway>>
-  void bulk_execute(Function &&func, shape shape) {
-    impl_->template bulk_execute<KernelName>(std::forward<Function &&>(func),
-                                             shape, blockingSemantics_);
+  void bulk_execute(Function &&func, enzen::shape<Rank> shape) {
+    impl_->template bulk_execute<KernelName, Blocking>(
+        std::forward<Function &&>(func), shape, mapping_, bulkGuarantee_,
+        allocator_);
   }
 
   template <typename Function, typename AlwaysDeduced = KernelName,
@@ -165,8 +314,8 @@ class basic_executor {
                 std::is_same_v<AlwaysDeduced, KernelName> &&
                 Interface == detail::executor_interface::twoway>>
   auto twoway_execute(Function &&func) {
-    return impl_->template twoway_execute<KernelName>(
-        std::forward<Function &&>(func), blockingSemantics_);
+    return impl_->template twoway_execute<KernelName, Blocking>(
+        std::forward<Function &&>(func), allocator_);
   }
 
   template <typename AlwaysDeduced = KernelName,
@@ -178,11 +327,12 @@ class basic_executor {
   }
 
   template <typename Param, typename Function, typename Callback,
-            typename AlwaysDeduced = KernelName,
+            std::size_t Rank, typename AlwaysDeduced = KernelName,
             typename = typename std::enable_if_t<
                 std::is_same_v<AlwaysDeduced, KernelName> &&
                 Interface == detail::executor_interface::lazy>>
-  auto lazy_execute(Function func, Callback &callback, enzen::shape shape) {
+  auto lazy_execute(Function func, Callback &callback,
+                    enzen::shape<Rank> shape) {
     return impl_->template lazy_execute<Param, KernelName, Function, Callback>(
         func, callback, shape);
   }
@@ -192,51 +342,59 @@ class basic_executor {
     impl_->trigger_signal(signal);
   }
 
-  std::shared_ptr<Backend> get_impl() {
-    return impl_;
-  }
+  Backend *get_impl() const noexcept { return impl_.get(); }
 
  private:
   sub_executor_t get_sub_executor() const noexcept {
-    return sub_executor_t{impl_, blockingSemantics_};
-  }
-
-  detail::executor_blocking get_blocking_semantics() const noexcept {
-    return blockingSemantics_;
+    return sub_executor_t{impl_, mapping_, bulkGuarantee_, allocator_};
   }
 
-  std::shared_ptr<Backend> impl_;
-  detail::executor_blocking blockingSemantics_;
+  detail::backend_ref<Backend> impl_;
+  mapping_t mapping_;
+  bulk_guarantee_t bulkGuarantee_;
+  ProtoAllocator allocator_;
 };
 
 template <typename Backend, detail::executor_interface Interface,
-          typename KernelName>
-struct is_executor<basic_executor<Backend, Interface, KernelName>>
+          typename KernelName, detail::executor_blocking Blocking,
+          typename ProtoAllocator>
+struct is_executor<
+    basic_executor<Backend, Interface, KernelName, Blocking, ProtoAllocator>>
     : public std::true_type {};
 
-template <typename Backend, typename KernelName>
-struct is_oneway_executor<
-    basic_executor<Backend, detail::executor_interface::oneway, KernelName>>
+template <typename Backend, typename KernelName,
+          detail::executor_blocking Blocking, typename ProtoAllocator>
+struct is_oneway_executor<basic_executor<
+    Backend, detail::executor_interface::oneway, KernelName, Blocking,
+    ProtoAllocator>>
     : public std::true_type {};
 
-template <typename Backend, typename KernelName>
+template <typename Backend, typename KernelName,
+          detail::executor_blocking Blocking, typename ProtoAllocator>
 struct is_bulk_oneway_executor<basic_executor<
-    Backend, detail::executor_interface::bulk_oneway, KernelName>>
+    Backend, detail::executor_interface::bulk_oneway, KernelName, Blocking,
+    ProtoAllocator>>
     : public std::true_type {};
 
-template <typename Backend, typename KernelName>
-struct is_twoway_executor<
-    basic_executor<Backend, detail::executor_interface::twoway, KernelName>>
+template <typename Backend, typename KernelName,
+          detail::executor_blocking Blocking, typename ProtoAllocator>
+struct is_twoway_executor<basic_executor<
+    Backend, detail::executor_interface::twoway, KernelName, Blocking,
+    ProtoAllocator>>
     : public std::true_type {};
 
-template <typename Backend, typename KernelName>
+template <typename Backend, typename KernelName,
+          detail::executor_blocking Blocking, typename ProtoAllocator>
 struct is_bulk_twoway_executor<basic_executor<
-    Backend, detail::executor_interface::bulk_twoway, KernelName>>
+    Backend, detail::executor_interface::bulk_twoway, KernelName, Blocking,
+    ProtoAllocator>>
     : public std::true_type {};
 
-template <typename Backend, typename KernelName>
-struct is_lazy_executor<
-    basic_executor<Backend, detail::executor_interface::lazy, KernelName>>
+template <typename Backend, typename KernelName,
+          detail::executor_blocking Blocking, typename ProtoAllocator>
+struct is_lazy_executor<basic_executor<
+    Backend, detail::executor_interface::lazy, KernelName, Blocking,
+    ProtoAllocator>>
     : public std::true_type {};
 
 }  // namespace enzen
@@ -0,0 +1,325 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_BULK_H__
+#define __ENZEN_BULK_H__
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <bits/group.h>
+#include <bits/index.h>
+#include <bits/sender.h>
+
+namespace enzen {
+
+/*
+ * @brief Wrapper marking a bulk function of a sender pipeline as reading
+ * elements written by the previous stage at other indices than its own. It
+ * is created with enzen::non_pointwise.
+ */
+template <typename Function>
+struct non_pointwise_t {
+  Function function;
+};
+
+/*
+ * @brief Returns a bulk function for enzen::bulk which is not fused with the
+ * bulk operation before it, so that it only starts once every index of that
+ * operation is complete.
+ * @param function Function invoked as function(index, value).
+ */
+template <typename Function>
+non_pointwise_t<std::decay_t<Function>> non_pointwise(Function &&function) {
+  return {static_cast<Function &&>(function)};
+}
+
+/*
+ * @brief A bulk operation which is not yet applied to a task, created with
+ * enzen::bulk(shape, function) and applied with operator|.
+ */
+template <std::size_t Rank, typename Function>
+struct bulk_adaptor_t {
+  enzen::shape<Rank> shape;
+  Function function;
+};
+
+namespace detail {
+
+/*
+ * @brief Number of indices of a fused chunk which every stage is invoked for
+ * before the next stage, small enough for the elements a stage writes to
+ * still be in cache when the next stage reads them.
+ */
+inline constexpr std::size_t fused_bulk_block_size = 4096;
+
+/*
+ * @brief Bulk function made of several pointwise stages over the same
+ * iteration space, which is run as a single bulk operation.
+ */
+template <typename... Stages>
+struct fused_bulk {
+  /*
+   * @brief Invokes invoke(stage, blockBegin, blockEnd) for every stage and
+   * every block of [begin, end) of at most blockSize elements, running all of
+   * the stages for a block before moving on to the next.
+   */
+  template <typename Invoke>
+  void invoke_blocks(std::size_t begin, std::size_t end,
+                     std::size_t blockSize, Invoke &&invoke) {
+    for (auto blockBegin = begin; blockBegin < end;) {
+      auto blockEnd = blockBegin + std::min(blockSize, end - blockBegin);
+      std::apply(
+          [&](auto &...stage) { (invoke(stage, blockBegin, blockEnd), ...); },
+          stages);
+      blockBegin = blockEnd;
+    }
+  }
+
+  std::tuple<Stages...> stages;
+};
+
+template <typename Function>
+struct is_fused_bulk : public std::false_type {};
+
+template <typename... Stages>
+struct is_fused_bulk<fused_bulk<Stages...>> : public std::true_type {};
+
+template <typename Function>
+inline constexpr bool is_fused_bulk_v =
+    is_fused_bulk<std::decay_t<Function>>::value;
+
+template <typename Function>
+struct is_non_pointwise : public std::false_type {};
+
+template <typename Function>
+struct is_non_pointwise<non_pointwise_t<Function>> : public std::true_type {};
+
+template <typename Function>
+Function unwrap_stage(Function function) {
+  return function;
+}
+
+template <typename Function>
+Function unwrap_stage(non_pointwise_t<Function> function) {
+  return std::move(function.function);
+}
+
+/*
+ * @brief Returns the bulk task of the back-end of task.
+ */
+template <typename Task, std::size_t Rank, typename Function>
+auto make_bulk_task(Task task, const enzen::shape<Rank> &shape,
+                    Function function) {
+  return typename Task::executor_t::backend_t::template bulk_task_t<
+      Task, Function, Rank>{std::move(task), shape, std::move(function)};
+}
+
+/*
+ * @brief Task which runs a sequence of bulk stages over the value of task.
+ * The stages are only combined into bulk tasks when submitted: if every stage
+ * has the same shape, they are fused into a single bulk operation which runs
+ * each stage in turn over one block of a chunk at a time, otherwise each stage
+ * is a separate bulk operation that starts once the previous one completes.
+ */
+template <typename Task, std::size_t Rank, typename... Stages>
+class bulk_pipeline_task {
+  static constexpr std::size_t num_stages = sizeof...(Stages);
+
+ public:
+  using executor_t = typename Task::executor_t;
+  using value_t = typename Task::value_t;
+
+  bulk_pipeline_task(Task task,
+                     const std::array<enzen::shape<Rank>, num_stages> &shapes,
+                     std::tuple<Stages...> stages)
+      : task_{std::move(task)},
+        shapes_{shapes},
+        stages_{std::move(stages)} {}
+
+  /*
+   * @brief Returns whether a stage can be fused with the stages of this
+   * task. Group kernels are never fused, as they are run one group rather
+   * than one index at a time.
+   */
+  template <std::size_t OtherRank, typename Function>
+  static constexpr bool can_fuse() noexcept {
+    return OtherRank == Rank && !is_non_pointwise<Function>::value &&
+           !is_group_kernel_v<Function> &&
+           (!is_group_kernel_v<Stages> && ...);
+  }
+
+  /*
+   * @brief Returns a task which runs function after the stages of this task.
+   */
+  template <typename Function>
+  auto fuse(const enzen::shape<Rank> &shape, Function function) && {
+    return bulk_pipeline_task<Task, Rank, Stages..., Function>{
+        std::move(task_),
+        append_shape(shape, std::make_index_sequence<num_stages>{}),
+        std::tuple_cat(std::move(stages_),
+                       std::make_tuple(std::move(function)))};
+  }
+
+  template <typename Receiver>
+  void submit(Receiver receiver) noexcept {
+    try {
+      if constexpr (num_stages == 1) {
+        enzen::submit(make_bulk_task(std::move(task_), shapes_[0],
+                                     std::move(std::get<0>(stages_))),
+                      std::move(receiver));
+      } else {
+        auto fusable = std::all_of(
+            shapes_.begin(), shapes_.end(), [&](const enzen::shape<Rank> &s) {
+              return same_shape(s, shapes_[0]);
+            });
+        if (fusable) {
+          enzen::submit(make_bulk_task(std::move(task_), shapes_[0],
+                                       fused_bulk<Stages...>{
+                                           std::move(stages_)}),
+                        std::move(receiver));
+        } else {
+          enzen::submit(chain<0>(std::move(task_)), std::move(receiver));
+        }
+      }
+    } catch (...) {
+      enzen::set_error(receiver, std::current_exception());
+    }
+  }
+
+  executor_t get_executor() const noexcept { return task_.get_executor(); }
+
+  auto require_never_blocking() const {
+    auto task = detail::require_never_blocking(task_);
+    return bulk_pipeline_task<decltype(task), Rank, Stages...>{
+        std::move(task), shapes_, stages_};
+  }
+
+ private:
+  static bool same_shape(const enzen::shape<Rank> &lhs,
+                         const enzen::shape<Rank> &rhs) noexcept {
+    for (std::size_t dim = 0; dim < Rank; ++dim) {
+      if (lhs[dim] != rhs[dim]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <std::size_t... Stage>
+  std::array<enzen::shape<Rank>, num_stages + 1> append_shape(
+      const enzen::shape<Rank> &shape,
+      std::index_sequence<Stage...>) const noexcept {
+    return {shapes_[Stage]..., shape};
+  }
+
+  // Nests a bulk task for each stage from Stage onwards around inner.
+  template <std::size_t Stage, typename Inner>
+  auto chain(Inner inner) {
+    auto task = make_bulk_task(std::move(inner), shapes_[Stage],
+                               std::move(std::get<Stage>(stages_)));
+    if constexpr (Stage + 1 == num_stages) {
+      return task;
+    } else {
+      return chain<Stage + 1>(std::move(task));
+    }
+  }
+
+  Task task_;
+  std::array<enzen::shape<Rank>, num_stages> shapes_;
+  std::tuple<Stages...> stages_;
+};
+
+template <typename Task>
+struct is_bulk_pipeline_task : public std::false_type {};
+
+template <typename Task, std::size_t Rank, typename... Stages>
+struct is_bulk_pipeline_task<bulk_pipeline_task<Task, Rank, Stages...>>
+    : public std::true_type {};
+
+/*
+ * @brief Returns a task which runs function over shape after task, fused
+ * with task if it is a pipeline of bulk stages it can be fused with.
+ */
+template <typename Task, std::size_t Rank, typename Function>
+auto make_bulk_pipeline(Task task, const enzen::shape<Rank> &shape,
+                        Function function) {
+  if constexpr (is_bulk_pipeline_task<Task>::value) {
+    if constexpr (Task::template can_fuse<Rank, Function>()) {
+      return std::move(task).fuse(shape, std::move(function));
+    } else {
+      using stage_t = decltype(unwrap_stage(std::move(function)));
+      return bulk_pipeline_task<Task, Rank, stage_t>{
+          std::move(task), {shape}, {unwrap_stage(std::move(function))}};
+    }
+  } else {
+    using stage_t = decltype(unwrap_stage(std::move(function)));
+    return bulk_pipeline_task<Task, Rank, stage_t>{
+        std::move(task), {shape}, {unwrap_stage(std::move(function))}};
+  }
+}
+
+}  // namespace detail
+
+/*
+ * @brief Returns a task which, once the value of task is available, invokes
+ * function with every index of shape and that value on the executor of task,
+ * and then completes with the value. Successive bulk operations over the same
+ * shape are fused into one, which runs each function in turn over a block of
+ * indices while its elements are still in cache, unless a function is marked
+ * with enzen::non_pointwise, in which case it only starts once every index of
+ * the previous operation is complete.
+ * @param task Task producing the value.
+ * @param shape Iteration space to invoke function over.
+ * @param function Function invoked as function(index, value).
+ */
+template <typename Task, std::size_t Rank, typename Function>
+auto bulk(Task task, enzen::shape<Rank> shape, Function function) {
+  return detail::make_bulk_pipeline(std::move(task), shape,
+                                    std::move(function));
+}
+
+/*
+ * @brief Returns a bulk operation to be applied to a task with operator|, as
+ * in bulk(task, shape, f) | bulk(shape, g).
+ * @param shape Iteration space to invoke function over.
+ * @param function Function invoked as function(index, value).
+ */
+template <std::size_t Rank, typename Function>
+bulk_adaptor_t<Rank, std::decay_t<Function>> bulk(enzen::shape<Rank> shape,
+                                                  Function &&function) {
+  return {shape, static_cast<Function &&>(function)};
+}
+
+/*
+ * @brief Applies a bulk operation to task, equivalent to
+ * bulk(task, adaptor.shape, adaptor.function).
+ */
+template <typename Task, std::size_t Rank, typename Function,
+          typename = typename Task::value_t>
+auto operator|(Task task, bulk_adaptor_t<Rank, Function> adaptor) {
+  return enzen::bulk(std::move(task), adaptor.shape,
+                     std::move(adaptor.function));
+}
+
+}  // namespace enzen
+
+#endif  // __ENZEN_BULK_H__
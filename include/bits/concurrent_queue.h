@@ -19,7 +19,9 @@ limitations under the License.
 
 #include <atomic>
 #include <condition_variable>
+#include <mutex>
 #include <queue>
+#include <utility>
 
 namespace enzen {
 
@@ -30,13 +32,13 @@ class concurrent_queue {
 
   void push(ValueType newValue) {
     std::lock_guard<std::mutex> lock(mutex_);
-    queue_.push(newValue);
+    queue_.push(std::move(newValue));
   }
 
   bool try_pop(ValueType &returnValue) {
     std::lock_guard<std::mutex> lock(mutex_);
     if (queue_.empty()) { return false; }
-    returnValue = queue_.front();
+    returnValue = std::move(queue_.front());
     queue_.pop();
     return true; 
   }
@@ -46,6 +48,11 @@ class concurrent_queue {
     return queue_.empty();
   }
 
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
  private:
   std::queue<ValueType> queue_;
   mutable std::mutex mutex_;
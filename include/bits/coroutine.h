@@ -0,0 +1,308 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_COROUTINE_H__
+#define __ENZEN_COROUTINE_H__
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace enzen {
+
+template <typename ValueType>
+class task;
+
+namespace detail {
+
+/*
+ * @brief Trait which specifies whether a type is a task which can be awaited,
+ * that is it has a value_t and can be submitted with a receiver.
+ */
+template <typename Task, typename = void>
+struct is_awaitable_task : public std::false_type {};
+
+template <typename Task>
+struct is_awaitable_task<Task, std::void_t<typename Task::value_t>>
+    : public std::true_type {};
+
+template <typename ValueType>
+struct is_awaitable_task<enzen::task<ValueType>> : public std::false_type {};
+
+/*
+ * @brief Awaitable which submits a task with a receiver that resumes the
+ * awaiting coroutine on the thread which completes the task.
+ */
+template <typename Task>
+class task_awaitable {
+  using value_t = typename Task::value_t;
+
+  class resume_receiver {
+   public:
+    resume_receiver(task_awaitable *awaitable) : awaitable_{awaitable} {}
+
+    template <typename Value>
+    void value(Value &&value) {
+      awaitable_->value_.emplace(static_cast<Value &&>(value));
+      awaitable_->continuation_.resume();
+    }
+
+    template <typename Error>
+    void error(Error &&error) noexcept {
+      awaitable_->exception_ =
+          detail::make_exception_ptr(static_cast<Error &&>(error));
+      awaitable_->continuation_.resume();
+    }
+
+    void done() {
+      awaitable_->exception_ = std::make_exception_ptr(
+          std::runtime_error("Awaited task completed without a value."));
+      awaitable_->continuation_.resume();
+    }
+
+   private:
+    task_awaitable *awaitable_;
+  };
+
+ public:
+  task_awaitable(Task task) : task_{std::move(task)} {}
+
+  bool await_ready() const noexcept { return false; }
+
+  // The awaitable may be destroyed as soon as the task completes, so it must
+  // not be accessed after submitting the task.
+  void await_suspend(std::coroutine_handle<> continuation) {
+    continuation_ = continuation;
+    enzen::submit(std::move(task_), resume_receiver{this});
+  }
+
+  value_t await_resume() {
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+    return std::move(*value_);
+  }
+
+ private:
+  Task task_;
+  std::coroutine_handle<> continuation_;
+  std::optional<value_t> value_;
+  std::exception_ptr exception_;
+};
+
+/*
+ * @brief Awaitable which resumes the awaiting coroutine on the thread which
+ * sets the value or exception of a future.
+ */
+template <typename ValueType>
+class future_awaitable {
+ public:
+  future_awaitable(future<ValueType> fut) : future_{std::move(fut)} {}
+
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<> continuation) {
+    return future_.set_continuation(
+        [continuation]() { continuation.resume(); });
+  }
+
+  ValueType await_resume() { return future_.get(); }
+
+ private:
+  future<ValueType> future_;
+};
+
+/*
+ * @brief Coroutine type which starts eagerly and destroys itself on
+ * completion, used to drive an awaitable from a receiver.
+ */
+struct detached_coroutine {
+  struct promise_type {
+    detached_coroutine get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+template <typename Awaitable, typename Receiver>
+detached_coroutine submit_awaitable(Awaitable awaitable, Receiver receiver) {
+  using value_t = typename Awaitable::value_t;
+
+  auto value = std::optional<value_t>{};
+  auto exception = std::exception_ptr{};
+  try {
+    value.emplace(co_await std::move(awaitable));
+  } catch (...) {
+    exception = std::current_exception();
+  }
+
+  if (exception) {
+    enzen::set_error(receiver, exception);
+  } else {
+    enzen::set_value(receiver, std::move(*value));
+  }
+}
+
+template <typename ValueType>
+class task_promise {
+ public:
+  struct final_awaiter {
+    bool await_ready() const noexcept { return false; }
+
+    // Symmetric transfer to the awaiting coroutine, so that completing a
+    // chain of awaited tasks does not grow the stack.
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) noexcept {
+      return handle.promise().continuation_;
+    }
+
+    void await_resume() noexcept {}
+  };
+
+  task<ValueType> get_return_object() noexcept;
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+
+  final_awaiter final_suspend() noexcept { return {}; }
+
+  template <typename Value>
+  void return_value(Value &&value) {
+    value_.emplace(static_cast<Value &&>(value));
+  }
+
+  void unhandled_exception() noexcept {
+    exception_ = std::current_exception();
+  }
+
+  ValueType get_value() {
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+    return std::move(*value_);
+  }
+
+ private:
+  friend class task<ValueType>;
+
+  std::coroutine_handle<> continuation_ = std::noop_coroutine();
+  std::optional<ValueType> value_;
+  std::exception_ptr exception_;
+};
+
+}  // namespace detail
+
+/*
+ * @brief Lazily started coroutine type producing a value of ValueType. A task
+ * starts when it is awaited, or when it is submitted with a receiver, in which
+ * case it behaves as any other enzen task.
+ * @tparam ValueType Type of the value produced by the coroutine.
+ */
+template <typename ValueType>
+class task {
+  static_assert(!std::is_void_v<ValueType>,
+                "enzen tasks must complete with a value.");
+
+ public:
+  using value_t = ValueType;
+  using promise_type = detail::task_promise<ValueType>;
+  using handle_t = std::coroutine_handle<promise_type>;
+
+  class awaiter {
+   public:
+    awaiter(handle_t handle) : handle_{handle} {}
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<> continuation) noexcept {
+      handle_.promise().continuation_ = continuation;
+      return handle_;
+    }
+
+    value_t await_resume() { return handle_.promise().get_value(); }
+
+   private:
+    handle_t handle_;
+  };
+
+  explicit task(handle_t handle) noexcept : handle_{handle} {}
+
+  task(const task &) = delete;
+  task(task &&other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+  task &operator=(const task &) = delete;
+  task &operator=(task &&other) noexcept {
+    if (this != &other) {
+      destroy();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+
+  ~task() { destroy(); }
+
+  awaiter operator co_await() && noexcept { return awaiter{handle_}; }
+
+  template <typename Receiver>
+  void submit(Receiver receiver) {
+    detail::submit_awaitable(std::move(*this), std::move(receiver));
+  }
+
+ private:
+  void destroy() noexcept {
+    if (handle_) {
+      handle_.destroy();
+      handle_ = {};
+    }
+  }
+
+  handle_t handle_;
+};
+
+template <typename ValueType>
+task<ValueType> detail::task_promise<ValueType>::get_return_object() noexcept {
+  return task<ValueType>{
+      std::coroutine_handle<task_promise<ValueType>>::from_promise(*this)};
+}
+
+/*
+ * @brief Makes any enzen task awaitable. Awaiting a task submits it and
+ * resumes the coroutine with its value on the thread which completes it. The
+ * executors the task submits work through are all required to be never
+ * blocking, so that awaiting it from a worker thread cannot wait on the pool
+ * running it.
+ */
+template <typename Task, typename = std::enable_if_t<
+                             detail::is_awaitable_task<Task>::value>>
+auto operator co_await(Task task) {
+  auto neverBlockingTask = detail::require_never_blocking(std::move(task));
+  return detail::task_awaitable<decltype(neverBlockingTask)>{
+      std::move(neverBlockingTask)};
+}
+
+template <typename ValueType>
+auto operator co_await(future<ValueType> fut) {
+  return detail::future_awaitable<ValueType>{std::move(fut)};
+}
+
+}  // namespace enzen
+
+#endif  // __ENZEN_COROUTINE_H__
@@ -0,0 +1,74 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_EVENT_H__
+#define __ENZEN_EVENT_H__
+
+#include <atomic>
+
+#if !defined(__cpp_lib_atomic_wait)
+#include <condition_variable>
+#include <mutex>
+#endif  // !defined(__cpp_lib_atomic_wait)
+
+namespace enzen::detail {
+
+/*
+ * @brief One-shot event which a thread can park on until another thread sets
+ * it. Uses an atomic wait where available and a condition variable otherwise.
+ */
+class event {
+ public:
+  event() : isSet_{false} {}
+
+  event(const event &) = delete;
+  event &operator=(const event &) = delete;
+
+  void set() noexcept {
+#if defined(__cpp_lib_atomic_wait)
+    isSet_.store(true, std::memory_order_release);
+    isSet_.notify_all();
+#else
+    auto lock = std::lock_guard<std::mutex>{mutex_};
+    isSet_.store(true, std::memory_order_release);
+    cv_.notify_all();
+#endif  // defined(__cpp_lib_atomic_wait)
+  }
+
+  void wait() const noexcept {
+#if defined(__cpp_lib_atomic_wait)
+    isSet_.wait(false, std::memory_order_acquire);
+#else
+    auto lock = std::unique_lock<std::mutex>{mutex_};
+    cv_.wait(lock, [&]() { return is_set(); });
+#endif  // defined(__cpp_lib_atomic_wait)
+  }
+
+  bool is_set() const noexcept {
+    return isSet_.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::atomic<bool> isSet_;
+#if !defined(__cpp_lib_atomic_wait)
+  mutable std::mutex mutex_;
+  mutable std::condition_variable cv_;
+#endif  // !defined(__cpp_lib_atomic_wait)
+};
+
+}  // namespace enzen::detail
+
+#endif  // __ENZEN_EVENT_H__
@@ -17,6 +17,7 @@
 #ifndef __ENZEN_FUTURE_H__
 #define __ENZEN_FUTURE_H__
 
+#include <functional>
 #include <memory>
 #include <mutex>
 
@@ -30,6 +31,7 @@ class future_shared_state {
   using value_t = ValueType;
   using exception_t = std::exception_ptr;
   using mutex_t = std::mutex;
+  using continuation_t = std::function<void()>;
 
  public:
   future_shared_state()
@@ -38,15 +40,44 @@ class future_shared_state {
         isExceptionSet_{false} {}
 
   void set_value(value_t value) noexcept {
-    std::lock_guard<mutex_t> lockGuard(mutex_);
-    isValueSet_ = true;
-    value_ = value;
+    auto continuation = continuation_t{};
+    {
+      std::lock_guard<mutex_t> lockGuard(mutex_);
+      isValueSet_ = true;
+      value_ = value;
+      continuation = std::move(continuation_);
+    }
+    if (continuation) {
+      continuation();
+    }
   }
 
   void set_exception(exception_t exception) {
+    auto continuation = continuation_t{};
+    {
+      std::lock_guard<mutex_t> lockGuard(mutex_);
+      isExceptionSet_ = true;
+      exception_ = exception;
+      continuation = std::move(continuation_);
+    }
+    if (continuation) {
+      continuation();
+    }
+  }
+
+  /*
+   * @brief Registers a continuation to be invoked by the thread which sets the
+   * value or exception.
+   * @return false without registering the continuation if the value or
+   * exception is already set.
+   */
+  bool set_continuation(continuation_t continuation) {
     std::lock_guard<mutex_t> lockGuard(mutex_);
-    isExceptionSet_ = true;
-    exception_ = exception;
+    if (isValueSet_ || isExceptionSet_) {
+      return false;
+    }
+    continuation_ = std::move(continuation);
+    return true;
   }
 
   value_t get_value() const noexcept {
@@ -87,6 +118,7 @@ class future_shared_state {
   mutable mutex_t mutex_;
   value_t value_;
   exception_t exception_;
+  continuation_t continuation_;
   bool isValueSet_;
   bool isExceptionSet_;
 };
@@ -120,6 +152,18 @@ class future {
     }
   }
 
+  /*
+   * @brief Registers a continuation to be invoked once the value or exception
+   * is available.
+   * @return false without registering the continuation if the value or
+   * exception is already available.
+   */
+  template <typename Continuation>
+  bool set_continuation(Continuation &&continuation) {
+    return sharedState_->set_continuation(
+        std::forward<Continuation>(continuation));
+  }
+
   // TODO(Gordon): Implement then
 #if 0
   template <typename Continuation>
@@ -154,12 +198,23 @@ class promise {
   promise() noexcept
       : sharedStatePtr_{std::make_shared<future_shared_state<ValueType>>()} {}
 
+  /*
+   * @brief Constructs a promise whose shared state is allocated with an
+   * allocator rebound to the shared state.
+   */
+  template <typename ProtoAllocator>
+  promise(std::allocator_arg_t, const ProtoAllocator &alloc)
+      : sharedStatePtr_{std::allocate_shared<future_shared_state<ValueType>>(
+            alloc)} {}
+
   future<value_t> get_future() { return future<ValueType>{sharedStatePtr_}; }
 
   void value(value_t value) {
     sharedStatePtr_->set_value(value);
   }
 
+  void set_value(value_t value) { sharedStatePtr_->set_value(value); }
+
   template <typename Error>
   void error(Error error) {
 
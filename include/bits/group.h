@@ -0,0 +1,382 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_GROUP_H__
+#define __ENZEN_GROUP_H__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <bits/index.h>
+
+namespace enzen {
+
+namespace detail {
+
+/*
+ * @brief Alignment of the scratch memory of a group, which is enough for any
+ * scalar or vector type and keeps groups on different workers from sharing a
+ * cache line.
+ */
+inline constexpr std::size_t group_scratch_alignment = 64;
+
+template <std::size_t Rank, std::size_t... Dims>
+constexpr enzen::shape<Rank> make_shape(
+    const std::array<std::size_t, Rank> &extents,
+    std::index_sequence<Dims...>) noexcept {
+  return enzen::shape<Rank>{extents[Dims]...};
+}
+
+/*
+ * @brief Returns the shape with the given extents.
+ */
+template <std::size_t Rank>
+constexpr enzen::shape<Rank> make_shape(
+    const std::array<std::size_t, Rank> &extents) noexcept {
+  return make_shape(extents, std::make_index_sequence<Rank>{});
+}
+
+}  // namespace detail
+
+/*
+ * @brief Handle to a group of a grouped bulk operation, passed to the
+ * function of a group_kernel. The indices of a group are a tile of the global
+ * iteration space, and every index of a group is run by the same worker, so
+ * they can share the scratch memory of the group and synchronize with
+ * group_barrier.
+ * @tparam Rank Number of dimensions of the iteration space.
+ */
+template <std::size_t Rank>
+class group {
+ public:
+  /*
+   * @brief Constructs the group at position groupId in the grid of groups
+   * which covers globalRange with groups of groupShape.
+   * @param globalRange Global iteration space.
+   * @param groupShape Extents of every group which is not clipped by the edge
+   * of the global iteration space.
+   * @param groupId Position of the group in the grid of groups.
+   * @param groupLinearId Row-major position of the group in the grid.
+   * @param scratch Scratch memory of the group.
+   * @param scratchSize Size in bytes of the scratch memory.
+   */
+  group(const std::array<std::size_t, Rank> &globalRange,
+        const std::array<std::size_t, Rank> &groupShape,
+        const std::array<std::size_t, Rank> &groupId,
+        std::size_t groupLinearId, std::byte *scratch,
+        std::size_t scratchSize) noexcept
+      : globalRange_{globalRange},
+        groupShape_{groupShape},
+        groupId_{groupId},
+        groupLinearId_{groupLinearId},
+        scratch_{scratch},
+        scratchSize_{scratchSize} {}
+
+  /*
+   * @brief Returns the number of dimensions of the group.
+   */
+  static constexpr std::size_t rank() noexcept { return Rank; }
+
+  /*
+   * @brief Returns the position of the group in the grid of groups.
+   */
+  enzen::index<Rank> group_id() const noexcept {
+    return enzen::index<Rank>{groupId_, groupLinearId_};
+  }
+
+  /*
+   * @brief Returns the number of groups in each dimension.
+   */
+  enzen::shape<Rank> group_range() const noexcept {
+    auto extents = std::array<std::size_t, Rank>{};
+    for (std::size_t dim = 0; dim < Rank; ++dim) {
+      extents[dim] = (globalRange_[dim] + groupShape_[dim] - 1) /
+                     groupShape_[dim];
+    }
+    return detail::make_shape(extents);
+  }
+
+  /*
+   * @brief Returns the extents of the group, which are smaller than the group
+   * shape for a group at the edge of the global iteration space.
+   */
+  enzen::shape<Rank> local_range() const noexcept {
+    return detail::make_shape(local_extents());
+  }
+
+  /*
+   * @brief Returns the global iteration space.
+   */
+  enzen::shape<Rank> global_range() const noexcept {
+    return detail::make_shape(globalRange_);
+  }
+
+  /*
+   * @brief Invokes function as function(localIndex, globalIndex) for every
+   * index of the group in row-major order, where localIndex is within
+   * local_range() and globalIndex within global_range().
+   * @param function Function invoked for each index of the group.
+   */
+  template <typename Function>
+  void for_each_item(Function &&function) const {
+    auto localRange = detail::make_shape(local_extents());
+    detail::for_each_index(localRange, [&](enzen::index<Rank> localIdx) {
+      auto coords = std::array<std::size_t, Rank>{};
+      auto linearId = std::size_t{0};
+      for (std::size_t dim = 0; dim < Rank; ++dim) {
+        coords[dim] = groupId_[dim] * groupShape_[dim] + localIdx[dim];
+        linearId = linearId * globalRange_[dim] + coords[dim];
+      }
+      std::invoke(function, localIdx, enzen::index<Rank>{coords, linearId});
+    });
+  }
+
+  /*
+   * @brief Returns the scratch memory of the group as an array of T. Its
+   * contents are unspecified when the group starts, as the memory is reused
+   * by the groups which previously ran on the same worker.
+   */
+  template <typename T>
+  T *scratch() const noexcept {
+    static_assert(alignof(T) <= detail::group_scratch_alignment,
+                  "Scratch memory is not sufficiently aligned for T.");
+    return reinterpret_cast<T *>(scratch_);
+  }
+
+  /*
+   * @brief Returns the size in bytes of the scratch memory of the group.
+   */
+  std::size_t scratch_size() const noexcept { return scratchSize_; }
+
+ private:
+  std::array<std::size_t, Rank> local_extents() const noexcept {
+    auto extents = std::array<std::size_t, Rank>{};
+    for (std::size_t dim = 0; dim < Rank; ++dim) {
+      auto origin = groupId_[dim] * groupShape_[dim];
+      extents[dim] = std::min(groupShape_[dim], globalRange_[dim] - origin);
+    }
+    return extents;
+  }
+
+  std::array<std::size_t, Rank> globalRange_;
+  std::array<std::size_t, Rank> groupShape_;
+  std::array<std::size_t, Rank> groupId_;
+  std::size_t groupLinearId_;
+  std::byte *scratch_;
+  std::size_t scratchSize_;
+};
+
+/*
+ * @brief Separates two phases of a group, so that every write made to the
+ * scratch memory of the group by the items of one phase is visible to the
+ * items of the next. The items of a group all run in order on one worker, so
+ * this only keeps the compiler from moving memory accesses across phases, and
+ * never waits on other workers or the task queue.
+ */
+template <std::size_t Rank>
+void group_barrier(const group<Rank> &) noexcept {
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+/*
+ * @brief Wrapper marking a bulk function as being invoked once per group of
+ * the iteration space, with a group handle, rather than once per index. It is
+ * created with enzen::group_kernel.
+ */
+template <std::size_t Rank, typename Function>
+struct group_kernel_t {
+  enzen::shape<Rank> groupShape;
+  std::size_t scratchSize;
+  Function function;
+};
+
+/*
+ * @brief Returns a bulk function which splits the iteration space into groups
+ * of groupShape and invokes function once for each group, as
+ * function(const group<Rank> &). Each group has scratchSize bytes of scratch
+ * memory, which is allocated once per worker and reused by every group that
+ * worker runs.
+ * @param groupShape Extents of each group.
+ * @param scratchSize Size in bytes of the scratch memory of each group.
+ * @param function Function invoked as function(const group<Rank> &).
+ */
+template <std::size_t Rank, typename Function>
+group_kernel_t<Rank, std::decay_t<Function>> group_kernel(
+    enzen::shape<Rank> groupShape, std::size_t scratchSize,
+    Function &&function) {
+  return {groupShape, scratchSize, static_cast<Function &&>(function)};
+}
+
+/*
+ * @brief Returns a bulk function which splits the iteration space into groups
+ * of groupShape, with no scratch memory.
+ */
+template <std::size_t Rank, typename Function>
+group_kernel_t<Rank, std::decay_t<Function>> group_kernel(
+    enzen::shape<Rank> groupShape, Function &&function) {
+  return {groupShape, 0, static_cast<Function &&>(function)};
+}
+
+namespace detail {
+
+template <typename Function>
+struct is_group_kernel : public std::false_type {};
+
+template <std::size_t Rank, typename Function>
+struct is_group_kernel<group_kernel_t<Rank, Function>>
+    : public std::true_type {};
+
+template <typename Function>
+inline constexpr bool is_group_kernel_v =
+    is_group_kernel<std::decay_t<Function>>::value;
+
+/*
+ * @brief Scratch memory of the calling thread, which is borrowed by a single
+ * grouped bulk chunk at a time. A chunk which runs while the memory is
+ * already borrowed, such as a grouped bulk operation run inline from within a
+ * group, allocates its own, and whichever of the two is larger is kept.
+ */
+class group_scratch {
+ public:
+  explicit group_scratch(std::size_t size) : memory_{nullptr}, size_{0} {
+    if (size == 0) {
+      return;
+    }
+    auto &cached = cached_memory();
+    if (cached.memory_ != nullptr && cached.size_ >= size) {
+      memory_ = std::exchange(cached.memory_, nullptr);
+      size_ = std::exchange(cached.size_, 0);
+    } else {
+      memory_ = static_cast<std::byte *>(::operator new(
+          size, std::align_val_t{group_scratch_alignment}));
+      size_ = size;
+    }
+  }
+
+  group_scratch(const group_scratch &) = delete;
+  group_scratch &operator=(const group_scratch &) = delete;
+
+  ~group_scratch() {
+    if (memory_ == nullptr) {
+      return;
+    }
+    auto &cached = cached_memory();
+    if (cached.size_ < size_) {
+      std::swap(cached.memory_, memory_);
+      std::swap(cached.size_, size_);
+    }
+    release(memory_);
+  }
+
+  std::byte *data() const noexcept { return memory_; }
+
+ private:
+  struct cache {
+    ~cache() { release(memory_); }
+
+    std::byte *memory_ = nullptr;
+    std::size_t size_ = 0;
+  };
+
+  static cache &cached_memory() noexcept {
+    thread_local cache cached{};
+    return cached;
+  }
+
+  static void release(std::byte *memory) noexcept {
+    if (memory != nullptr) {
+      ::operator delete(memory, std::align_val_t{group_scratch_alignment});
+    }
+  }
+
+  std::byte *memory_;
+  std::size_t size_;
+};
+
+/*
+ * @brief Returns the number of groups of a group kernel in each dimension of
+ * iterationSpace.
+ */
+template <std::size_t Rank, typename Function>
+std::array<std::size_t, Rank> group_grid(
+    const group_kernel_t<Rank, Function> &kernel,
+    const enzen::shape<Rank> &iterationSpace) noexcept {
+  auto grid = std::array<std::size_t, Rank>{};
+  for (std::size_t dim = 0; dim < Rank; ++dim) {
+    auto extent = std::max<std::size_t>(kernel.groupShape[dim], 1);
+    grid[dim] = (iterationSpace[dim] + extent - 1) / extent;
+  }
+  return grid;
+}
+
+/*
+ * @brief Returns the total number of groups of a group kernel over
+ * iterationSpace.
+ */
+template <std::size_t Rank, typename Function>
+std::size_t num_groups(const group_kernel_t<Rank, Function> &kernel,
+                       const enzen::shape<Rank> &iterationSpace) noexcept {
+  return make_shape(group_grid(kernel, iterationSpace)).size();
+}
+
+/*
+ * @brief Invokes a group kernel for the groups of iterationSpace whose
+ * row-major positions in the grid of groups are within [begin, end), on the
+ * calling thread. The scratch memory is borrowed once for all of the groups.
+ * Any further arguments are passed after the group.
+ */
+template <std::size_t Rank, typename Function, typename... Args>
+void invoke_group_bulk(Function &kernel,
+                       const enzen::shape<Rank> &iterationSpace,
+                       std::size_t begin, std::size_t end, Args &...args) {
+  static_assert(decltype(kernel.groupShape)::rank() == Rank,
+                "A group kernel must have the rank of its iteration space.");
+  if (begin >= end) {
+    return;
+  }
+
+  auto globalRange = std::array<std::size_t, Rank>{};
+  auto groupShape = std::array<std::size_t, Rank>{};
+  for (std::size_t dim = 0; dim < Rank; ++dim) {
+    globalRange[dim] = iterationSpace[dim];
+    groupShape[dim] = std::max<std::size_t>(kernel.groupShape[dim], 1);
+  }
+  auto grid = make_shape(group_grid(kernel, iterationSpace));
+
+  auto scratch = group_scratch{kernel.scratchSize};
+  for_each_index(grid, begin, end, [&](enzen::index<Rank> groupIdx) {
+    auto groupId = std::array<std::size_t, Rank>{};
+    for (std::size_t dim = 0; dim < Rank; ++dim) {
+      groupId[dim] = groupIdx[dim];
+    }
+    auto g = enzen::group<Rank>{globalRange,   groupShape,
+                                groupId,       groupIdx.linear_id(),
+                                scratch.data(), kernel.scratchSize};
+    std::invoke(kernel.function, std::as_const(g), args...);
+  });
+}
+
+}  // namespace detail
+
+}  // namespace enzen
+
+#endif  // __ENZEN_GROUP_H__
@@ -17,81 +17,443 @@ limitations under the License.
 #ifndef __ENZEN_INDEX_H__
 #define __ENZEN_INDEX_H__
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+// Asserts that the iterations of the following loop are independent, so the
+// compiler may vectorize it without proving that itself.
+#if defined(__clang__)
+#define ENZEN_PRAGMA_IVDEP _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define ENZEN_PRAGMA_IVDEP _Pragma("GCC ivdep")
+#else
+#define ENZEN_PRAGMA_IVDEP
+#endif
+
 namespace enzen {
 
 /*
- * @brief Structure which represents a three dimensional iteration space.
+ * @brief Structure which represents an iteration space of Rank dimensions.
+ * @tparam Rank Number of dimensions of the iteration space.
  */
+template <std::size_t Rank>
 class shape {
+  static_assert(Rank > 0, "A shape must have at least one dimension.");
+
  public:
   /*
-   * @brief Constructs a shape that represents the itertion space {w, h, d}.
-   * @param w Width of iteration space.
-   * @param h Height of iteration space.
-   * @param d Depth of iteration space.
+   * @brief Constructs a shape that represents the iteration space {extents...},
+   * for example shape{w}, shape{w, h} or shape{w, h, d}.
+   * @param extents Size of each dimension of the iteration space.
+   */
+  template <typename... Extents,
+            typename = std::enable_if_t<sizeof...(Extents) == Rank>>
+  explicit constexpr shape(Extents... extents) noexcept
+      : iterationSpace_{{static_cast<std::size_t>(extents)...}} {}
+
+  /*
+   * @brief Returns the number of dimensions of the iteration space.
    */
-  shape(size_t w, size_t h, size_t d) : iterationSpace_{w, h, d} {}
+  static constexpr std::size_t rank() noexcept { return Rank; }
 
   /*
    * @brief Returns the value of a dimension of the iteration space.
    * @param dim Dimension of the iteration space to be returned.
    * @return The value of the iteration space at the specified dimension.
    */
-  size_t operator[](int dim) const noexcept { return iterationSpace_[dim]; }
+  constexpr std::size_t operator[](std::size_t dim) const noexcept {
+    return iterationSpace_[dim];
+  }
+
+  /*
+   * @brief Returns the number of indices within the iteration space.
+   */
+  constexpr std::size_t size() const noexcept {
+    auto size = std::size_t{1};
+    for (auto extent : iterationSpace_) {
+      size *= extent;
+    }
+    return size;
+  }
 
  private:
-  size_t iterationSpace_[3];
+  std::array<std::size_t, Rank> iterationSpace_;
+};
+
+template <typename... Extents>
+shape(Extents...) -> shape<sizeof...(Extents)>;
+
+namespace detail {
+
+/*
+ * @brief Storage for the linear id of an index. A one dimensional index is its
+ * own linear id, so it stores nothing.
+ */
+template <std::size_t Rank>
+struct index_linear_id {
+  std::size_t linearId_;
 };
 
+template <>
+struct index_linear_id<1> {};
+
 /*
- * @brief Structure which represents an index within a three dimensional
- * iteration space.
+ * @brief Returns the position in each dimension of the index whose row-major
+ * position in iterationSpace is linearId.
  */
-class index {
+template <std::size_t Rank>
+constexpr std::array<std::size_t, Rank> delinearize(
+    const shape<Rank> &iterationSpace, std::size_t linearId) noexcept {
+  auto coords = std::array<std::size_t, Rank>{};
+  for (auto dim = Rank; dim-- > 0;) {
+    coords[dim] = linearId % iterationSpace[dim];
+    linearId /= iterationSpace[dim];
+  }
+  return coords;
+}
+
+}  // namespace detail
+
+/*
+ * @brief Structure which represents an index within an iteration space of Rank
+ * dimensions. An index only holds its position, not the shape of the
+ * iteration space, so it is as small as possible to pass to bulk functions.
+ * @tparam Rank Number of dimensions of the iteration space.
+ */
+template <std::size_t Rank>
+class index : private detail::index_linear_id<Rank> {
  public:
   /*
-   * @brief Constructs an index that represents the point {x, y, z} within an
-   * iteration space.
-   * @param iterationSpace Iteration space.
-   * @param x X dimension of index.
-   * @param y Y dimension of index.
-   * @param z Z dimension of index.
+   * @brief Constructs an index that represents the point {coords...} within an
+   * iteration space, where linearId is the row-major position of that point.
+   * @param coords Position of the index in each dimension.
+   * @param linearId Row-major position of the index in the iteration space.
+   */
+  constexpr index(const std::array<std::size_t, Rank> &coords,
+                  std::size_t linearId) noexcept
+      : index_{coords} {
+    if constexpr (Rank > 1) {
+      this->linearId_ = linearId;
+    }
+  }
+
+  /*
+   * @brief Constructs an index from its row-major position in iterationSpace.
+   * @param iterationSpace Iteration space the index is within.
+   * @param linearId Row-major position of the index in the iteration space.
    */
-  index(shape iterationSpace, size_t x, size_t y, size_t z)
-      : iterationSpace_{iterationSpace}, index_{x, y, z} {}
+  constexpr index(const shape<Rank> &iterationSpace,
+                  std::size_t linearId) noexcept
+      : index{detail::delinearize(iterationSpace, linearId), linearId} {}
 
   /*
-   * @brief Constructs an index that represents the point {x, y, z} within the
-   * iteration space {w, h, d}.
-   * @param w Width of iteration space.
-   * @param h Height of iteration space.
-   * @param d Depth of iteration space.
-   * @param x X dimension of index.
-   * @param y Y dimension of index.
-   * @param z Z dimension of index.
+   * @brief Returns the number of dimensions of the index.
    */
-  index(size_t w, size_t h, size_t d, size_t x, size_t y, size_t z)
-      : iterationSpace_{w, h, d}, index_{x, y, z} {}
+  static constexpr std::size_t rank() noexcept { return Rank; }
 
   /*
    * @brief Returns the value of a dimension of the index.
    * @param dim Dimension of the index to be returned.
    * @return The value of the index at the specified dimension.
    */
-  size_t operator[](int dim) const noexcept { return index_[dim]; }
+  constexpr std::size_t operator[](std::size_t dim) const noexcept {
+    return index_[dim];
+  }
 
   /*
-   * @brief Returns a shape object representing the iteration space the index is
-   * within.
-   * @return THe shape object that represents the iteration space.
+   * @brief Returns the row-major position of the index within its iteration
+   * space, without recomputing it from the shape.
    */
-  shape get_shape() const noexcept { return iterationSpace_; }
+  constexpr std::size_t linear_id() const noexcept {
+    if constexpr (Rank > 1) {
+      return this->linearId_;
+    } else {
+      return index_[0];
+    }
+  }
 
  private:
-  size_t index_[3];
-  shape iterationSpace_;
+  std::array<std::size_t, Rank> index_;
 };
 
+/*
+ * @brief Structure which represents a contiguous range of indices along the
+ * innermost dimension of an iteration space of Rank dimensions, at a single
+ * position in each of the outer dimensions. Bulk functions wrapped with
+ * range_kernel are invoked once per range rather than once per index, so a
+ * loop over [begin(), end()) can be vectorized by the compiler.
+ * @tparam Rank Number of dimensions of the iteration space.
+ */
+template <std::size_t Rank>
+class index_range {
+ public:
+  /*
+   * @brief Constructs a range that starts at the point {coords...} and
+   * extends for size indices along the innermost dimension.
+   * @param coords Position of the first index of the range.
+   * @param linearBegin Row-major position of the first index of the range.
+   * @param size Number of indices in the range.
+   */
+  constexpr index_range(const std::array<std::size_t, Rank> &coords,
+                        std::size_t linearBegin, std::size_t size) noexcept
+      : first_{coords}, linearBegin_{linearBegin}, size_{size} {}
+
+  /*
+   * @brief Returns the number of dimensions of the range.
+   */
+  static constexpr std::size_t rank() noexcept { return Rank; }
+
+  /*
+   * @brief Returns the position of the range in an outer dimension, or the
+   * start of the range for the innermost dimension.
+   * @param dim Dimension to be returned.
+   */
+  constexpr std::size_t operator[](std::size_t dim) const noexcept {
+    return first_[dim];
+  }
+
+  /*
+   * @brief Returns the first position of the range along the innermost
+   * dimension.
+   */
+  constexpr std::size_t begin() const noexcept { return first_[Rank - 1]; }
+
+  /*
+   * @brief Returns the position past the last of the range along the
+   * innermost dimension.
+   */
+  constexpr std::size_t end() const noexcept { return begin() + size_; }
+
+  /*
+   * @brief Returns the number of indices in the range.
+   */
+  constexpr std::size_t size() const noexcept { return size_; }
+
+  /*
+   * @brief Returns the row-major position of the first index of the range.
+   * The indices of a range have consecutive linear ids.
+   */
+  constexpr std::size_t linear_begin() const noexcept { return linearBegin_; }
+
+ private:
+  std::array<std::size_t, Rank> first_;
+  std::size_t linearBegin_;
+  std::size_t size_;
+};
+
+/*
+ * @brief Wrapper marking a bulk function as taking an index_range rather than
+ * an index. It is created with enzen::range_kernel.
+ */
+template <typename Function>
+struct range_kernel_t {
+  Function function;
+};
+
+/*
+ * @brief Returns a bulk function which invokes function once for each
+ * contiguous range of indices along the innermost dimension of the iteration
+ * space, as function(index_range), rather than once for each index.
+ * @param function Function invoked as function(index_range).
+ */
+template <typename Function>
+range_kernel_t<std::decay_t<Function>> range_kernel(Function &&function) {
+  return {static_cast<Function &&>(function)};
+}
+
+namespace detail {
+
+template <typename Function>
+struct is_range_kernel : public std::false_type {};
+
+template <typename Function>
+struct is_range_kernel<range_kernel_t<Function>> : public std::true_type {};
+
+template <typename Function>
+inline constexpr bool is_range_kernel_v =
+    is_range_kernel<std::decay_t<Function>>::value;
+
+/*
+ * @brief Returns the range [begin, end) of chunk when numElements are split
+ * into numChunks contiguous ranges, with the remainder spread over the leading
+ * chunks.
+ */
+inline std::pair<std::size_t, std::size_t> chunk_bounds(
+    std::size_t numElements, std::size_t numChunks,
+    std::size_t chunk) noexcept {
+  auto chunkSize = numElements / numChunks;
+  auto remainder = numElements % numChunks;
+  auto begin = chunk * chunkSize + std::min(chunk, remainder);
+  return {begin, begin + chunkSize + (chunk < remainder ? 1 : 0)};
+}
+
+template <std::size_t Dim, std::size_t Rank, typename Function>
+void for_each_index_dim(const shape<Rank> &iterationSpace,
+                        std::array<std::size_t, Rank> &coords,
+                        std::size_t &linearId, Function &function) {
+  for (std::size_t i = 0; i < iterationSpace[Dim]; ++i) {
+    coords[Dim] = i;
+    if constexpr (Dim + 1 == Rank) {
+      function(enzen::index<Rank>{coords, linearId++});
+    } else {
+      for_each_index_dim<Dim + 1>(iterationSpace, coords, linearId, function);
+    }
+  }
+}
+
+/*
+ * @brief Invokes function with every index of iterationSpace in row-major
+ * order. This is a loop nest of exactly Rank loops, so a one dimensional
+ * iteration space is a single loop over its linear ids.
+ */
+template <std::size_t Rank, typename Function>
+void for_each_index(const shape<Rank> &iterationSpace, Function &&function) {
+  auto coords = std::array<std::size_t, Rank>{};
+  auto linearId = std::size_t{0};
+  for_each_index_dim<0>(iterationSpace, coords, linearId, function);
+}
+
+/*
+ * @brief Invokes function with every index of iterationSpace whose linear id
+ * is within [begin, end), in row-major order. Only the first index is computed
+ * from its linear id, the rest are found by incrementing the previous one.
+ */
+template <std::size_t Rank, typename Function>
+void for_each_index(const shape<Rank> &iterationSpace, std::size_t begin,
+                    std::size_t end, Function &&function) {
+  if constexpr (Rank == 1) {
+    for (auto id = begin; id < end; ++id) {
+      function(enzen::index<1>{std::array<std::size_t, 1>{id}, id});
+    }
+  } else {
+    if (begin >= end) {
+      return;
+    }
+    auto coords = delinearize(iterationSpace, begin);
+    for (auto id = begin; id < end; ++id) {
+      function(enzen::index<Rank>{coords, id});
+      for (auto dim = Rank; dim-- > 0;) {
+        if (++coords[dim] < iterationSpace[dim]) {
+          break;
+        }
+        coords[dim] = 0;
+      }
+    }
+  }
+}
+
+/*
+ * @brief Invokes function with every index_range of iterationSpace covering
+ * the linear ids [begin, end), in row-major order. A range never crosses the
+ * end of the innermost dimension, so a one dimensional iteration space gives a
+ * single range.
+ */
+template <std::size_t Rank, typename Function>
+void for_each_range(const shape<Rank> &iterationSpace, std::size_t begin,
+                    std::size_t end, Function &&function) {
+  if (begin >= end) {
+    return;
+  }
+  auto coords = delinearize(iterationSpace, begin);
+  auto extent = iterationSpace[Rank - 1];
+  while (begin < end) {
+    auto size = std::min(extent - coords[Rank - 1], end - begin);
+    function(enzen::index_range<Rank>{coords, begin, size});
+    begin += size;
+    coords[Rank - 1] = 0;
+    for (auto dim = Rank - 1; dim-- > 0;) {
+      if (++coords[dim] < iterationSpace[dim]) {
+        break;
+      }
+      coords[dim] = 0;
+    }
+  }
+}
+
+/*
+ * @brief Invokes function with every index_range of iterationSpace.
+ */
+template <std::size_t Rank, typename Function>
+void for_each_range(const shape<Rank> &iterationSpace, Function &&function) {
+  for_each_range(iterationSpace, 0, iterationSpace.size(), function);
+}
+
+/*
+ * @brief Invokes a bulk function for every index of iterationSpace whose
+ * linear id is within [begin, end): once per index_range for a range_kernel,
+ * otherwise once per index. Any further arguments are passed after the index
+ * or range.
+ */
+template <std::size_t Rank, typename Function, typename... Args>
+void invoke_bulk(Function &function, const shape<Rank> &iterationSpace,
+                 std::size_t begin, std::size_t end, Args &...args) {
+  if constexpr (is_range_kernel_v<Function>) {
+    for_each_range(iterationSpace, begin, end,
+                   [&](const enzen::index_range<Rank> &range) {
+                     std::invoke(function.function, range, args...);
+                   });
+  } else {
+    for_each_index(iterationSpace, begin, end, [&](enzen::index<Rank> idx) {
+      std::invoke(function, idx, args...);
+    });
+  }
+}
+
+/*
+ * @brief Invokes a bulk function for every index of iterationSpace, once per
+ * index_range for a range_kernel, otherwise once per index.
+ */
+template <std::size_t Rank, typename Function>
+void invoke_bulk(Function &function, const shape<Rank> &iterationSpace) {
+  if constexpr (is_range_kernel_v<Function>) {
+    for_each_range(iterationSpace, function.function);
+  } else {
+    for_each_index(iterationSpace, function);
+  }
+}
+
+/*
+ * @brief Invokes a bulk function for every index of iterationSpace whose
+ * linear id is within [begin, end), for a bulk function whose invocations are
+ * unsequenced. Each run along the innermost dimension is a single loop whose
+ * iterations are marked independent, so that it can be vectorized. Any
+ * further arguments are passed after the index or range.
+ */
+template <std::size_t Rank, typename Function, typename... Args>
+void invoke_bulk_unsequenced(Function &function,
+                             const shape<Rank> &iterationSpace,
+                             std::size_t begin, std::size_t end,
+                             Args &...args) {
+  if constexpr (is_range_kernel_v<Function>) {
+    invoke_bulk(function, iterationSpace, begin, end, args...);
+  } else {
+    for_each_range(
+        iterationSpace, begin, end, [&](const index_range<Rank> &range) {
+          auto coords = std::array<std::size_t, Rank>{};
+          for (std::size_t dim = 0; dim + 1 < Rank; ++dim) {
+            coords[dim] = range[dim];
+          }
+          auto first = range.begin();
+          auto linearBegin = range.linear_begin();
+          auto size = range.size();
+          ENZEN_PRAGMA_IVDEP
+          for (std::size_t i = 0; i < size; ++i) {
+            auto idxCoords = coords;
+            idxCoords[Rank - 1] = first + i;
+            std::invoke(function,
+                        enzen::index<Rank>{idxCoords, linearBegin + i},
+                        args...);
+          }
+        });
+  }
+}
+
+}  // namespace detail
+
 }  // namespace enzen
 
-#endif  // __ENZEN_INDEX_H__
\ No newline at end of file
+#endif  // __ENZEN_INDEX_H__
@@ -0,0 +1,351 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_LATENCY_HISTOGRAM_H__
+#define __ENZEN_LATENCY_HISTOGRAM_H__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#if __has_include(<cxxabi.h>)
+#include <cstdlib>
+#include <cxxabi.h>
+#endif  // __has_include(<cxxabi.h>)
+
+namespace enzen {
+
+namespace detail {
+
+/*
+ * @brief Bucket layout of a log-linear latency histogram. Values below
+ * sub_bucket_count each have their own bucket, and every power of two above
+ * that is split into sub_bucket_count linear buckets, which bounds the
+ * relative error of a recorded value to 1 / sub_bucket_count.
+ */
+struct latency_buckets {
+  static constexpr unsigned sub_bucket_bits = 4;
+  static constexpr std::uint64_t sub_bucket_count = 1 << sub_bucket_bits;
+  static constexpr std::size_t bucket_count =
+      (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+  static std::size_t index_of(std::uint64_t value) noexcept {
+    if (value < sub_bucket_count) {
+      return static_cast<std::size_t>(value);
+    }
+    auto exponent = static_cast<unsigned>(63 - __builtin_clzll(value));
+    auto shift = exponent - sub_bucket_bits;
+    auto subBucket = (value >> shift) & (sub_bucket_count - 1);
+    return static_cast<std::size_t>((shift + 1) * sub_bucket_count +
+                                    subBucket);
+  }
+
+  // Returns the largest value which is recorded in a bucket.
+  static std::uint64_t highest_value_of(std::size_t index) noexcept {
+    if (index < sub_bucket_count) {
+      return index;
+    }
+    auto shift = static_cast<unsigned>(index / sub_bucket_count - 1);
+    auto subBucket = index % sub_bucket_count;
+    auto lowest = (sub_bucket_count + subBucket) << shift;
+    return lowest + ((std::uint64_t{1} << shift) - 1);
+  }
+};
+
+/*
+ * @brief Buckets of a histogram recorded by a single thread. Only the owning
+ * thread writes to the buckets, so recording is a relaxed load and store.
+ */
+class latency_histogram_shard {
+ public:
+  void record(std::uint64_t value) noexcept {
+    auto &bucket = buckets_[latency_buckets::index_of(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  }
+
+  template <typename Counts>
+  void merge_into(Counts &counts) const noexcept {
+    for (std::size_t i = 0; i < latency_buckets::bucket_count; ++i) {
+      counts[i] += buckets_[i].load(std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  std::array<std::atomic<std::uint64_t>, latency_buckets::bucket_count>
+      buckets_{};
+};
+
+}  // namespace detail
+
+/*
+ * @brief Snapshot of a log-linear latency histogram, with values in
+ * nanoseconds.
+ */
+class latency_histogram {
+ public:
+  using counts_t = std::vector<std::uint64_t>;
+
+  latency_histogram()
+      : counts_(detail::latency_buckets::bucket_count, 0), totalCount_{0} {}
+
+  latency_histogram(counts_t counts) : counts_{std::move(counts)} {
+    totalCount_ = 0;
+    for (auto count : counts_) {
+      totalCount_ += count;
+    }
+  }
+
+  std::uint64_t count() const noexcept { return totalCount_; }
+
+  /*
+   * @brief Returns the latency below which the given percentage of the
+   * recorded values lie, to within the precision of the histogram.
+   * @param percentile Percentile in the range [0, 100].
+   */
+  std::chrono::nanoseconds percentile(double percentile) const noexcept {
+    if (totalCount_ == 0) {
+      return std::chrono::nanoseconds{0};
+    }
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    auto target = static_cast<std::uint64_t>(
+        percentile / 100.0 * static_cast<double>(totalCount_) + 0.5);
+    target = std::max<std::uint64_t>(target, 1);
+
+    auto seen = std::uint64_t{0};
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= target) {
+        return std::chrono::nanoseconds{
+            detail::latency_buckets::highest_value_of(i)};
+      }
+    }
+    return max();
+  }
+
+  std::chrono::nanoseconds max() const noexcept {
+    for (auto i = counts_.size(); i > 0; --i) {
+      if (counts_[i - 1] != 0) {
+        return std::chrono::nanoseconds{
+            detail::latency_buckets::highest_value_of(i - 1)};
+      }
+    }
+    return std::chrono::nanoseconds{0};
+  }
+
+  const counts_t &counts() const noexcept { return counts_; }
+
+ private:
+  counts_t counts_;
+  std::uint64_t totalCount_;
+};
+
+/*
+ * @brief Latencies of the tasks submitted with a kernel name: the time from
+ * submission until a worker starts the task, and the time spent running it.
+ */
+struct kernel_latency_stats {
+  std::string kernel_name;
+  latency_histogram queue_latency;
+  latency_histogram run_latency;
+};
+
+namespace detail {
+
+template <typename KernelName>
+std::string kernel_display_name() {
+  if constexpr (std::is_void_v<KernelName>) {
+    return "unnamed";
+  } else {
+    // The kernel name may be an incomplete type, so the name is taken from a
+    // pointer to it.
+    auto name = std::string{typeid(KernelName *).name()};
+#if __has_include(<cxxabi.h>)
+    auto status = 0;
+    auto demangled =
+        abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+    if (status == 0 && demangled != nullptr) {
+      name = demangled;
+    }
+    std::free(demangled);
+#endif  // __has_include(<cxxabi.h>)
+    if (!name.empty() && name.back() == '*') {
+      name.pop_back();
+    }
+    return name;
+  }
+}
+
+/*
+ * @brief Process wide registry of the latency histograms of each kernel name.
+ * Each kernel is given a dense id, which indexes a thread local table of the
+ * shards of the calling thread, so recording does not lock once a thread has
+ * recorded a kernel. Shards are owned by the registry, so they outlive the
+ * threads which recorded them.
+ */
+class kernel_latency_registry {
+  struct shard_pair {
+    latency_histogram_shard queue;
+    latency_histogram_shard run;
+  };
+
+  struct kernel_entry {
+    std::string name;
+    std::vector<std::unique_ptr<shard_pair>> shards;
+  };
+
+ public:
+  static kernel_latency_registry &get() {
+    static kernel_latency_registry registry;
+    return registry;
+  }
+
+  template <typename KernelName>
+  static std::size_t kernel_id() {
+    static const std::size_t id =
+        get().register_kernel(kernel_display_name<KernelName>());
+    return id;
+  }
+
+  void record(std::size_t kernelId, std::uint64_t queueNanoseconds,
+              std::uint64_t runNanoseconds) {
+    auto &shards = thread_shards(kernelId);
+    shards.queue.record(queueNanoseconds);
+    shards.run.record(runNanoseconds);
+  }
+
+  kernel_latency_stats stats(std::size_t kernelId) {
+    auto lock = std::lock_guard<std::mutex>{mutex_};
+    return merge(*kernels_[kernelId]);
+  }
+
+  std::vector<kernel_latency_stats> all_stats() {
+    auto lock = std::lock_guard<std::mutex>{mutex_};
+    auto result = std::vector<kernel_latency_stats>{};
+    result.reserve(kernels_.size());
+    for (auto &kernel : kernels_) {
+      result.push_back(merge(*kernel));
+    }
+    return result;
+  }
+
+ private:
+  kernel_latency_registry() = default;
+
+  std::size_t register_kernel(std::string name) {
+    auto lock = std::lock_guard<std::mutex>{mutex_};
+    kernels_.push_back(std::make_unique<kernel_entry>());
+    kernels_.back()->name = std::move(name);
+    return kernels_.size() - 1;
+  }
+
+  shard_pair &thread_shards(std::size_t kernelId) {
+    thread_local std::vector<shard_pair *> shards;
+    if (kernelId >= shards.size()) {
+      shards.resize(kernelId + 1, nullptr);
+    }
+    if (shards[kernelId] == nullptr) {
+      auto lock = std::lock_guard<std::mutex>{mutex_};
+      auto &kernelShards = kernels_[kernelId]->shards;
+      kernelShards.push_back(std::make_unique<shard_pair>());
+      shards[kernelId] = kernelShards.back().get();
+    }
+    return *shards[kernelId];
+  }
+
+  static kernel_latency_stats merge(const kernel_entry &kernel) {
+    auto queueCounts =
+        latency_histogram::counts_t(latency_buckets::bucket_count);
+    auto runCounts =
+        latency_histogram::counts_t(latency_buckets::bucket_count);
+    for (auto &shard : kernel.shards) {
+      shard->queue.merge_into(queueCounts);
+      shard->run.merge_into(runCounts);
+    }
+    return {kernel.name, latency_histogram{std::move(queueCounts)},
+            latency_histogram{std::move(runCounts)}};
+  }
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<kernel_entry>> kernels_;
+};
+
+/*
+ * @brief Wraps a task so that it records its queue and run latency against
+ * KernelName when it runs. Returns the task unchanged unless
+ * ENZEN_LATENCY_HISTOGRAMS is defined.
+ */
+template <typename KernelName, typename Function>
+auto record_kernel_latency(Function &&f) {
+#ifdef ENZEN_LATENCY_HISTOGRAMS
+  using clock_t = std::chrono::steady_clock;
+
+  auto kernelId = kernel_latency_registry::kernel_id<KernelName>();
+  auto submitTime = clock_t::now();
+  return [f = std::forward<Function>(f), kernelId, submitTime]() mutable {
+    auto startTime = clock_t::now();
+    f();
+    auto endTime = clock_t::now();
+    kernel_latency_registry::get().record(
+        kernelId,
+        static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(startTime -
+                                                                 submitTime)
+                .count()),
+        static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(endTime -
+                                                                 startTime)
+                .count()));
+  };
+#else
+  return std::forward<Function>(f);
+#endif  // ENZEN_LATENCY_HISTOGRAMS
+}
+
+}  // namespace detail
+
+/*
+ * @brief Returns the latency histograms recorded for tasks submitted with the
+ * kernel name KernelName, or for unnamed tasks if KernelName is void. Latencies
+ * are only recorded when compiled with ENZEN_LATENCY_HISTOGRAMS.
+ */
+template <typename KernelName = void>
+kernel_latency_stats kernel_latency() {
+  auto &registry = detail::kernel_latency_registry::get();
+  return registry.stats(
+      detail::kernel_latency_registry::kernel_id<KernelName>());
+}
+
+/*
+ * @brief Returns the latency histograms of every kernel name which has been
+ * recorded.
+ */
+inline std::vector<kernel_latency_stats> kernel_latencies() {
+  return detail::kernel_latency_registry::get().all_stats();
+}
+
+}  // namespace enzen
+
+#endif  // __ENZEN_LATENCY_HISTOGRAM_H__
@@ -0,0 +1,248 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_MAPPING_H__
+#define __ENZEN_MAPPING_H__
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <bits/group.h>
+#include <bits/index.h>
+#include <bits/properties.h>
+
+namespace enzen::detail {
+
+/*
+ * @brief Returns the edge of the tiles of a Morton mapping of Rank dimensions,
+ * a power of two giving between 256 and 1024 indices per tile.
+ */
+constexpr std::size_t morton_tile_edge(std::size_t rank) noexcept {
+  switch (rank) {
+    case 1:
+      return 1024;
+    case 2:
+      return 32;
+    case 3:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+/*
+ * @brief Returns the Morton code of a position, interleaving the bits of each
+ * dimension with the last dimension in the lowest bit.
+ */
+template <std::size_t Rank>
+std::uint64_t morton_code(const std::array<std::size_t, Rank> &coords) {
+  constexpr std::size_t bitsPerDim = 64 / Rank;
+  auto code = std::uint64_t{0};
+  for (std::size_t bit = 0; bit < bitsPerDim; ++bit) {
+    for (std::size_t dim = 0; dim < Rank; ++dim) {
+      auto value = (coords[Rank - 1 - dim] >> bit) & 1u;
+      code |= static_cast<std::uint64_t>(value) << (bit * Rank + dim);
+    }
+  }
+  return code;
+}
+
+/*
+ * @brief Returns whether mapping visits an iteration space of Rank dimensions
+ * in plain row-major order, which back-ends divide however suits them rather
+ * than by tiles. A one dimensional column-major mapping is also row-major.
+ */
+template <std::size_t Rank>
+constexpr bool is_row_major(const enzen::mapping_t &mapping) noexcept {
+  return mapping == enzen::mapping_t::row_major ||
+         (Rank == 1 && mapping == enzen::mapping_t::column_major);
+}
+
+/*
+ * @brief Division of an iteration space into tiles according to a mapping.
+ * Tiles are the units a back-end schedules, and the indices of a tile are
+ * always visited in row-major order:
+ *  - column_major: each tile is a run along the first dimension, and tiles
+ *    are ordered with the second dimension varying fastest.
+ *  - tiled: tiles have the requested extents, in row-major order.
+ *  - morton: tiles are power of two cubes, in Z-order.
+ * A row-major mapping is a single tile, which back-ends instead divide
+ * however suits them.
+ */
+template <std::size_t Rank>
+class bulk_tiling {
+ public:
+  bulk_tiling(const enzen::shape<Rank> &iterationSpace,
+              const enzen::mapping_t &mapping)
+      : iterationSpace_{iterationSpace}, columnMajor_{false} {
+    for (std::size_t dim = 0; dim < Rank; ++dim) {
+      if (mapping == enzen::mapping_t::column_major) {
+        tileExtent_[dim] = dim == 0 ? iterationSpace[0] : 1;
+      } else if (mapping == enzen::mapping_t::morton) {
+        tileExtent_[dim] = morton_tile_edge(Rank);
+      } else if (mapping == enzen::mapping_t::row_major) {
+        tileExtent_[dim] = iterationSpace[dim];
+      } else {
+        tileExtent_[dim] = mapping.tile_extent(dim);
+      }
+      tileExtent_[dim] = std::max<std::size_t>(tileExtent_[dim], 1);
+      gridExtent_[dim] =
+          (iterationSpace[dim] + tileExtent_[dim] - 1) / tileExtent_[dim];
+    }
+    numTiles_ = 1;
+    for (auto extent : gridExtent_) {
+      numTiles_ *= extent;
+    }
+    columnMajor_ = mapping == enzen::mapping_t::column_major;
+
+    if (mapping == enzen::mapping_t::morton) {
+      auto codes = std::vector<std::pair<std::uint64_t, std::size_t>>{};
+      codes.reserve(numTiles_);
+      for (std::size_t tile = 0; tile < numTiles_; ++tile) {
+        codes.emplace_back(morton_code<Rank>(grid_position(tile)), tile);
+      }
+      std::sort(codes.begin(), codes.end());
+      order_.reserve(numTiles_);
+      for (auto &code : codes) {
+        order_.push_back(code.second);
+      }
+    }
+  }
+
+  /*
+   * @brief Returns the number of tiles.
+   */
+  std::size_t num_tiles() const noexcept { return numTiles_; }
+
+  /*
+   * @brief Invokes a bulk function for every index of the tiles [begin, end),
+   * once per index_range for a range_kernel, otherwise once per index. Any
+   * further arguments are passed after the index or range.
+   */
+  template <typename Function, typename... Args>
+  void invoke_bulk(Function &function, std::size_t begin, std::size_t end,
+                   Args &...args) const {
+    for (auto tile = begin; tile < end; ++tile) {
+      auto origin = grid_position(order_.empty() ? tile : order_[tile]);
+      auto extent = std::array<std::size_t, Rank>{};
+      for (std::size_t dim = 0; dim < Rank; ++dim) {
+        origin[dim] *= tileExtent_[dim];
+        extent[dim] =
+            std::min(tileExtent_[dim], iterationSpace_[dim] - origin[dim]);
+      }
+
+      auto coords = origin;
+      if constexpr (is_range_kernel_v<Function>) {
+        visit_tile<0, true>(coords, origin, extent, 0,
+                            [&](const enzen::index_range<Rank> &range) {
+                              std::invoke(function.function, range, args...);
+                            });
+      } else {
+        visit_tile<0, false>(coords, origin, extent, 0,
+                             [&](enzen::index<Rank> idx) {
+                               std::invoke(function, idx, args...);
+                             });
+      }
+    }
+  }
+
+ private:
+  // Position of a tile in the grid of tiles, from its position in row-major
+  // order, or column-major order for a column-major mapping.
+  std::array<std::size_t, Rank> grid_position(std::size_t tile) const {
+    auto position = std::array<std::size_t, Rank>{};
+    if (columnMajor_) {
+      for (std::size_t dim = 0; dim < Rank; ++dim) {
+        position[dim] = tile % gridExtent_[dim];
+        tile /= gridExtent_[dim];
+      }
+    } else {
+      for (auto dim = Rank; dim-- > 0;) {
+        position[dim] = tile % gridExtent_[dim];
+        tile /= gridExtent_[dim];
+      }
+    }
+    return position;
+  }
+
+  // Visits a tile in row-major order, computing linear ids incrementally. A
+  // range kernel receives each run along the last dimension as one range.
+  template <std::size_t Dim, bool Ranges, typename Visitor>
+  void visit_tile(std::array<std::size_t, Rank> &coords,
+                  const std::array<std::size_t, Rank> &origin,
+                  const std::array<std::size_t, Rank> &extent,
+                  std::size_t linearBase, Visitor &&visitor) const {
+    if constexpr (Dim + 1 == Rank && Ranges) {
+      coords[Dim] = origin[Dim];
+      visitor(enzen::index_range<Rank>{
+          coords, linearBase * iterationSpace_[Dim] + origin[Dim],
+          extent[Dim]});
+    } else {
+      for (std::size_t i = 0; i < extent[Dim]; ++i) {
+        coords[Dim] = origin[Dim] + i;
+        auto linearId = linearBase * iterationSpace_[Dim] + coords[Dim];
+        if constexpr (Dim + 1 == Rank) {
+          visitor(enzen::index<Rank>{coords, linearId});
+        } else {
+          visit_tile<Dim + 1, Ranges>(coords, origin, extent, linearId,
+                                      visitor);
+        }
+      }
+    }
+  }
+
+  enzen::shape<Rank> iterationSpace_;
+  std::array<std::size_t, Rank> tileExtent_;
+  std::array<std::size_t, Rank> gridExtent_;
+  std::size_t numTiles_;
+  bool columnMajor_;
+  std::vector<std::size_t> order_;
+};
+
+/*
+ * @brief Invokes a bulk function for every index of iterationSpace in the
+ * order given by mapping, on the calling thread. Unsequenced invocations of a
+ * row-major mapping are run in loops which can be vectorized. A group kernel
+ * is invoked for every group in row-major order, whatever the mapping.
+ */
+template <std::size_t Rank, typename Function>
+void invoke_bulk(Function &function, const enzen::shape<Rank> &iterationSpace,
+                 const enzen::mapping_t &mapping,
+                 const enzen::bulk_guarantee_t &bulkGuarantee = {}) {
+  if constexpr (is_group_kernel_v<Function>) {
+    invoke_group_bulk(function, iterationSpace, 0,
+                      num_groups(function, iterationSpace));
+  } else if (is_row_major<Rank>(mapping)) {
+    if (bulkGuarantee == enzen::bulk_guarantee_t::unsequenced) {
+      invoke_bulk_unsequenced(function, iterationSpace, 0,
+                              iterationSpace.size());
+    } else {
+      invoke_bulk(function, iterationSpace);
+    }
+  } else {
+    auto tiling = bulk_tiling<Rank>{iterationSpace, mapping};
+    tiling.invoke_bulk(function, 0, tiling.num_tiles());
+  }
+}
+
+}  // namespace enzen::detail
+
+#endif  // __ENZEN_MAPPING_H__
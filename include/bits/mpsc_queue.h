@@ -0,0 +1,110 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_MPSC_QUEUE_H__
+#define __ENZEN_MPSC_QUEUE_H__
+
+#include <atomic>
+
+namespace enzen {
+
+/*
+ * @brief Base class of the nodes of an intrusive_mpsc_queue.
+ */
+class mpsc_queue_node {
+ public:
+  mpsc_queue_node() : next_{nullptr} {}
+
+ private:
+  template <typename>
+  friend class intrusive_mpsc_queue;
+
+  std::atomic<mpsc_queue_node *> next_;
+};
+
+/*
+ * @brief Lock-free intrusive queue supporting any number of concurrent
+ * producers and a single consumer. Pushing is a single atomic exchange and
+ * popping never blocks a producer. The queue does not own its nodes.
+ * @tparam Node Node type, which must derive from mpsc_queue_node.
+ * @note Based on the intrusive MPSC queue by Dmitry Vyukov.
+ */
+template <typename Node>
+class intrusive_mpsc_queue {
+ public:
+  intrusive_mpsc_queue() : head_{&stub_}, tail_{&stub_} {}
+
+  intrusive_mpsc_queue(const intrusive_mpsc_queue &) = delete;
+  intrusive_mpsc_queue &operator=(const intrusive_mpsc_queue &) = delete;
+
+  /*
+   * @brief Pushes a node onto the queue, may be called from any thread.
+   */
+  void push(Node *node) noexcept { push_node(node); }
+
+  /*
+   * @brief Pops a node from the queue, must only be called from the consumer
+   * thread.
+   * @return The popped node or nullptr if the queue is empty or a push is
+   * still in progress, in which case the pushing thread completes it shortly.
+   */
+  Node *try_pop() noexcept {
+    auto tail = tail_;
+    auto next = tail->next_.load(std::memory_order_acquire);
+
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next_.load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr) {
+      tail_ = next;
+      return static_cast<Node *>(tail);
+    }
+
+    if (tail != head_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+
+    push_node(&stub_);
+
+    next = tail->next_.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      tail_ = next;
+      return static_cast<Node *>(tail);
+    }
+    return nullptr;
+  }
+
+ private:
+  void push_node(mpsc_queue_node *node) noexcept {
+    node->next_.store(nullptr, std::memory_order_relaxed);
+    auto prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next_.store(node, std::memory_order_release);
+  }
+
+  std::atomic<mpsc_queue_node *> head_;
+  mpsc_queue_node *tail_;
+  mpsc_queue_node stub_;
+};
+
+}  // namespace enzen
+
+#endif  // __ENZEN_MPSC_QUEUE_H__
@@ -0,0 +1,48 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_PROBES_H__
+#define __ENZEN_PROBES_H__
+
+// USDT probes, which tools such as bpftrace and perf can attach to in a
+// running process, e.g. `bpftrace -e 'usdt:./app:enzen:task_start { ... }'`.
+// A probe which is not attached is a single nop. Probes are only compiled in
+// when ENZEN_USDT is defined, which the ENZEN_USDT CMake option does.
+
+#ifdef ENZEN_USDT
+
+#if !__has_include(<sys/sdt.h>)
+#error "ENZEN_USDT requires <sys/sdt.h>, provided by systemtap-sdt-dev."
+#endif  // !__has_include(<sys/sdt.h>)
+
+#include <sys/sdt.h>
+
+#define ENZEN_PROBE(name) DTRACE_PROBE(enzen, name);
+#define ENZEN_PROBE1(name, arg1) DTRACE_PROBE1(enzen, name, arg1);
+#define ENZEN_PROBE2(name, arg1, arg2) DTRACE_PROBE2(enzen, name, arg1, arg2);
+#define ENZEN_PROBE3(name, arg1, arg2, arg3) \
+  DTRACE_PROBE3(enzen, name, arg1, arg2, arg3);
+
+#else
+
+#define ENZEN_PROBE(name)
+#define ENZEN_PROBE1(name, arg1)
+#define ENZEN_PROBE2(name, arg1, arg2)
+#define ENZEN_PROBE3(name, arg1, arg2, arg3)
+
+#endif  // ENZEN_USDT
+
+#endif  // __ENZEN_PROBES_H__
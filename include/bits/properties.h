@@ -17,6 +17,10 @@ limitations under the License.
 #ifndef __ENZEN_PROPERTIES_H__
 #define __ENZEN_PROPERTIES_H__
 
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+
 #include "propria/prefer.hpp"
 #include "propria/query.hpp"
 #include "propria/require.hpp"
@@ -134,6 +138,14 @@ static constexpr const propria_query_fn::impl& query = propria::query;
 
 namespace detail {
 enum class blocking : int { none = -1, always, never, possibly };
+
+/*
+ * @brief Trait providing the value of a property which an executor type
+ * reports through a static constexpr query. Has no members if the executor
+ * cannot be queried for the property at compile time.
+ */
+template <class Executor, class Property, class = void>
+struct static_query {};
 }
 
 struct context_t {
@@ -214,12 +226,11 @@ class blocking_t {
     static constexpr bool is_requirable = true;
     static constexpr bool is_preferable = true;
 
-    // TODO(Gordon): Implement static_query_v
-#if 0
     template <class Executor>
-    static constexpr auto static_query_v =
-      std::declval<Executor>().query(always_t());
-#endif
+    static constexpr
+        typename detail::static_query<Executor, always_t>::result_type
+            static_query_v =
+                detail::static_query<Executor, always_t>::value();
 
     static constexpr blocking_t value() { return blocking_t(always_t()); }
   };
@@ -236,12 +247,11 @@ class blocking_t {
     static constexpr bool is_requirable = true;
     static constexpr bool is_preferable = true;
 
-    // TODO(Gordon): Implement static_query_v
-#if 0
     template <class Executor>
-    static constexpr auto static_query_v =
-      std::declval<Executor>().query(never_t());
-#endif
+    static constexpr
+        typename detail::static_query<Executor, never_t>::result_type
+            static_query_v =
+                detail::static_query<Executor, never_t>::value();
 
     static constexpr blocking_t value() { return blocking_t(never_t()); }
   };
@@ -258,12 +268,11 @@ class blocking_t {
     static constexpr bool is_requirable = true;
     static constexpr bool is_preferable = true;
 
-    // TODO(Gordon): Implement static_query_v
-#if 0
     template <class Executor>
-    static constexpr auto static_query_v =
-        std::declval<Executor>().query(possibly_t());
-#endif
+    static constexpr
+        typename detail::static_query<Executor, possibly_t>::result_type
+            static_query_v =
+                detail::static_query<Executor, possibly_t>::value();
 
     static constexpr blocking_t value() { return blocking_t(possibly_t()); }
   };
@@ -278,12 +287,10 @@ class blocking_t {
   static constexpr bool is_requirable = false;
   static constexpr bool is_preferable = false;
 
-  // TODO(Gordon): Implement static_query_v
-#if 0
   template <class Executor>
-  static constexpr auto static_query_v =
-    std::declval<Executor>().query(blocking_t());
-#endif
+  static constexpr
+      typename detail::static_query<Executor, blocking_t>::result_type
+          static_query_v = detail::static_query<Executor, blocking_t>::value();
 
   constexpr blocking_t() : _value{detail::blocking::none} {}
 
@@ -309,6 +316,33 @@ class blocking_t {
 
 constexpr blocking_t blocking{};
 
+namespace detail {
+
+template <class Executor>
+struct static_query<
+    Executor, blocking_t,
+    std::enable_if_t<(Executor::query(blocking_t{}), true)>> {
+  using result_type = blocking_t;
+
+  static constexpr result_type value() { return Executor::query(blocking_t{}); }
+};
+
+// A nested blocking property, such as blocking_t::never_t, can be queried at
+// compile time if the executor's blocking_t is that property.
+template <class Executor, class Property>
+struct static_query<
+    Executor, Property,
+    std::enable_if_t<(std::is_same_v<Property, blocking_t::always_t> ||
+                      std::is_same_v<Property, blocking_t::never_t> ||
+                      std::is_same_v<Property, blocking_t::possibly_t>) &&
+                     Executor::query(blocking_t{}) == Property::value()>> {
+  using result_type = Property;
+
+  static constexpr result_type value() { return Property{}; }
+};
+
+}  // namespace detail
+
 struct blocking_adaptation_t {};
 
 constexpr blocking_adaptation_t blocking_adaptation;
@@ -321,18 +355,342 @@ struct outstanding_work_t {};
 
 constexpr outstanding_work_t outstanding_work;
 
-struct bulk_guarantee_t {};
+namespace detail {
+enum class bulk_guarantee : int { unsequenced, sequenced, parallel };
+}
+
+/*
+ * @brief Property describing the guarantees a bulk executor makes about how
+ * the invocations of a bulk function may be interleaved, and so how freely
+ * the back-end may schedule them.
+ */
+class bulk_guarantee_t {
+ public:
+  /*
+   * @brief Invocations may be interleaved, even on one thread, so the
+   * back-end may batch them into loops that the compiler can vectorize.
+   */
+  class unsequenced_t {
+   public:
+    using polymorphic_query_result_type = bulk_guarantee_t;
+
+    template <class T>
+    static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+    static constexpr bool is_requirable = true;
+    static constexpr bool is_preferable = true;
+
+    static constexpr bulk_guarantee_t value() {
+      return bulk_guarantee_t(unsequenced_t());
+    }
+  };
+
+  static constexpr unsequenced_t unsequenced{};
+
+  /*
+   * @brief Invocations run one after another, in the order of the mapping,
+   * on a single thread.
+   */
+  class sequenced_t {
+   public:
+    using polymorphic_query_result_type = bulk_guarantee_t;
+
+    template <class T>
+    static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+    static constexpr bool is_requirable = true;
+    static constexpr bool is_preferable = true;
+
+    static constexpr bulk_guarantee_t value() {
+      return bulk_guarantee_t(sequenced_t());
+    }
+  };
+
+  static constexpr sequenced_t sequenced{};
+
+  /*
+   * @brief Invocations may run concurrently on different threads, but each
+   * runs to completion without being interleaved with others on its thread.
+   * This is the default guarantee.
+   */
+  class parallel_t {
+   public:
+    using polymorphic_query_result_type = bulk_guarantee_t;
+
+    template <class T>
+    static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+    static constexpr bool is_requirable = true;
+    static constexpr bool is_preferable = true;
+
+    static constexpr bulk_guarantee_t value() {
+      return bulk_guarantee_t(parallel_t());
+    }
+  };
+
+  static constexpr parallel_t parallel{};
+
+  using polymorphic_query_result_type = bulk_guarantee_t;
+
+  template <class T>
+  static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+  static constexpr bool is_requirable = false;
+  static constexpr bool is_preferable = false;
+
+  constexpr bulk_guarantee_t() : _value{detail::bulk_guarantee::parallel} {}
+
+  constexpr bulk_guarantee_t(const unsequenced_t)
+      : _value{detail::bulk_guarantee::unsequenced} {}
+
+  constexpr bulk_guarantee_t(const sequenced_t)
+      : _value{detail::bulk_guarantee::sequenced} {}
+
+  constexpr bulk_guarantee_t(const parallel_t)
+      : _value{detail::bulk_guarantee::parallel} {}
+
+  friend constexpr bool operator==(const bulk_guarantee_t& lhs,
+                                   const bulk_guarantee_t& rhs) {
+    return lhs._value == rhs._value;
+  }
+
+  friend constexpr bool operator!=(const bulk_guarantee_t& lhs,
+                                   const bulk_guarantee_t& rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+ private:
+  detail::bulk_guarantee _value;
+};
+
+constexpr bulk_guarantee_t bulk_guarantee{};
+
+namespace detail {
+enum class mapping : int { row_major, column_major, tiled, morton };
+}
+
+/*
+ * @brief Property describing the order in which a bulk executor visits the
+ * indices of an iteration space, and so which indices a single worker runs
+ * together.
+ */
+class mapping_t {
+ public:
+  /*
+   * @brief Indices are visited with the last dimension varying fastest. This
+   * is the default mapping.
+   */
+  class row_major_t {
+   public:
+    using polymorphic_query_result_type = mapping_t;
+
+    template <class T>
+    static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+    static constexpr bool is_requirable = true;
+    static constexpr bool is_preferable = true;
+
+    static constexpr mapping_t value() { return mapping_t(row_major_t()); }
+  };
+
+  static constexpr row_major_t row_major{};
+
+  /*
+   * @brief Indices are visited with the first dimension varying fastest. Each
+   * run along the first dimension is scheduled as a unit.
+   */
+  class column_major_t {
+   public:
+    using polymorphic_query_result_type = mapping_t;
+
+    template <class T>
+    static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+    static constexpr bool is_requirable = true;
+    static constexpr bool is_preferable = true;
+
+    static constexpr mapping_t value() { return mapping_t(column_major_t()); }
+  };
+
+  static constexpr column_major_t column_major{};
+
+  /*
+   * @brief Indices are visited in tiles of a given size, each scheduled as a
+   * unit and visited in row-major order. Tiles are visited in row-major order
+   * of their position in the iteration space.
+   */
+  class tiled_t {
+   public:
+    using polymorphic_query_result_type = mapping_t;
+
+    template <class T>
+    static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+    static constexpr bool is_requirable = true;
+    static constexpr bool is_preferable = true;
+
+    /*
+     * @brief Constructs tiles of {extents...}, for up to three dimensions.
+     * Dimensions beyond the last extent given use the last extent, so
+     * tiled_t{8} gives tiles of 8 in every dimension.
+     * @param extents Size of a tile in each of the leading dimensions.
+     */
+    template <typename... Extents,
+              typename = std::enable_if_t<(sizeof...(Extents) > 0)>>
+    explicit constexpr tiled_t(Extents... extents) noexcept
+        : extents_{}, size_{0} {
+      for (auto extent : {static_cast<std::size_t>(extents)...}) {
+        if (size_ < max_rank) {
+          extents_[size_++] = extent;
+        }
+      }
+    }
+
+    /*
+     * @brief Returns the size of a tile in a dimension.
+     */
+    constexpr std::size_t extent(std::size_t dim) const noexcept {
+      return dim < size_ ? extents_[dim] : extents_[size_ - 1];
+    }
+
+    constexpr mapping_t value() const { return mapping_t(*this); }
+
+    friend constexpr bool operator==(const tiled_t& lhs, const tiled_t& rhs) {
+      for (std::size_t dim = 0; dim < max_rank; ++dim) {
+        if (lhs.extent(dim) != rhs.extent(dim)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+   private:
+    static constexpr std::size_t max_rank = 3;
+
+    std::size_t extents_[max_rank];
+    std::size_t size_;
+  };
+
+  /*
+   * @brief Returns the property for tiles of {extents...}.
+   */
+  template <typename... Extents>
+  static constexpr tiled_t tiled(Extents... extents) noexcept {
+    return tiled_t{extents...};
+  }
+
+  /*
+   * @brief Indices are visited in small square tiles of a power of two size,
+   * each scheduled as a unit, and the tiles are visited in Z-order (Morton
+   * order), so that consecutive tiles are also close in every dimension.
+   */
+  class morton_t {
+   public:
+    using polymorphic_query_result_type = mapping_t;
+
+    template <class T>
+    static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+    static constexpr bool is_requirable = true;
+    static constexpr bool is_preferable = true;
+
+    static constexpr mapping_t value() { return mapping_t(morton_t()); }
+  };
+
+  static constexpr morton_t morton{};
+
+  using polymorphic_query_result_type = mapping_t;
+
+  template <class T>
+  static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+  static constexpr bool is_requirable = false;
+  static constexpr bool is_preferable = false;
+
+  constexpr mapping_t() : _value{detail::mapping::row_major}, _tile{1} {}
+
+  constexpr mapping_t(const row_major_t)
+      : _value{detail::mapping::row_major}, _tile{1} {}
 
-constexpr bulk_guarantee_t bulk_guarantee;
+  constexpr mapping_t(const column_major_t)
+      : _value{detail::mapping::column_major}, _tile{1} {}
 
-struct mapping_t {};
+  constexpr mapping_t(const tiled_t tile)
+      : _value{detail::mapping::tiled}, _tile{tile} {}
+
+  constexpr mapping_t(const morton_t)
+      : _value{detail::mapping::morton}, _tile{1} {}
+
+  /*
+   * @brief Returns the size of a tile in a dimension, if the mapping is
+   * tiled.
+   */
+  constexpr std::size_t tile_extent(std::size_t dim) const noexcept {
+    return _tile.extent(dim);
+  }
+
+  friend constexpr bool operator==(const mapping_t& lhs,
+                                   const mapping_t& rhs) {
+    return lhs._value == rhs._value &&
+           (lhs._value != detail::mapping::tiled || lhs._tile == rhs._tile);
+  }
+
+  friend constexpr bool operator!=(const mapping_t& lhs,
+                                   const mapping_t& rhs) {
+    return !operator==(lhs, rhs);
+  }
+
+ private:
+  detail::mapping _value;
+  tiled_t _tile;
+};
 
-constexpr mapping_t mapping;
+constexpr mapping_t mapping{};
 
+/*
+ * @brief Property which specifies the allocator used by an executor for the
+ * memory it allocates on behalf of submitted work, such as task storage in a
+ * back-end queue, the shared state of a future and the operation state of a
+ * sender.
+ * @tparam ProtoAllocator Allocator which is rebound to each allocated type.
+ */
 template <typename ProtoAllocator>
-struct allocator_t {};
+struct allocator_t {
+  template <class T>
+  static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+  static constexpr bool is_requirable = true;
+  static constexpr bool is_preferable = true;
+
+  constexpr explicit allocator_t(const ProtoAllocator& alloc) : _alloc{alloc} {}
+
+  constexpr ProtoAllocator value() const { return _alloc; }
+
+ private:
+  ProtoAllocator _alloc;
+};
+
+/*
+ * @brief Property object for the allocator of an executor. Requiring it
+ * directly selects the default allocator, and calling it with an allocator
+ * produces a property which selects that allocator.
+ */
+template <>
+struct allocator_t<void> {
+  template <class T>
+  static constexpr bool is_applicable_property_v = is_executor_v<T>;
+
+  static constexpr bool is_requirable = true;
+  static constexpr bool is_preferable = true;
+
+  template <typename ProtoAllocator>
+  constexpr allocator_t<ProtoAllocator> operator()(
+      const ProtoAllocator& alloc) const {
+    return allocator_t<ProtoAllocator>{alloc};
+  }
+};
 
-constexpr allocator_t<void> allocator;
+constexpr allocator_t<void> allocator{};
 
 template <typename KernelName>
 struct name_t {
@@ -17,20 +17,72 @@
 #ifndef __ENZEN_SENDER_H__
 #define __ENZEN_SENDER_H__
 
+#include <exception>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#include <bits/probes.h>
+
 namespace enzen {
 
+namespace detail {
+
+/*
+ * @brief Converts an error delivered to a receiver into an exception_ptr.
+ */
+template <typename Error>
+std::exception_ptr make_exception_ptr(Error &&error) {
+  if constexpr (std::is_same_v<std::decay_t<Error>, std::exception_ptr>) {
+    return error;
+  } else {
+    return std::make_exception_ptr(static_cast<Error &&>(error));
+  }
+}
+
+/*
+ * @brief Trait for whether a task submits work through executors which can be
+ * required to be never blocking, with a require_never_blocking member.
+ */
+template <typename Task, typename = void>
+struct has_require_never_blocking : public std::false_type {};
+
+template <typename Task>
+struct has_require_never_blocking<
+    Task, std::void_t<decltype(std::declval<const Task &>()
+                                   .require_never_blocking())>>
+    : public std::true_type {};
+
+/*
+ * @brief Returns task with every executor it submits work through required to
+ * be never blocking, or task itself if it has no such executors.
+ */
+template <typename Task>
+auto require_never_blocking(Task task) {
+  if constexpr (has_require_never_blocking<Task>::value) {
+    return task.require_never_blocking();
+  } else {
+    return task;
+  }
+}
+
+}  // namespace detail
+
 template <class Receiver>
 void set_done(Receiver receiver) {
+  ENZEN_PROBE1(set_done, typeid(Receiver).name())
   receiver.done();
 }
 
 template <class Receiver, class Error>
 void set_error(Receiver receiver, Error error) {
+  ENZEN_PROBE1(set_error, typeid(Receiver).name())
   receiver.error(error);
 }
 
 template <class Receiver, class Value>
 void set_value(Receiver receiver, Value value) {
+  ENZEN_PROBE1(set_value, typeid(Receiver).name())
   receiver.value(value);
 }
 
@@ -74,24 +126,17 @@ auto transform(Task task, Function function) {
           std::move(task), function};
 }
 
-template <typename Task>
-void sync_wait(Task task) {
-  auto promise = enzen::promise<typename Task::vaue_t>{};
-  auto future = promise.get_future();
-
-  submit(task, promise);
-
-  return future.wait();
-}
-
-template <typename Task>
-typename Task::value_t sync_get(Task task) {
-  auto promise = enzen::promise<typename Task::value_t>{};
-  auto future = promise.get_future();
-
-  submit(task, promise);
-
-  return future.get();
+/*
+ * @brief Returns a task which, once the value of task is available, invokes
+ * function with that value and completes with the result of the task that
+ * function returns.
+ * @param task Task producing the value.
+ * @param function Function returning the task to continue with.
+ */
+template <typename Task, typename Function>
+auto let_value(Task task, Function function) {
+  return typename Task::executor_t::backend_t::template let_value_task_t<
+      Task, Function>{std::move(task), function};
 }
 
 }  // namespace enzen
@@ -0,0 +1,122 @@
+/*
+  Copyright 2018 - 2019 Gordon Brown
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef __ENZEN_SYNC_WAIT_H__
+#define __ENZEN_SYNC_WAIT_H__
+
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+namespace enzen {
+
+namespace detail {
+
+/*
+ * @brief Receiver which stores the result of a task and finishes the run loop
+ * driven by the thread waiting on it.
+ */
+template <typename Value>
+class sync_wait_receiver {
+ public:
+  sync_wait_receiver(std::shared_ptr<run_loop_backend> loop,
+                     std::optional<Value> *valuePtr,
+                     std::exception_ptr *exceptionPtr)
+      : loop_{std::move(loop)},
+        valuePtr_{valuePtr},
+        exceptionPtr_{exceptionPtr} {}
+
+  template <typename IncomingValue>
+  void value(IncomingValue &&value) {
+    valuePtr_->emplace(static_cast<IncomingValue &&>(value));
+    loop_->finish();
+  }
+
+  template <typename Error>
+  void error(Error &&error) noexcept {
+    *exceptionPtr_ = detail::make_exception_ptr(static_cast<Error &&>(error));
+    loop_->finish();
+  }
+
+  void done() { loop_->finish(); }
+
+  /*
+   * @brief Returns an executor for the waiting thread, which runs its tasks
+   * until the waited task completes.
+   */
+  auto get_executor() const noexcept {
+    return run_loop_executor::rebind_blocking_t<
+        detail::executor_blocking::never>{loop_};
+  }
+
+ private:
+  std::shared_ptr<run_loop_backend> loop_;
+  std::optional<Value> *valuePtr_;
+  std::exception_ptr *exceptionPtr_;
+};
+
+template <typename Task>
+std::optional<typename Task::value_t> sync_wait_impl(Task task) {
+  using value_t = typename Task::value_t;
+
+  auto loop = std::make_shared<run_loop_backend>();
+  auto value = std::optional<value_t>{};
+  auto exception = std::exception_ptr{};
+
+  enzen::submit(std::move(task),
+                sync_wait_receiver<value_t>{loop, &value, &exception});
+
+  loop->run();
+
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+  return value;
+}
+
+}  // namespace detail
+
+/*
+ * @brief Submits a task and blocks the calling thread until it completes. The
+ * calling thread runs a run loop while it waits, parking whenever there is no
+ * work, and rethrows any error the task completes with.
+ * @param task Task to wait on.
+ */
+template <typename Task>
+void sync_wait(Task task) {
+  detail::sync_wait_impl(std::move(task));
+}
+
+/*
+ * @brief Submits a task, blocks the calling thread until it completes and
+ * returns its value. The calling thread runs a run loop while it waits,
+ * parking whenever there is no work.
+ * @param task Task to wait on.
+ * @return The value the task completes with.
+ */
+template <typename Task>
+typename Task::value_t sync_get(Task task) {
+  auto value = detail::sync_wait_impl(std::move(task));
+  if (!value) {
+    throw std::runtime_error("Task completed without a value.");
+  }
+  return std::move(*value);
+}
+
+}  // namespace enzen
+
+#endif  // __ENZEN_SYNC_WAIT_H__
@@ -0,0 +1,288 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef __ENZEN_TRACE_H__
+#define __ENZEN_TRACE_H__
+
+#ifdef ENZEN_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif  // defined(__x86_64__) || defined(__i386__)
+
+#ifndef ENZEN_TRACE_BUFFER_SIZE
+#define ENZEN_TRACE_BUFFER_SIZE 65536
+#endif  // ENZEN_TRACE_BUFFER_SIZE
+
+#define ENZEN_TRACE_EVENT(kind, arg)                                    \
+  ::enzen::detail::trace_recorder::record(                              \
+      ::enzen::detail::trace_event_kind::kind, static_cast<std::uint32_t>(arg));
+
+#define ENZEN_TRACE_WORKER(workerId) \
+  ::enzen::detail::trace_recorder::set_worker_id(workerId);
+
+namespace enzen::detail {
+
+enum class trace_event_kind : std::uint8_t {
+  enqueue,
+  dequeue,
+  start,
+  end,
+  steal,
+  park,
+  wake
+};
+
+inline const char *trace_event_name(trace_event_kind kind) noexcept {
+  switch (kind) {
+    case trace_event_kind::enqueue:
+      return "enqueue";
+    case trace_event_kind::dequeue:
+      return "dequeue";
+    case trace_event_kind::start:
+    case trace_event_kind::end:
+      return "task";
+    case trace_event_kind::steal:
+      return "steal";
+    case trace_event_kind::park:
+      return "park";
+    case trace_event_kind::wake:
+      return "wake";
+  }
+  return "unknown";
+}
+
+/*
+ * @brief Returns the time stamp counter where the processor has one, and the
+ * steady clock in nanoseconds otherwise.
+ */
+inline std::uint64_t trace_timestamp() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#endif  // defined(__x86_64__) || defined(__i386__)
+}
+
+struct trace_event {
+  std::uint64_t timestamp;
+  std::uint32_t arg;
+  std::uint16_t worker;
+  trace_event_kind kind;
+};
+
+static_assert(sizeof(trace_event) == 16, "trace events must be 16 bytes.");
+
+/*
+ * @brief Ring buffer of the events recorded by a single thread. Only the
+ * owning thread writes to it, so recording is a store and a release of the
+ * head; once full the oldest events are overwritten.
+ */
+class trace_buffer {
+ public:
+  static constexpr std::size_t capacity = ENZEN_TRACE_BUFFER_SIZE;
+
+  static_assert((capacity & (capacity - 1)) == 0,
+                "ENZEN_TRACE_BUFFER_SIZE must be a power of two.");
+
+  trace_buffer(std::size_t threadIndex)
+      : threadIndex_{threadIndex},
+        head_{0},
+        events_{std::make_unique<trace_event[]>(capacity)} {}
+
+  void push(const trace_event &event) noexcept {
+    auto head = head_.load(std::memory_order_relaxed);
+    events_[head & (capacity - 1)] = event;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  template <typename Function>
+  void for_each(Function &&f) const {
+    auto head = head_.load(std::memory_order_acquire);
+    auto first = head > capacity ? head - capacity : 0;
+    for (auto i = first; i < head; ++i) {
+      f(events_[i & (capacity - 1)]);
+    }
+  }
+
+  void clear() noexcept { head_.store(0, std::memory_order_release); }
+
+  std::size_t thread_index() const noexcept { return threadIndex_; }
+
+ private:
+  std::size_t threadIndex_;
+  std::atomic<std::size_t> head_;
+  std::unique_ptr<trace_event[]> events_;
+};
+
+/*
+ * @brief Process wide registry of the trace buffers of every thread which has
+ * recorded an event. Buffers outlive their threads so that a trace can be
+ * written after a pool has been joined.
+ */
+class trace_recorder {
+ public:
+  static constexpr std::uint16_t no_worker = 0xffff;
+
+  static trace_recorder &get() {
+    static trace_recorder recorder;
+    return recorder;
+  }
+
+  static void record(trace_event_kind kind, std::uint32_t arg) noexcept {
+    thread_buffer().push(
+        trace_event{trace_timestamp(), arg, thread_worker_id(), kind});
+  }
+
+  static void set_worker_id(std::size_t workerId) noexcept {
+    thread_worker_id() = static_cast<std::uint16_t>(workerId);
+  }
+
+  /*
+   * @brief Writes the recorded events in the Chrome trace event format, which
+   * can be loaded by chrome://tracing and Perfetto. Events recorded
+   * concurrently with writing the trace may be torn, so it should be written
+   * once the traced work has completed.
+   */
+  void write_chrome_trace(std::ostream &os) {
+    auto lock = std::lock_guard<std::mutex>{mutex_};
+
+    auto ticksPerMicrosecond = calibrate();
+    auto separator = "\n";
+
+    os << "{\"traceEvents\":[";
+    for (auto &buffer : buffers_) {
+      auto tid = buffer->thread_index();
+      auto worker = no_worker;
+
+      buffer->for_each([&](const trace_event &event) {
+        worker = event.worker;
+        auto ts = static_cast<double>(event.timestamp - startTicks_) /
+                  ticksPerMicrosecond;
+
+        os << separator << "{\"name\":\"" << trace_event_name(event.kind)
+           << "\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << ts;
+        if (event.kind == trace_event_kind::start) {
+          os << ",\"ph\":\"B\"";
+        } else if (event.kind == trace_event_kind::end) {
+          os << ",\"ph\":\"E\"";
+        } else {
+          os << ",\"ph\":\"i\",\"s\":\"t\"";
+        }
+        os << ",\"args\":{\"arg\":" << event.arg << "}}";
+        separator = ",\n";
+      });
+
+      os << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+         << "\"tid\":" << tid << ",\"args\":{\"name\":\"";
+      if (worker == no_worker) {
+        os << "thread " << tid;
+      } else {
+        os << "worker " << worker;
+      }
+      os << "\"}}";
+      separator = ",\n";
+    }
+    os << "\n]}\n";
+  }
+
+  /*
+   * @brief Discards the recorded events. Should only be called while no
+   * threads are recording.
+   */
+  void clear() {
+    auto lock = std::lock_guard<std::mutex>{mutex_};
+    for (auto &buffer : buffers_) {
+      buffer->clear();
+    }
+  }
+
+ private:
+  trace_recorder()
+      : startTicks_{trace_timestamp()},
+        startTime_{std::chrono::steady_clock::now()} {}
+
+  static trace_buffer &thread_buffer() {
+    thread_local trace_buffer *buffer = get().register_thread();
+    return *buffer;
+  }
+
+  static std::uint16_t &thread_worker_id() {
+    thread_local std::uint16_t workerId = no_worker;
+    return workerId;
+  }
+
+  trace_buffer *register_thread() {
+    auto lock = std::lock_guard<std::mutex>{mutex_};
+    buffers_.push_back(std::make_unique<trace_buffer>(buffers_.size()));
+    return buffers_.back().get();
+  }
+
+  // Measures the rate of the timestamp counter against the steady clock since
+  // the recorder was created.
+  double calibrate() const {
+    auto minimumElapsed = std::chrono::milliseconds(10);
+    if (std::chrono::steady_clock::now() - startTime_ < minimumElapsed) {
+      std::this_thread::sleep_for(minimumElapsed);
+    }
+    auto ticks = trace_timestamp();
+    auto elapsed = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - startTime_);
+    return static_cast<double>(ticks - startTicks_) / elapsed.count();
+  }
+
+  std::uint64_t startTicks_;
+  std::chrono::steady_clock::time_point startTime_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<trace_buffer>> buffers_;
+};
+
+}  // namespace enzen::detail
+
+namespace enzen {
+
+/*
+ * @brief Writes the events recorded by all threads as Chrome trace JSON.
+ * Only available when compiled with ENZEN_TRACE.
+ */
+inline void write_trace(std::ostream &os) {
+  detail::trace_recorder::get().write_chrome_trace(os);
+}
+
+inline void clear_trace() { detail::trace_recorder::get().clear(); }
+
+}  // namespace enzen
+
+#else
+
+#define ENZEN_TRACE_EVENT(kind, arg)
+#define ENZEN_TRACE_WORKER(workerId)
+
+#endif  // ENZEN_TRACE
+
+#endif  // __ENZEN_TRACE_H__
@@ -0,0 +1,209 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <execution>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<int> make_input(std::size_t size) {
+  auto input = std::vector<int>(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    input[i] = static_cast<int>((i * 7919) % 1000) - 500;
+  }
+  return input;
+}
+
+// Sizes smaller than, equal to and not a multiple of the number of workers.
+const std::size_t sizes[] = {0, 1, 3, 4, 1000, 1023};
+
+}  // namespace
+
+TEST_CASE("for_each", "algorithm") {
+  auto threadPool = enzen::static_thread_pool{4};
+
+  for (auto size : sizes) {
+    auto input = make_input(size);
+    enzen::for_each(threadPool.executor(), input.begin(), input.end(),
+                    [](int &value) { value *= 2; });
+
+    auto expected = make_input(size);
+    for (auto &value : expected) {
+      value *= 2;
+    }
+    REQUIRE(input == expected);
+  }
+}
+
+TEST_CASE("transform", "algorithm") {
+  auto threadPool = enzen::static_thread_pool{4};
+
+  for (auto size : sizes) {
+    auto input = make_input(size);
+    auto output = std::vector<long>(size);
+    auto end = enzen::transform(threadPool.executor(), input.begin(),
+                                input.end(), output.begin(),
+                                [](int value) { return value * 3L; });
+
+    REQUIRE(end == output.end());
+    for (std::size_t i = 0; i < size; ++i) {
+      REQUIRE(output[i] == input[i] * 3L);
+    }
+
+    auto sums = std::vector<long>(size);
+    enzen::transform(threadPool.executor(), input.begin(), input.end(),
+                     output.begin(), sums.begin(),
+                     [](int lhs, long rhs) { return lhs + rhs; });
+    for (std::size_t i = 0; i < size; ++i) {
+      REQUIRE(sums[i] == input[i] * 4L);
+    }
+  }
+}
+
+TEST_CASE("reduce", "algorithm") {
+  auto threadPool = enzen::static_thread_pool{4};
+
+  for (auto size : sizes) {
+    auto input = make_input(size);
+    auto sum =
+        enzen::reduce(threadPool.executor(), input.begin(), input.end(), 10L);
+
+    REQUIRE(sum == std::accumulate(input.begin(), input.end(), 10L));
+  }
+}
+
+TEST_CASE("reduce_preserves_order", "algorithm") {
+  auto threadPool = enzen::static_thread_pool{4};
+
+  auto input = std::vector<std::string>{};
+  for (char c = 'a'; c <= 'z'; ++c) {
+    input.push_back(std::string(1, c));
+  }
+
+  auto result = enzen::reduce(threadPool.executor(), input.begin(),
+                              input.end(), std::string{">"});
+
+  REQUIRE(result == ">abcdefghijklmnopqrstuvwxyz");
+}
+
+TEST_CASE("transform_reduce", "algorithm") {
+  auto threadPool = enzen::static_thread_pool{4};
+
+  for (auto size : sizes) {
+    auto input = make_input(size);
+
+    auto sumOfSquares = enzen::transform_reduce(
+        threadPool.executor(), input.begin(), input.end(), 0L, std::plus<>{},
+        [](int value) { return static_cast<long>(value) * value; });
+    auto dot = enzen::transform_reduce(threadPool.executor(), input.begin(),
+                                       input.end(), input.begin(), 0L);
+
+    auto expected = 0L;
+    for (auto value : input) {
+      expected += static_cast<long>(value) * value;
+    }
+    REQUIRE(sumOfSquares == expected);
+    REQUIRE(dot == expected);
+  }
+}
+
+TEST_CASE("inclusive_scan", "algorithm") {
+  auto threadPool = enzen::static_thread_pool{4};
+
+  for (auto size : sizes) {
+    auto input = make_input(size);
+    auto output = std::vector<int>(size);
+    auto end = enzen::inclusive_scan(threadPool.executor(), input.begin(),
+                                     input.end(), output.begin());
+
+    auto expected = std::vector<int>(size);
+    std::partial_sum(input.begin(), input.end(), expected.begin());
+    REQUIRE(end == output.end());
+    REQUIRE(output == expected);
+  }
+}
+
+TEST_CASE("sort", "algorithm") {
+  for (std::size_t numThreads : {1, 2, 3, 4, 7}) {
+    auto threadPool = enzen::static_thread_pool{numThreads};
+
+    for (auto size : sizes) {
+      auto input = make_input(size);
+      enzen::sort(threadPool.executor(), input.begin(), input.end());
+
+      auto expected = make_input(size);
+      std::sort(expected.begin(), expected.end());
+      REQUIRE(input == expected);
+
+      enzen::sort(threadPool.executor(), input.begin(), input.end(),
+                  std::greater<>{});
+      REQUIRE(std::is_sorted(input.begin(), input.end(), std::greater<>{}));
+    }
+  }
+}
+
+TEST_CASE("copy_if", "algorithm") {
+  auto threadPool = enzen::static_thread_pool{4};
+
+  for (auto size : sizes) {
+    auto input = make_input(size);
+    auto output = std::vector<int>(size);
+    auto isEven = [](int value) { return value % 2 == 0; };
+
+    auto end = enzen::copy_if(threadPool.executor(), input.begin(),
+                              input.end(), output.begin(), isEven);
+    output.erase(end, output.end());
+
+    auto expected = std::vector<int>{};
+    std::copy_if(input.begin(), input.end(), std::back_inserter(expected),
+                 isEven);
+    REQUIRE(output == expected);
+  }
+}
+
+TEST_CASE("exception", "algorithm") {
+  auto threadPool = enzen::static_thread_pool{4};
+
+  auto input = std::vector<int>(100);
+  std::iota(input.begin(), input.end(), 0);
+
+  REQUIRE_THROWS_AS(
+      enzen::for_each(threadPool.executor(), input.begin(), input.end(),
+                      [](int value) {
+                        if (value == 42) {
+                          throw std::runtime_error("42");
+                        }
+                      }),
+      std::runtime_error);
+}
+
+TEST_CASE("inline_executor", "algorithm") {
+  enzen::inline_context inlineContext{};
+
+  auto input = make_input(100);
+  auto sum = enzen::reduce(inlineContext.executor(), input.begin(),
+                           input.end(), 0);
+  enzen::sort(inlineContext.executor(), input.begin(), input.end());
+
+  REQUIRE(sum == std::accumulate(input.begin(), input.end(), 0));
+  REQUIRE(std::is_sorted(input.begin(), input.end()));
+}
@@ -0,0 +1,492 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <execution>
+#include <memory>
+#include <new>
+#include <set>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+struct allocation_counts {
+  std::atomic<int> attempts{0};
+  std::atomic<int> allocations{0};
+  std::atomic<int> deallocations{0};
+
+  // The attempt, counting from 1, which throws std::bad_alloc, or 0 if none
+  // do.
+  int failAt = 0;
+};
+
+template <typename T>
+class counting_allocator {
+ public:
+  using value_type = T;
+
+  counting_allocator(allocation_counts *counts) : counts_{counts} {}
+
+  template <typename U>
+  counting_allocator(const counting_allocator<U> &other)
+      : counts_{other.counts_} {}
+
+  T *allocate(std::size_t n) {
+    if (++counts_->attempts == counts_->failAt) {
+      throw std::bad_alloc{};
+    }
+    ++counts_->allocations;
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  void deallocate(T *ptr, std::size_t n) {
+    ++counts_->deallocations;
+    std::allocator<T>{}.deallocate(ptr, n);
+  }
+
+  template <typename U>
+  friend bool operator==(const counting_allocator &lhs,
+                         const counting_allocator<U> &rhs) {
+    return lhs.counts_ == rhs.counts_;
+  }
+
+  template <typename U>
+  friend bool operator!=(const counting_allocator &lhs,
+                         const counting_allocator<U> &rhs) {
+    return lhs.counts_ != rhs.counts_;
+  }
+
+ private:
+  template <typename U>
+  friend class counting_allocator;
+
+  allocation_counts *counts_;
+};
+
+class value_receiver {
+ public:
+  value_receiver(std::atomic<int> *result) : result_{result} {}
+
+  void value(int value) { *result_ = value; }
+
+  void done() {}
+
+  void error(std::exception_ptr) noexcept {}
+
+ private:
+  std::atomic<int> *result_;
+};
+
+}  // namespace
+
+TEST_CASE("require_allocator", "allocator") {
+  enzen::inline_context inlineContext{};
+  auto counts = allocation_counts{};
+
+  auto exec = inlineContext.executor();
+  REQUIRE(std::is_same_v<decltype(enzen::query(exec, enzen::allocator)),
+                         std::allocator<void>>);
+
+  auto allocExec = enzen::require(
+      exec, enzen::allocator(counting_allocator<void>{&counts}));
+  REQUIRE(enzen::query(allocExec, enzen::allocator) ==
+          counting_allocator<void>{&counts});
+
+  // The allocator is kept when requiring other properties.
+  auto bulkExec = enzen::require(
+      enzen::require_concept(allocExec, enzen::bulk_oneway),
+      enzen::blocking.always);
+  REQUIRE(enzen::query(bulkExec, enzen::allocator) ==
+          counting_allocator<void>{&counts});
+
+  auto defaultExec = enzen::require(bulkExec, enzen::allocator);
+  REQUIRE(std::is_same_v<decltype(enzen::query(defaultExec, enzen::allocator)),
+                         std::allocator<void>>);
+}
+
+TEST_CASE("thread_pool_task_allocator", "allocator") {
+  auto counts = allocation_counts{};
+  {
+    auto threadPool = enzen::static_thread_pool{4};
+
+    auto exec = enzen::require(
+        enzen::require(threadPool.executor(), enzen::blocking.never),
+        enzen::allocator(counting_allocator<void>{&counts}));
+
+    // Functions which fit in a queue entry are stored inline.
+    auto res = std::array<std::atomic<int>, 16>{};
+    for (int i = 0; i < 16; ++i) {
+      exec.execute([&res, i]() { res[i] = i; });
+    }
+    threadPool.wait();
+    REQUIRE(counts.allocations == 0);
+
+    // Larger functions are allocated with the allocator of the executor.
+    auto payload = std::array<int, 32>{};
+    for (int i = 0; i < 32; ++i) {
+      payload[i] = i;
+    }
+    for (int i = 0; i < 16; ++i) {
+      exec.execute([&res, payload, i]() { res[i] = payload[i] * 2; });
+    }
+    threadPool.wait();
+
+    for (int i = 0; i < 16; ++i) {
+      REQUIRE(res[i] == i * 2);
+    }
+    REQUIRE(counts.allocations == 16);
+  }
+  REQUIRE(counts.deallocations == counts.allocations);
+}
+
+TEST_CASE("future_shared_state_allocator", "allocator") {
+  auto counts = allocation_counts{};
+  {
+    auto threadPool = enzen::static_thread_pool{2};
+
+    auto twowayExec = enzen::require_concept(
+        enzen::require(threadPool.executor(),
+                       enzen::allocator(counting_allocator<void>{&counts})),
+        enzen::twoway);
+
+    auto fut = twowayExec.twoway_execute([]() { return 1234; });
+    REQUIRE(fut.get() == 1234);
+    REQUIRE(counts.allocations >= 1);
+
+    threadPool.wait();
+  }
+  REQUIRE(counts.deallocations == counts.allocations);
+}
+
+TEST_CASE("bulk_sender_allocator", "allocator") {
+  auto counts = allocation_counts{};
+  {
+    auto threadPool = enzen::static_thread_pool{4};
+
+    auto lazyExec = enzen::require_concept(
+        enzen::require(threadPool.executor(),
+                       enzen::allocator(counting_allocator<void>{&counts})),
+        enzen::lazy);
+
+    auto visited = std::vector<std::atomic<int>>(64);
+
+    auto s1 = enzen::via(lazyExec, enzen::just(3));
+    auto s2 = enzen::bulk(s1, enzen::shape{64},
+                          [&visited](enzen::index<1> idx, int value) {
+                            visited[idx.linear_id()] += value;
+                          });
+
+    auto result = std::atomic<int>{0};
+    enzen::submit(s2, value_receiver{&result});
+
+    threadPool.wait();
+
+    for (auto &count : visited) {
+      REQUIRE(count == 3);
+    }
+    REQUIRE(result == 3);
+
+    // The shared state of the bulk operation is allocated with the allocator.
+    REQUIRE(counts.allocations >= 1);
+  }
+  REQUIRE(counts.deallocations == counts.allocations);
+}
+
+TEST_CASE("bulk_sender_enqueue_failure", "allocator") {
+  auto counts = allocation_counts{};
+  {
+    auto threadPool = enzen::static_thread_pool{4};
+
+    auto lazyExec = enzen::require_concept(
+        enzen::require(threadPool.executor(),
+                       enzen::allocator(counting_allocator<void>{&counts})),
+        enzen::lazy);
+
+    auto visited = std::atomic<int>{0};
+
+    // The tasks of a rank 3 operation are too large to be stored inline, so
+    // each of the four chunks allocates its task after the shared state.
+    auto s1 = enzen::via(lazyExec, enzen::just(3));
+    auto s2 = enzen::bulk(s1, enzen::shape{4, 4, 4},
+                          [&visited](enzen::index<3>, int) { visited++; });
+
+    REQUIRE(enzen::sync_get(s2) == 3);
+    REQUIRE(visited == 64);
+
+    // Once a chunk fails to be enqueued, the error is delivered after the
+    // chunks enqueued before it have run, rather than never.
+    counts.failAt = counts.attempts * 2 - 1;
+    visited = 0;
+    REQUIRE_THROWS_AS(enzen::sync_wait(s2), std::bad_alloc);
+    REQUIRE(visited == 32);
+  }
+  REQUIRE(counts.deallocations == counts.allocations);
+}
+
+TEST_CASE("run_loop_task_allocator", "allocator") {
+  auto counts = allocation_counts{};
+  {
+    enzen::run_loop runLoop{};
+
+    auto exec = enzen::require(
+        enzen::require(runLoop.executor(), enzen::blocking.never),
+        enzen::allocator(counting_allocator<void>{&counts}));
+
+    auto sum = 0;
+    for (int i = 1; i <= 10; ++i) {
+      exec.execute([&sum, i]() { sum += i; });
+    }
+    REQUIRE(counts.allocations == 10);
+
+    REQUIRE(runLoop.poll() == 10);
+    REQUIRE(sum == 55);
+    REQUIRE(counts.deallocations == 10);
+  }
+}
+
+TEST_CASE("arena_allocator_reuse", "allocator") {
+  auto alloc = enzen::arena_allocator<std::uint64_t>{};
+
+  auto first = alloc.allocate(4);
+  alloc.deallocate(first, 4);
+
+  // A freed allocation is reused by the next allocation of its size class.
+  auto second = alloc.allocate(3);
+  REQUIRE(second == first);
+  alloc.deallocate(second, 3);
+
+  // Allocations of different size classes do not overlap.
+  auto small = alloc.allocate(1);
+  auto large = alloc.allocate(64);
+  REQUIRE((small + 1 <= large || large + 64 <= small));
+  alloc.deallocate(small, 1);
+  alloc.deallocate(large, 64);
+
+  // Allocations larger than the largest size class use operator new.
+  auto huge = alloc.allocate(4096);
+  huge[4095] = 1;
+  alloc.deallocate(huge, 4096);
+}
+
+TEST_CASE("arena_allocator_alignment", "allocator") {
+  struct alignas(64) cache_line {
+    char bytes[64];
+  };
+
+  auto alloc = enzen::arena_allocator<cache_line>{};
+  auto lines = std::vector<cache_line *>{};
+  for (int i = 0; i < 100; ++i) {
+    lines.push_back(alloc.allocate(1));
+    REQUIRE(reinterpret_cast<std::uintptr_t>(lines.back()) % 64 == 0);
+  }
+
+  auto unique = std::set<cache_line *>(lines.begin(), lines.end());
+  REQUIRE(unique.size() == lines.size());
+
+  for (auto line : lines) {
+    alloc.deallocate(line, 1);
+  }
+}
+
+TEST_CASE("arena_allocator_cross_thread", "allocator") {
+  auto alloc = enzen::arena_allocator<int>{};
+
+  // Memory allocated on one thread may be freed on another, and flows back
+  // through the depot once the freeing thread holds a surplus.
+  for (int round = 0; round < 4; ++round) {
+    auto ptrs = std::vector<int *>{};
+    for (int i = 0; i < 1000; ++i) {
+      ptrs.push_back(alloc.allocate(1));
+      *ptrs.back() = i;
+    }
+
+    auto freeing = std::thread{[&]() {
+      for (int i = 0; i < 1000; ++i) {
+        REQUIRE(*ptrs[i] == i);
+        alloc.deallocate(ptrs[i], 1);
+      }
+    }};
+    freeing.join();
+  }
+}
+
+TEST_CASE("thread_pool_arena_allocator", "allocator") {
+  auto threadPool = enzen::static_thread_pool{4};
+
+  auto exec = enzen::require(
+      enzen::require(threadPool.executor(), enzen::blocking.never),
+      enzen::allocator(enzen::arena_allocator<void>{}));
+
+  auto sum = std::atomic<long>{0};
+  auto payload = std::array<long, 16>{};
+  for (int i = 0; i < 16; ++i) {
+    payload[i] = i;
+  }
+
+  for (int i = 0; i < 10000; ++i) {
+    exec.execute([&sum, payload, i]() { sum += payload[i % 16]; });
+  }
+  threadPool.wait();
+
+  REQUIRE(sum == 10000 / 16 * 120);
+
+  auto twowayExec = enzen::require_concept(exec, enzen::twoway);
+  auto fut = twowayExec.twoway_execute([]() { return 42; });
+  REQUIRE(fut.get() == 42);
+}
+
+TEST_CASE("thread_pool_slab_reuse", "allocator") {
+  auto threadPool = enzen::static_thread_pool{2};
+  auto exec = enzen::require(threadPool.executor(), enzen::blocking.never);
+
+  auto sum = std::atomic<int>{0};
+  auto payload = std::array<int, 32>{};
+  payload[31] = 1;
+
+  // Closures submitted from outside the pool are allocated from the external
+  // heap, and freed remotely by the workers which run them.
+  for (int i = 0; i < 1000; ++i) {
+    exec.execute([&sum, payload]() { sum += payload[31]; });
+  }
+  threadPool.wait();
+
+  auto first = threadPool.stats().external_allocator;
+  REQUIRE(first.allocations == 1000);
+  REQUIRE(first.fallback_allocations == 0);
+  REQUIRE(first.slabs >= 1);
+
+  // Once the workers have freed them, the blocks are reclaimed and reused, so
+  // no further slabs are needed.
+  for (int i = 0; i < 1000; ++i) {
+    exec.execute([&sum, payload]() { sum += payload[31]; });
+    threadPool.wait();
+  }
+
+  auto second = threadPool.stats().external_allocator;
+  REQUIRE(sum == 2000);
+  REQUIRE(second.allocations == 2000);
+  REQUIRE(second.slabs == first.slabs);
+  REQUIRE(second.remote_frees >= 1000);
+  REQUIRE(second.reclaim_batches >= 1);
+  REQUIRE(second.local_frees == 0);
+  REQUIRE(second.remote_free_rate() == 1.0);
+}
+
+TEST_CASE("thread_pool_large_closure_alignment", "allocator") {
+  struct alignas(64) large_payload {
+    std::array<int, 1024> values;
+  };
+
+  auto threadPool = enzen::static_thread_pool{2};
+  auto exec = enzen::require(threadPool.executor(), enzen::blocking.never);
+
+  auto addresses = std::array<std::atomic<std::uintptr_t>, 64>{};
+  auto payload = large_payload{};
+
+  // Closures too large for any size class still get the alignment of their
+  // members. The addresses are checked on the host, as the compiler may
+  // assume that the alignment holds within the closure.
+  for (std::size_t i = 0; i < addresses.size(); ++i) {
+    exec.execute([&addresses, payload, i]() {
+      addresses[i] = reinterpret_cast<std::uintptr_t>(&payload);
+    });
+  }
+  threadPool.wait();
+
+  for (auto &address : addresses) {
+    REQUIRE(address % 64 == 0);
+  }
+  REQUIRE(threadPool.stats().external_allocator.fallback_allocations == 64);
+}
+
+TEST_CASE("thread_pool_slab_worker_heaps", "allocator") {
+  auto threadPool = enzen::static_thread_pool{2};
+  auto exec = enzen::require(threadPool.executor(), enzen::blocking.never);
+
+  auto sum = std::atomic<int>{0};
+  auto payload = std::array<int, 32>{};
+  payload[0] = 1;
+
+  // Closures submitted by tasks running on a worker are allocated from the
+  // heap of that worker.
+  for (int i = 0; i < 8; ++i) {
+    exec.execute([&sum, exec, payload]() mutable {
+      for (int j = 0; j < 100; ++j) {
+        exec.execute([&sum, payload]() { sum += payload[0]; });
+      }
+    });
+  }
+  threadPool.wait();
+
+  REQUIRE(sum == 800);
+
+  auto stats = threadPool.stats();
+  auto workerAllocations = std::uint64_t{0};
+  for (auto &worker : stats.workers) {
+    workerAllocations += worker.allocator.allocations;
+  }
+  REQUIRE(workerAllocations == 800);
+  REQUIRE(stats.allocator_totals().allocations == 808);
+}
+
+TEST_CASE("slab_allocator_remote_free", "allocator") {
+  auto slabs = enzen::detail::thread_pool_slab_allocator{1};
+
+  auto worker = std::thread{[&]() {
+    slabs.bind_worker(0);
+
+    auto blocks = std::vector<void *>{};
+    for (std::size_t size : {1, 64, 65, 200, 2048}) {
+      blocks.push_back(slabs.allocate(size));
+      REQUIRE(reinterpret_cast<std::uintptr_t>(blocks.back()) % 64 == 0);
+    }
+    auto unique = std::set<void *>(blocks.begin(), blocks.end());
+    REQUIRE(unique.size() == blocks.size());
+
+    // Blocks freed by their owner are reused straight away.
+    slabs.deallocate(blocks[3], 200);
+    REQUIRE(slabs.allocate(256) == blocks[3]);
+
+    // Allocations larger than the largest size class use operator new, with
+    // the alignment asked for.
+    auto large = slabs.allocate(4096, 64);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(large) % 64 == 0);
+    slabs.deallocate(large, 4096, 64);
+
+    // Blocks freed by another thread are reclaimed by the owner once its
+    // free list of that size class is empty.
+    auto remote = slabs.allocate(100);
+    std::thread{[&]() { slabs.deallocate(remote, 100); }}.join();
+    REQUIRE(slabs.allocate(100) == remote);
+  }};
+  worker.join();
+
+  auto stats = slabs.worker_stats(0);
+  REQUIRE(stats.allocations == 9);
+  REQUIRE(stats.fallback_allocations == 1);
+  REQUIRE(stats.local_frees == 1);
+  REQUIRE(stats.remote_frees == 1);
+  REQUIRE(stats.reclaim_batches == 1);
+  REQUIRE(stats.remote_free_rate() == 0.5);
+  REQUIRE(slabs.external_stats().allocations == 0);
+}
@@ -0,0 +1,192 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <execution>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("fused_bulk_order", "bulk") {
+  enzen::inline_context inlineContext{};
+
+  auto lazyExec =
+      enzen::require_concept(inlineContext.executor(), enzen::lazy);
+
+  constexpr std::size_t size = 3 * 4096;
+  auto events = std::vector<std::size_t>{};
+
+  // Pointwise stages are fused, so the second stage runs over the first
+  // block before the first stage reaches the last block.
+  auto s1 = enzen::via(lazyExec, enzen::just(1)) |
+            enzen::bulk(enzen::shape{size},
+                        [&](enzen::index<1> idx, int) {
+                          events.push_back(idx[0]);
+                        }) |
+            enzen::bulk(enzen::shape{size}, [&](enzen::index<1> idx, int) {
+              events.push_back(size + idx[0]);
+            });
+
+  REQUIRE(enzen::sync_get(s1) == 1);
+  REQUIRE(events.size() == 2 * size);
+  REQUIRE(events[4096] == size);
+  REQUIRE(events[2 * 4096] == 4096);
+  REQUIRE(events.back() == 2 * size - 1);
+}
+
+TEST_CASE("non_pointwise_bulk_order", "bulk") {
+  enzen::inline_context inlineContext{};
+
+  auto lazyExec =
+      enzen::require_concept(inlineContext.executor(), enzen::lazy);
+
+  constexpr std::size_t size = 3 * 4096;
+  auto events = std::vector<std::size_t>{};
+
+  // A non-pointwise stage only starts once the first stage is complete.
+  auto s1 = enzen::bulk(enzen::via(lazyExec, enzen::just(1)),
+                        enzen::shape{size}, [&](enzen::index<1> idx, int) {
+                          events.push_back(idx[0]);
+                        });
+  auto s2 = enzen::bulk(s1, enzen::shape{size},
+                        enzen::non_pointwise([&](enzen::index<1> idx, int) {
+                          events.push_back(size + idx[0]);
+                        }));
+
+  REQUIRE(enzen::sync_get(s2) == 1);
+  REQUIRE(events.size() == 2 * size);
+  for (std::size_t i = 0; i < events.size(); ++i) {
+    REQUIRE(events[i] == i);
+  }
+}
+
+TEST_CASE("fused_bulk_thread_pool", "bulk") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require_concept(threadPool.executor(), enzen::lazy);
+
+  constexpr std::size_t size = 100000;
+  auto a = std::vector<int>(size);
+  auto b = std::vector<int>(size);
+  auto c = std::vector<int>(size);
+
+  // saxpy-like stages where each reads only what the previous one wrote at
+  // the same index, then a stencil which reads its neighbours.
+  auto s1 =
+      enzen::via(lazyExec, enzen::just(3)) |
+      enzen::bulk(enzen::shape{size},
+                  [&](enzen::index<1> idx, int value) {
+                    a[idx[0]] = static_cast<int>(idx[0]) * value;
+                  }) |
+      enzen::bulk(enzen::shape{size},
+                  [&](enzen::index<1> idx, int) {
+                    b[idx[0]] = a[idx[0]] + 1;
+                  }) |
+      enzen::bulk(enzen::shape{size},
+                  enzen::non_pointwise([&](enzen::index<1> idx, int) {
+                    auto i = idx[0];
+                    c[i] = (i > 0 ? b[i - 1] : 0) +
+                           (i + 1 < size ? b[i + 1] : 0);
+                  }));
+
+  REQUIRE(enzen::sync_get(s1) == 3);
+  for (std::size_t i = 0; i < size; ++i) {
+    auto expected = (i > 0 ? static_cast<int>(i - 1) * 3 + 1 : 0) +
+                    (i + 1 < size ? static_cast<int>(i + 1) * 3 + 1 : 0);
+    REQUIRE(c[i] == expected);
+  }
+}
+
+TEST_CASE("fused_bulk_tiles", "bulk") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require_concept(
+      enzen::require(threadPool.executor(), enzen::mapping.tiled(4, 8)),
+      enzen::lazy);
+
+  auto visited = std::vector<int>(30 * 50);
+  auto workers = std::vector<std::thread::id>(30 * 50);
+  auto moved = std::atomic<int>{0};
+
+  // The stages of a tile run on the same worker.
+  auto s1 = enzen::via(lazyExec, enzen::just(2)) |
+            enzen::bulk(enzen::shape{30, 50},
+                        [&](enzen::index<2> idx, int value) {
+                          visited[idx.linear_id()] += value;
+                          workers[idx.linear_id()] =
+                              std::this_thread::get_id();
+                        }) |
+            enzen::bulk(enzen::shape{30, 50}, [&](enzen::index<2> idx, int) {
+              if (workers[idx.linear_id()] != std::this_thread::get_id()) {
+                moved++;
+              }
+              visited[idx.linear_id()] *= 5;
+            });
+
+  REQUIRE(enzen::sync_get(s1) == 2);
+  REQUIRE(moved == 0);
+  for (auto count : visited) {
+    REQUIRE(count == 10);
+  }
+}
+
+TEST_CASE("bulk_shape_mismatch", "bulk") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require_concept(threadPool.executor(), enzen::lazy);
+
+  auto visited = std::vector<int>(20);
+
+  // Stages over different shapes are run one after the other.
+  auto s1 = enzen::via(lazyExec, enzen::just(1)) |
+            enzen::bulk(enzen::shape{10},
+                        [&](enzen::index<1> idx, int) {
+                          visited[2 * idx[0]] += 1;
+                          visited[2 * idx[0] + 1] += 1;
+                        }) |
+            enzen::bulk(enzen::shape{20}, [&](enzen::index<1> idx, int) {
+              visited[idx[0]] *= 3;
+            });
+
+  REQUIRE(enzen::sync_get(s1) == 1);
+  for (auto count : visited) {
+    REQUIRE(count == 3);
+  }
+}
+
+TEST_CASE("fused_bulk_error", "bulk") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require_concept(threadPool.executor(), enzen::lazy);
+
+  auto s1 = enzen::via(lazyExec, enzen::just(1)) |
+            enzen::bulk(enzen::shape{1000}, [](enzen::index<1>, int) {}) |
+            enzen::bulk(enzen::shape{1000}, [](enzen::index<1> idx, int) {
+              if (idx[0] == 500) {
+                throw std::runtime_error("stage failed");
+              }
+            });
+
+  REQUIRE_THROWS_AS(enzen::sync_wait(s1), std::runtime_error);
+}
@@ -0,0 +1,201 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <atomic>
+#include <execution>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class value_receiver {
+ public:
+  value_receiver(std::atomic<int> *result) : result_{result} {}
+
+  void value(int value) { *result_ = value; }
+
+  void done() {}
+
+  void error(std::exception_ptr) noexcept {}
+
+ private:
+  std::atomic<int> *result_;
+};
+
+}  // namespace
+
+TEST_CASE("require_bulk_guarantee", "bulk_guarantee") {
+  enzen::inline_context inlineContext{};
+
+  auto exec = inlineContext.executor();
+  REQUIRE(enzen::query(exec, enzen::bulk_guarantee) ==
+          enzen::bulk_guarantee.parallel);
+
+  auto unseqExec = enzen::require(exec, enzen::bulk_guarantee.unsequenced);
+  REQUIRE(enzen::query(unseqExec, enzen::bulk_guarantee) ==
+          enzen::bulk_guarantee.unsequenced);
+
+  // The guarantee is kept when requiring other properties.
+  auto bulkExec = enzen::require(
+      enzen::require_concept(unseqExec, enzen::bulk_oneway),
+      enzen::mapping.tiled(4));
+  REQUIRE(enzen::query(bulkExec, enzen::bulk_guarantee) ==
+          enzen::bulk_guarantee.unsequenced);
+  REQUIRE(enzen::query(bulkExec, enzen::mapping) == enzen::mapping.tiled(4));
+
+  auto seqExec = enzen::require(bulkExec, enzen::bulk_guarantee.sequenced);
+  REQUIRE(enzen::query(seqExec, enzen::bulk_guarantee) ==
+          enzen::bulk_guarantee.sequenced);
+}
+
+TEST_CASE("unsequenced_inline", "bulk_guarantee") {
+  enzen::inline_context inlineContext{};
+
+  auto bulkExec = enzen::require(
+      enzen::require_concept(inlineContext.executor(), enzen::bulk_oneway),
+      enzen::bulk_guarantee.unsequenced);
+
+  int res[6][5] = {};
+
+  bulkExec.bulk_execute(
+      [&res](enzen::index<2> idx) {
+        res[idx[0]][idx[1]] = static_cast<int>(idx.linear_id());
+      },
+      enzen::shape{6, 5});
+
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      REQUIRE(res[i][j] == i * 5 + j);
+    }
+  }
+}
+
+TEST_CASE("unsequenced_thread_pool", "bulk_guarantee") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto bulkExec = enzen::require(
+      enzen::require(
+          enzen::require_concept(threadPool.executor(), enzen::bulk_oneway),
+          enzen::bulk_guarantee.unsequenced),
+      enzen::blocking.always);
+
+  auto res = std::vector<float>(10007, 1.0f);
+
+  bulkExec.bulk_execute(
+      [ptr = res.data()](enzen::index<1> idx) { ptr[idx[0]] += idx[0]; },
+      enzen::shape{res.size()});
+
+  for (std::size_t i = 0; i < res.size(); ++i) {
+    REQUIRE(res[i] == 1.0f + i);
+  }
+}
+
+TEST_CASE("sequenced_thread_pool", "bulk_guarantee") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto bulkExec = enzen::require(
+      enzen::require(
+          enzen::require_concept(threadPool.executor(), enzen::bulk_oneway),
+          enzen::bulk_guarantee.sequenced),
+      enzen::blocking.always);
+
+  auto order = std::vector<std::size_t>{};
+  auto threads = std::vector<std::thread::id>{};
+  auto record = [&](enzen::index<2> idx) {
+    order.push_back(idx.linear_id());
+    threads.push_back(std::this_thread::get_id());
+  };
+
+  bulkExec.bulk_execute(record, enzen::shape{4, 4});
+
+  REQUIRE(order == std::vector<std::size_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                            11, 12, 13, 14, 15});
+  for (auto &thread : threads) {
+    REQUIRE(thread == threads.front());
+  }
+
+  order.clear();
+  threads.clear();
+  enzen::require(bulkExec, enzen::mapping.tiled(2))
+      .bulk_execute(record, enzen::shape{4, 4});
+
+  REQUIRE(order == std::vector<std::size_t>{0, 1, 4, 5, 2, 3, 6, 7, 8, 9, 12,
+                                            13, 10, 11, 14, 15});
+
+  for (auto &thread : threads) {
+    REQUIRE(thread == threads.front());
+  }
+}
+
+TEST_CASE("sequenced_bulk_sender", "bulk_guarantee") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require_concept(
+      enzen::require(threadPool.executor(), enzen::bulk_guarantee.sequenced),
+      enzen::lazy);
+
+  auto order = std::vector<std::size_t>{};
+
+  auto s1 = enzen::via(lazyExec, enzen::just(7));
+  auto s2 = enzen::bulk(s1, enzen::shape{100},
+                        [&order](enzen::index<1> idx, int) {
+                          order.push_back(idx.linear_id());
+                        });
+
+  auto result = std::atomic<int>{0};
+  enzen::submit(s2, value_receiver{&result});
+
+  threadPool.wait();
+
+  REQUIRE(order.size() == 100);
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    REQUIRE(order[i] == i);
+  }
+  REQUIRE(result == 7);
+}
+
+TEST_CASE("unsequenced_bulk_sender", "bulk_guarantee") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require_concept(
+      enzen::require(threadPool.executor(), enzen::bulk_guarantee.unsequenced),
+      enzen::lazy);
+
+  auto visited = std::vector<std::atomic<int>>(9 * 11);
+
+  auto s1 = enzen::via(lazyExec, enzen::just(2));
+  auto s2 = enzen::bulk(s1, enzen::shape{9, 11},
+                        [&visited](enzen::index<2> idx, int value) {
+                          visited[idx.linear_id()] += value;
+                        });
+
+  auto result = std::atomic<int>{0};
+  enzen::submit(s2, value_receiver{&result});
+
+  threadPool.wait();
+
+  for (auto &count : visited) {
+    REQUIRE(count == 2);
+  }
+  REQUIRE(result == 2);
+}
@@ -0,0 +1,148 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <execution>
+#include <thread>
+
+template <typename Executor>
+enzen::task<std::thread::id> resume_on_executor(Executor exec) {
+  co_await exec.schedule();
+  co_return std::this_thread::get_id();
+}
+
+template <typename Executor>
+enzen::task<int> await_pipeline(Executor exec) {
+  auto value = co_await enzen::transform(enzen::via(exec, enzen::just(21)),
+                                         [](int value) { return value * 2; });
+  co_return value;
+}
+
+template <typename Executor>
+enzen::task<int> await_pipeline_on_worker(Executor exec) {
+  co_await exec.schedule();
+  auto value = co_await enzen::transform(enzen::via(exec, enzen::just(21)),
+                                         [](int value) { return value * 2; });
+  co_return value;
+}
+
+enzen::task<int> count_down(int depth) {
+  if (depth == 0) {
+    co_return 0;
+  }
+  co_return 1 + co_await count_down(depth - 1);
+}
+
+template <typename Executor>
+enzen::task<int> await_future(Executor exec) {
+  co_return co_await exec.twoway_execute([]() { return 42; });
+}
+
+enzen::task<int> throw_error() {
+  throw std::runtime_error("error");
+  co_return 0;
+}
+
+enzen::task<int> catch_error() {
+  try {
+    co_await throw_error();
+  } catch (std::runtime_error &) {
+    co_return 42;
+  }
+  co_return 0;
+}
+
+TEST_CASE("co_await_schedule", "coroutine") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require_concept(threadPool.executor(), enzen::lazy);
+
+  auto prom = enzen::promise<std::thread::id>{};
+  auto fut = prom.get_future();
+
+  enzen::submit(resume_on_executor(lazyExec), prom);
+
+  REQUIRE(fut.get() != std::this_thread::get_id());
+}
+
+TEST_CASE("co_await_sender", "coroutine") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require(
+      enzen::require_concept(threadPool.executor(), enzen::lazy),
+      enzen::blocking.never);
+
+  auto prom = enzen::promise<int>{};
+  auto fut = prom.get_future();
+
+  enzen::submit(await_pipeline(lazyExec), prom);
+
+  REQUIRE(fut.get() == 42);
+}
+
+TEST_CASE("co_await_sender_on_worker", "coroutine") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  // The executor is possibly blocking, but the sender is awaited from a pool
+  // worker, so it must not be submitted in a way which waits on the pool.
+  auto lazyExec = enzen::require_concept(threadPool.executor(), enzen::lazy);
+
+  auto prom = enzen::promise<int>{};
+  auto fut = prom.get_future();
+
+  enzen::submit(await_pipeline_on_worker(lazyExec), prom);
+
+  REQUIRE(fut.get() == 42);
+}
+
+TEST_CASE("co_await_task_chain", "coroutine") {
+  auto prom = enzen::promise<int>{};
+  auto fut = prom.get_future();
+
+  enzen::submit(count_down(10000), prom);
+
+  REQUIRE(fut.get() == 10000);
+}
+
+TEST_CASE("co_await_future", "coroutine") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto twowayExec =
+      enzen::require_concept(threadPool.executor(), enzen::twoway);
+
+  auto prom = enzen::promise<int>{};
+  auto fut = prom.get_future();
+
+  enzen::submit(await_future(twowayExec), prom);
+
+  REQUIRE(fut.get() == 42);
+}
+
+TEST_CASE("co_await_exception", "coroutine") {
+  auto prom = enzen::promise<int>{};
+  auto fut = prom.get_future();
+
+  enzen::submit(catch_error(), prom);
+
+  REQUIRE(fut.get() == 42);
+}
@@ -0,0 +1,247 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class value_receiver {
+ public:
+  value_receiver(std::atomic<int> *result) : result_{result} {}
+
+  void value(int value) { *result_ = value; }
+
+  void done() {}
+
+  void error(std::exception_ptr) noexcept {}
+
+ private:
+  std::atomic<int> *result_;
+};
+
+}  // namespace
+
+TEST_CASE("group_ranges", "group") {
+  enzen::inline_context inlineContext{};
+
+  auto bulkExec =
+      enzen::require_concept(inlineContext.executor(), enzen::bulk_oneway);
+
+  auto visited = std::vector<int>(10 * 7);
+  auto groups = std::vector<std::size_t>{};
+
+  bulkExec.bulk_execute(
+      enzen::group_kernel(
+          enzen::shape{4, 4},
+          [&](const enzen::group<2> &g) {
+            groups.push_back(g.group_id().linear_id());
+            REQUIRE(g.group_range()[0] == 3);
+            REQUIRE(g.group_range()[1] == 2);
+            REQUIRE(g.global_range().size() == 70);
+
+            // Groups at the edges are clipped to the global range.
+            auto local = g.local_range();
+            REQUIRE(local[0] == (g.group_id()[0] == 2 ? 2 : 4));
+            REQUIRE(local[1] == (g.group_id()[1] == 1 ? 3 : 4));
+
+            g.for_each_item(
+                [&](enzen::index<2> localIdx, enzen::index<2> globalIdx) {
+                  REQUIRE(globalIdx[0] == g.group_id()[0] * 4 + localIdx[0]);
+                  REQUIRE(globalIdx[1] == g.group_id()[1] * 4 + localIdx[1]);
+                  REQUIRE(globalIdx.linear_id() ==
+                          globalIdx[0] * 7 + globalIdx[1]);
+                  visited[globalIdx.linear_id()]++;
+                });
+          }),
+      enzen::shape{10, 7});
+
+  REQUIRE(groups == std::vector<std::size_t>{0, 1, 2, 3, 4, 5});
+  for (auto count : visited) {
+    REQUIRE(count == 1);
+  }
+}
+
+TEST_CASE("group_scratch_transpose", "group") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto bulkExec = enzen::require_concept(
+      enzen::require(threadPool.executor(), enzen::blocking.always),
+      enzen::bulk_oneway);
+
+  constexpr std::size_t rows = 45, cols = 70, tile = 8;
+  auto in = std::vector<int>(rows * cols);
+  auto out = std::vector<int>(rows * cols);
+  for (std::size_t i = 0; i < in.size(); ++i) {
+    in[i] = static_cast<int>(i);
+  }
+
+  // Each group loads its tile into scratch memory, then writes it out
+  // transposed after the barrier.
+  bulkExec.bulk_execute(
+      enzen::group_kernel(
+          enzen::shape{tile, tile}, tile * tile * sizeof(int),
+          [&](const enzen::group<2> &g) {
+            auto *scratch = g.scratch<int>();
+            g.for_each_item(
+                [&](enzen::index<2> localIdx, enzen::index<2> globalIdx) {
+                  scratch[localIdx[0] * tile + localIdx[1]] =
+                      in[globalIdx.linear_id()];
+                });
+            enzen::group_barrier(g);
+            g.for_each_item(
+                [&](enzen::index<2> localIdx, enzen::index<2> globalIdx) {
+                  out[globalIdx[1] * rows + globalIdx[0]] =
+                      scratch[localIdx[0] * tile + localIdx[1]];
+                });
+          }),
+      enzen::shape{rows, cols});
+
+  for (std::size_t i = 0; i < rows; ++i) {
+    for (std::size_t j = 0; j < cols; ++j) {
+      REQUIRE(out[j * rows + i] == in[i * cols + j]);
+    }
+  }
+}
+
+TEST_CASE("group_scratch_reuse", "group") {
+  auto numThreads = std::size_t{4};
+  auto threadPool = enzen::static_thread_pool{numThreads};
+
+  auto bulkExec = enzen::require_concept(
+      enzen::require(threadPool.executor(), enzen::blocking.always),
+      enzen::bulk_oneway);
+
+  auto mutex = std::mutex{};
+  auto scratch = std::set<std::byte *>{};
+
+  // The scratch memory is allocated once per worker, so however many groups
+  // and launches there are, at most one buffer is used per worker.
+  for (int launch = 0; launch < 8; ++launch) {
+    bulkExec.bulk_execute(
+        enzen::group_kernel(enzen::shape{16}, 256,
+                            [&](const enzen::group<1> &g) {
+                              auto lock = std::lock_guard<std::mutex>{mutex};
+                              scratch.insert(g.scratch<std::byte>());
+                            }),
+        enzen::shape{1024});
+  }
+
+  REQUIRE(scratch.size() <= numThreads);
+  for (auto *memory : scratch) {
+    REQUIRE(reinterpret_cast<std::uintptr_t>(memory) % 64 == 0);
+  }
+}
+
+TEST_CASE("group_nested_scratch", "group") {
+  enzen::inline_context inlineContext{};
+
+  auto bulkExec =
+      enzen::require_concept(inlineContext.executor(), enzen::bulk_oneway);
+
+  // A grouped bulk operation run from within a group has its own scratch
+  // memory, so it does not overwrite that of the outer group.
+  bulkExec.bulk_execute(
+      enzen::group_kernel(
+          enzen::shape{1}, sizeof(int), [&](const enzen::group<1> &outer) {
+            REQUIRE(outer.scratch_size() == sizeof(int));
+            *outer.scratch<int>() = 42;
+            bulkExec.bulk_execute(
+                enzen::group_kernel(enzen::shape{1}, sizeof(int),
+                                    [&](const enzen::group<1> &inner) {
+                                      REQUIRE(inner.scratch<int>() !=
+                                              outer.scratch<int>());
+                                      *inner.scratch<int>() = 7;
+                                    }),
+                enzen::shape{4});
+            REQUIRE(*outer.scratch<int>() == 42);
+          }),
+      enzen::shape{2});
+}
+
+TEST_CASE("group_bulk_sender", "group") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require_concept(threadPool.executor(), enzen::lazy);
+
+  constexpr std::size_t size = 1000, groupSize = 64;
+  auto sums = std::vector<std::atomic<int>>((size + groupSize - 1) / groupSize);
+
+  // Each group reduces its indices in scratch memory and writes one sum.
+  auto s1 = enzen::via(lazyExec, enzen::just(2));
+  auto s2 = enzen::bulk(
+      s1, enzen::shape{size},
+      enzen::group_kernel(
+          enzen::shape{groupSize}, groupSize * sizeof(int),
+          [&sums](const enzen::group<1> &g, int value) {
+            auto *partial = g.scratch<int>();
+            g.for_each_item([&](enzen::index<1> localIdx, enzen::index<1>) {
+              partial[localIdx[0]] = value;
+            });
+            enzen::group_barrier(g);
+            auto sum = 0;
+            for (std::size_t i = 0; i < g.local_range().size(); ++i) {
+              sum += partial[i];
+            }
+            sums[g.group_id().linear_id()] += sum;
+          }));
+
+  auto result = std::atomic<int>{0};
+  enzen::submit(s2, value_receiver{&result});
+
+  threadPool.wait();
+
+  REQUIRE(result == 2);
+  auto total = 0;
+  for (auto &sum : sums) {
+    total += sum;
+  }
+  REQUIRE(total == 2 * static_cast<int>(size));
+  REQUIRE(sums.back() == 2 * static_cast<int>(size % groupSize));
+}
+
+TEST_CASE("sequenced_groups", "group") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto bulkExec = enzen::require(
+      enzen::require_concept(
+          enzen::require(threadPool.executor(), enzen::blocking.always),
+          enzen::bulk_oneway),
+      enzen::bulk_guarantee.sequenced);
+
+  auto order = std::vector<std::size_t>{};
+
+  bulkExec.bulk_execute(
+      enzen::group_kernel(enzen::shape{3, 3},
+                          [&order](const enzen::group<2> &g) {
+                            order.push_back(g.group_id().linear_id());
+                          }),
+      enzen::shape{9, 9});
+
+  REQUIRE(order == std::vector<std::size_t>{0, 1, 2, 3, 4, 5, 6, 7, 8});
+}
@@ -0,0 +1,125 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <execution>
+#include <vector>
+
+TEST_CASE("shape_rank", "index") {
+  auto s1 = enzen::shape{8};
+  auto s2 = enzen::shape{8, 4};
+  auto s3 = enzen::shape{8, 4, 2};
+
+  static_assert(std::is_same_v<decltype(s1), enzen::shape<1>>);
+  static_assert(std::is_same_v<decltype(s2), enzen::shape<2>>);
+  static_assert(std::is_same_v<decltype(s3), enzen::shape<3>>);
+
+  REQUIRE(s1.rank() == 1);
+  REQUIRE(s3.rank() == 3);
+  REQUIRE(s2[0] == 8);
+  REQUIRE(s2[1] == 4);
+  REQUIRE(s1.size() == 8);
+  REQUIRE(s2.size() == 32);
+  REQUIRE(s3.size() == 64);
+}
+
+TEST_CASE("index_is_compact", "index") {
+  static_assert(sizeof(enzen::index<1>) == sizeof(std::size_t));
+  static_assert(sizeof(enzen::index<2>) == 3 * sizeof(std::size_t));
+  static_assert(sizeof(enzen::index<3>) == 4 * sizeof(std::size_t));
+}
+
+TEST_CASE("index_from_linear_id", "index") {
+  auto s = enzen::shape{3, 4, 5};
+
+  auto idx = enzen::index<3>{s, 2 * 20 + 3 * 5 + 4};
+
+  REQUIRE(idx[0] == 2);
+  REQUIRE(idx[1] == 3);
+  REQUIRE(idx[2] == 4);
+  REQUIRE(idx.linear_id() == 59);
+}
+
+TEST_CASE("for_each_index", "index") {
+  auto s = enzen::shape{3, 4};
+
+  auto visited = std::vector<std::size_t>{};
+  enzen::detail::for_each_index(s, [&](enzen::index<2> idx) {
+    REQUIRE(idx.linear_id() == idx[0] * 4 + idx[1]);
+    visited.push_back(idx.linear_id());
+  });
+
+  REQUIRE(visited.size() == 12);
+  for (std::size_t i = 0; i < visited.size(); ++i) {
+    REQUIRE(visited[i] == i);
+  }
+}
+
+TEST_CASE("for_each_index_range", "index") {
+  auto s = enzen::shape{3, 4, 5};
+
+  auto visited = std::vector<std::size_t>{};
+  enzen::detail::for_each_index(s, 7, 43, [&](enzen::index<3> idx) {
+    REQUIRE(idx.linear_id() == (idx[0] * 4 + idx[1]) * 5 + idx[2]);
+    visited.push_back(idx.linear_id());
+  });
+
+  REQUIRE(visited.size() == 36);
+  for (std::size_t i = 0; i < visited.size(); ++i) {
+    REQUIRE(visited[i] == i + 7);
+  }
+}
+
+TEST_CASE("for_each_range", "index") {
+  auto s = enzen::shape{3, 4, 5};
+
+  auto ranges = std::vector<enzen::index_range<3>>{};
+  enzen::detail::for_each_range(
+      s, 7, 43, [&](enzen::index_range<3> range) { ranges.push_back(range); });
+
+  // 7..9 completes the second row, then six whole rows, then 40..42.
+  REQUIRE(ranges.size() == 8);
+  REQUIRE(ranges.front()[0] == 0);
+  REQUIRE(ranges.front()[1] == 1);
+  REQUIRE(ranges.front().begin() == 2);
+  REQUIRE(ranges.front().end() == 5);
+  REQUIRE(ranges.back()[0] == 2);
+  REQUIRE(ranges.back()[1] == 0);
+  REQUIRE(ranges.back().begin() == 0);
+  REQUIRE(ranges.back().end() == 3);
+
+  auto next = std::size_t{7};
+  for (auto &range : ranges) {
+    REQUIRE(range.linear_begin() == next);
+    REQUIRE(range.linear_begin() ==
+            (range[0] * 4 + range[1]) * 5 + range.begin());
+    next += range.size();
+  }
+  REQUIRE(next == 43);
+}
+
+TEST_CASE("for_each_range_1d", "index") {
+  auto ranges = std::vector<enzen::index_range<1>>{};
+  enzen::detail::for_each_range(
+      enzen::shape{100},
+      [&](enzen::index_range<1> range) { ranges.push_back(range); });
+
+  REQUIRE(ranges.size() == 1);
+  REQUIRE(ranges[0].begin() == 0);
+  REQUIRE(ranges[0].end() == 100);
+}
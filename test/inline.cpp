@@ -0,0 +1,177 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <execution>
+#include <thread>
+
+template <typename ValueType>
+class value_receiver {
+ public:
+  value_receiver(ValueType *valuePtr) : valuePtr_{valuePtr} {};
+
+  void value(ValueType value) { *valuePtr_ = value; }
+
+  template <typename Error>
+  void error(Error &&error) noexcept {}
+
+  void done() {}
+
+ private:
+  ValueType *valuePtr_;
+};
+
+TEST_CASE("oneway_execute", "inline") {
+  enzen::inline_context inlineContext{};
+
+  auto exec = inlineContext.executor();
+
+  auto callingThread = std::this_thread::get_id();
+
+  int res = -1;
+
+  exec.execute([&]() {
+    REQUIRE(std::this_thread::get_id() == callingThread);
+    res = 1234;
+  });
+
+  REQUIRE(res == 1234);
+}
+
+TEST_CASE("blocking_query", "inline") {
+  enzen::inline_context inlineContext{};
+
+  auto exec = inlineContext.executor();
+
+  // Functions always run in place, whatever blocking semantics are required.
+  auto neverBlockingExec = enzen::require(exec, enzen::blocking.never);
+  auto possiblyBlockingExec = enzen::require(exec, enzen::blocking.possibly);
+
+  REQUIRE(exec.query(enzen::blocking) == enzen::blocking.always);
+  REQUIRE(neverBlockingExec.query(enzen::blocking) == enzen::blocking.always);
+  REQUIRE(possiblyBlockingExec.query(enzen::blocking) ==
+          enzen::blocking.always);
+
+  int res = -1;
+  neverBlockingExec.execute([&]() { res = 1234; });
+  REQUIRE(res == 1234);
+}
+
+TEST_CASE("bulk_oneway_execute", "inline") {
+  enzen::inline_context inlineContext{};
+
+  auto bulkOnewayExec =
+      enzen::require_concept(inlineContext.executor(), enzen::bulk_oneway);
+
+  int res[32] = {-1};
+
+  bulkOnewayExec.bulk_execute(
+      [&res](enzen::index<3> idx) { res[idx[0]] = static_cast<int>(idx[0]); },
+      enzen::shape{32, 1, 1});
+
+  for (int i = 0; i < 32; ++i) {
+    REQUIRE(res[i] == i);
+  }
+}
+
+TEST_CASE("bulk_oneway_execute_2d", "inline") {
+  enzen::inline_context inlineContext{};
+
+  auto bulkOnewayExec =
+      enzen::require_concept(inlineContext.executor(), enzen::bulk_oneway);
+
+  int res[8][4] = {};
+
+  bulkOnewayExec.bulk_execute(
+      [&res](enzen::index<2> idx) {
+        res[idx[0]][idx[1]] = static_cast<int>(idx.linear_id());
+      },
+      enzen::shape{8, 4});
+
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      REQUIRE(res[i][j] == i * 4 + j);
+    }
+  }
+}
+
+TEST_CASE("bulk_oneway_execute_range", "inline") {
+  enzen::inline_context inlineContext{};
+
+  auto bulkOnewayExec =
+      enzen::require_concept(inlineContext.executor(), enzen::bulk_oneway);
+
+  int res[8][4] = {};
+  int numRanges = 0;
+
+  bulkOnewayExec.bulk_execute(
+      enzen::range_kernel([&](enzen::index_range<2> range) {
+        ++numRanges;
+        for (auto j = range.begin(); j < range.end(); ++j) {
+          res[range[0]][j] = static_cast<int>(range[0] * 4 + j);
+        }
+      }),
+      enzen::shape{8, 4});
+
+  REQUIRE(numRanges == 8);
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      REQUIRE(res[i][j] == i * 4 + j);
+    }
+  }
+}
+
+TEST_CASE("twoway_execute", "inline") {
+  enzen::inline_context inlineContext{};
+
+  auto twowayExec =
+      enzen::require_concept(inlineContext.executor(), enzen::twoway);
+
+  auto fut = twowayExec.twoway_execute([]() { return 1234; });
+
+  REQUIRE(fut.get() == 1234);
+}
+
+TEST_CASE("via_and_transform", "inline") {
+  enzen::inline_context inlineContext{};
+
+  auto lazyExec =
+      enzen::require_concept(inlineContext.executor(), enzen::lazy);
+
+  auto s1 = enzen::via(lazyExec, enzen::just(21));
+
+  auto s2 = enzen::transform(s1, [=](int value) { return value * 2; });
+
+  int res = 0;
+  submit(s2, value_receiver{&res});
+
+  REQUIRE(res == 42);
+}
+
+TEST_CASE("sync_get", "inline") {
+  enzen::inline_context inlineContext{};
+
+  auto lazyExec =
+      enzen::require_concept(inlineContext.executor(), enzen::lazy);
+
+  auto s1 = enzen::via(lazyExec, enzen::just(21));
+
+  auto s2 = enzen::transform(s1, [=](int value) { return value * 2; });
+
+  REQUIRE(enzen::sync_get(s2) == 42);
+}
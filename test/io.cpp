@@ -0,0 +1,273 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <execution>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::vector<enzen::io_reactor_type> available_reactors() {
+  auto reactors = std::vector<enzen::io_reactor_type>{
+      enzen::io_reactor_type::epoll};
+  try {
+    enzen::io_context ioContext{enzen::io_reactor_type::io_uring};
+    reactors.push_back(enzen::io_reactor_type::io_uring);
+  } catch (std::system_error &) {
+  }
+  return reactors;
+}
+
+}  // namespace
+
+TEST_CASE("execute", "io") {
+  for (auto reactorType : available_reactors()) {
+    enzen::io_context ioContext{reactorType};
+
+    REQUIRE(ioContext.reactor_type() == reactorType);
+
+    auto exec = enzen::require(ioContext.executor(), enzen::blocking.always);
+
+    auto callingThread = std::this_thread::get_id();
+    auto reactorThread = std::thread::id{};
+
+    exec.execute([&]() { reactorThread = std::this_thread::get_id(); });
+
+    REQUIRE(reactorThread != std::thread::id{});
+    REQUIRE(reactorThread != callingThread);
+  }
+}
+
+TEST_CASE("execute_burst", "io") {
+  for (auto reactorType : available_reactors()) {
+    enzen::io_context ioContext{reactorType};
+
+    auto exec = enzen::require(ioContext.executor(), enzen::blocking.never);
+
+    // Far more tasks than there are submission queue entries are enqueued
+    // from several threads before the reactor can drain them.
+    auto count = std::atomic<int>{0};
+    auto producers = std::vector<std::thread>{};
+    for (int t = 0; t < 4; ++t) {
+      producers.emplace_back([&]() {
+        for (int i = 0; i < 2000; ++i) {
+          exec.execute([&]() { count++; });
+        }
+      });
+    }
+    for (auto &producer : producers) {
+      producer.join();
+    }
+
+    enzen::require(ioContext.executor(), enzen::blocking.always)
+        .execute([]() {});
+    REQUIRE(count == 8000);
+  }
+}
+
+TEST_CASE("pipe_read_write", "io") {
+  for (auto reactorType : available_reactors()) {
+    enzen::io_context ioContext{reactorType};
+
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+
+    char in[6] = {};
+    auto readTask = enzen::transform(
+        enzen::async_read(ioContext.executor(), fds[0], in, 5),
+        [&](std::size_t bytes) { return std::string(in, bytes); });
+
+    const char out[] = "hello";
+    auto writeTask = enzen::async_write(ioContext.executor(), fds[1], out, 5);
+
+    auto reader =
+        std::thread{[&]() { REQUIRE(enzen::sync_get(readTask) == "hello"); }};
+    REQUIRE(enzen::sync_get(writeTask) == 5);
+    reader.join();
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+}
+
+TEST_CASE("file_read_write", "io") {
+  for (auto reactorType : available_reactors()) {
+    enzen::io_context ioContext{reactorType};
+
+    char path[] = "/tmp/enzen_io_XXXXXX";
+    auto fd = ::mkstemp(path);
+    REQUIRE(fd >= 0);
+    ::unlink(path);
+
+    const char out[] = "0123456789";
+    REQUIRE(enzen::sync_get(enzen::async_write(ioContext.executor(), fd, out,
+                                               10, 0)) == 10);
+
+    char in[4] = {};
+    REQUIRE(enzen::sync_get(enzen::async_read(ioContext.executor(), fd, in, 4,
+                                              6)) == 4);
+    REQUIRE(std::string(in, 4) == "6789");
+
+    ::close(fd);
+  }
+}
+
+TEST_CASE("read_error", "io") {
+  for (auto reactorType : available_reactors()) {
+    enzen::io_context ioContext{reactorType};
+
+    char in[4];
+    REQUIRE_THROWS_AS(
+        enzen::sync_get(enzen::async_read(ioContext.executor(), -1, in, 4)),
+        std::system_error);
+  }
+}
+
+TEST_CASE("loopback_accept", "io") {
+  for (auto reactorType : available_reactors()) {
+    enzen::io_context ioContext{reactorType};
+
+    auto listener = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(listener >= 0);
+
+    auto addr = sockaddr_in{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    REQUIRE(::bind(listener, reinterpret_cast<sockaddr *>(&addr),
+                   sizeof(addr)) == 0);
+    REQUIRE(::listen(listener, 1) == 0);
+    auto addrLen = socklen_t{sizeof(addr)};
+    REQUIRE(::getsockname(listener, reinterpret_cast<sockaddr *>(&addr),
+                          &addrLen) == 0);
+
+    auto client = std::thread{[addr]() {
+      auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      REQUIRE(::connect(fd, reinterpret_cast<const sockaddr *>(&addr),
+                        sizeof(addr)) == 0);
+      REQUIRE(::write(fd, "ping", 4) == 4);
+      ::close(fd);
+    }};
+
+    auto accepted = enzen::sync_get(
+        enzen::async_accept(ioContext.executor(), listener));
+    REQUIRE(accepted >= 0);
+
+    char in[4] = {};
+    REQUIRE(enzen::sync_get(enzen::async_read(ioContext.executor(), accepted,
+                                              in, 4)) == 4);
+    REQUIRE(std::string(in, 4) == "ping");
+
+    client.join();
+    ::close(accepted);
+    ::close(listener);
+  }
+}
+
+TEST_CASE("via_thread_pool", "io") {
+  for (auto reactorType : available_reactors()) {
+    enzen::io_context ioContext{reactorType};
+    enzen::static_thread_pool threadPool{2};
+
+    auto reactorThread = std::thread::id{};
+    enzen::require(ioContext.executor(), enzen::blocking.always)
+        .execute([&]() { reactorThread = std::this_thread::get_id(); });
+
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+    REQUIRE(::write(fds[1], "abc", 3) == 3);
+
+    char in[3] = {};
+    // The reactor thread must not wait on the pool, so the continuation is
+    // scheduled as never blocking.
+    auto poolExec = enzen::require(
+        enzen::require_concept(threadPool.executor(), enzen::lazy),
+        enzen::blocking.never);
+    auto s1 = enzen::via(
+        poolExec, enzen::async_read(ioContext.executor(), fds[0], in, 3));
+    auto transformThread = std::thread::id{};
+    auto s2 = enzen::transform(s1, [&](std::size_t bytes) {
+      transformThread = std::this_thread::get_id();
+      return bytes;
+    });
+
+    REQUIRE(enzen::sync_get(s2) == 3);
+    REQUIRE(transformThread != reactorThread);
+    REQUIRE(std::string(in, 3) == "abc");
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+}
+
+TEST_CASE("stop_cancels_pending", "io") {
+  for (auto reactorType : available_reactors()) {
+    enzen::io_context ioContext{reactorType};
+
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+
+    char in[1];
+    auto readTask = enzen::async_read(ioContext.executor(), fds[0], in, 1);
+    auto reader = std::thread{[&]() {
+      REQUIRE_THROWS_AS(enzen::sync_get(readTask), std::system_error);
+    }};
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ioContext.stop();
+    reader.join();
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+}
+
+TEST_CASE("submit_after_stop", "io") {
+  for (auto reactorType : available_reactors()) {
+    enzen::io_context ioContext{reactorType};
+    ioContext.stop();
+
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+
+    // The operation is completed as cancelled rather than left outstanding.
+    char in[1];
+    try {
+      enzen::sync_get(enzen::async_read(ioContext.executor(), fds[0], in, 1));
+      FAIL("read after stop completed");
+    } catch (std::system_error &e) {
+      REQUIRE(e.code() == std::errc::operation_canceled);
+    }
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+}
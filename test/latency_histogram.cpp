@@ -0,0 +1,103 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <execution>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+class sleep_kernel;
+class other_kernel;
+
+TEST_CASE("bucket_precision", "latency_histogram") {
+  using buckets = enzen::detail::latency_buckets;
+
+  for (std::uint64_t value :
+       {0ull, 1ull, 15ull, 16ull, 17ull, 100ull, 1000ull, 123456789ull,
+        ~0ull}) {
+    auto highest = buckets::highest_value_of(buckets::index_of(value));
+    REQUIRE(highest >= value);
+    REQUIRE(highest - value <= value / buckets::sub_bucket_count);
+  }
+
+  REQUIRE(buckets::index_of(~0ull) == buckets::bucket_count - 1);
+}
+
+TEST_CASE("percentiles", "latency_histogram") {
+  auto shard = enzen::detail::latency_histogram_shard{};
+  for (std::uint64_t i = 1; i <= 1000; ++i) {
+    shard.record(i * 1000);
+  }
+
+  auto counts = enzen::latency_histogram::counts_t(
+      enzen::detail::latency_buckets::bucket_count);
+  shard.merge_into(counts);
+  auto histogram = enzen::latency_histogram{counts};
+
+  REQUIRE(histogram.count() == 1000);
+
+  auto p50 = histogram.percentile(50).count();
+  REQUIRE(p50 >= 500000);
+  REQUIRE(p50 <= 500000 + 500000 / 16);
+
+  auto p99 = histogram.percentile(99).count();
+  REQUIRE(p99 >= 990000);
+  REQUIRE(p99 <= 990000 + 990000 / 16);
+
+  REQUIRE(histogram.max().count() >= 1000000);
+}
+
+TEST_CASE("thread_pool_kernel_names", "latency_histogram") {
+  {
+    enzen::static_thread_pool threadPool{2};
+
+    auto exec = enzen::require(threadPool.executor(), enzen::blocking.never);
+    auto sleepExec = enzen::require(exec, enzen::name<sleep_kernel>);
+    auto otherExec = enzen::require(exec, enzen::name<other_kernel>);
+
+    for (int i = 0; i < 8; ++i) {
+      sleepExec.execute(
+          []() { std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+    }
+    for (int i = 0; i < 4; ++i) {
+      otherExec.execute([]() {});
+    }
+    threadPool.wait();
+  }
+
+  auto sleepLatency = enzen::kernel_latency<sleep_kernel>();
+  REQUIRE(sleepLatency.kernel_name == "sleep_kernel");
+  REQUIRE(sleepLatency.queue_latency.count() == 8);
+  REQUIRE(sleepLatency.run_latency.count() == 8);
+  REQUIRE(sleepLatency.run_latency.percentile(50) >=
+          std::chrono::milliseconds(1));
+
+  auto otherLatency = enzen::kernel_latency<other_kernel>();
+  REQUIRE(otherLatency.run_latency.count() == 4);
+
+  auto names = std::vector<std::string>{};
+  for (auto &latency : enzen::kernel_latencies()) {
+    names.push_back(latency.kernel_name);
+  }
+  REQUIRE(std::find(names.begin(), names.end(), "sleep_kernel") !=
+          names.end());
+  REQUIRE(std::find(names.begin(), names.end(), "other_kernel") !=
+          names.end());
+}
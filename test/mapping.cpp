@@ -0,0 +1,240 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <atomic>
+#include <execution>
+#include <thread>
+#include <vector>
+
+namespace {
+
+template <std::size_t Rank>
+using visit_order = std::vector<std::array<std::size_t, Rank>>;
+
+template <std::size_t Rank, typename Executor>
+visit_order<Rank> inline_visit_order(Executor exec,
+                                     enzen::shape<Rank> iterationSpace) {
+  auto order = visit_order<Rank>{};
+  enzen::require_concept(exec, enzen::bulk_oneway)
+      .bulk_execute(
+          [&](enzen::index<Rank> idx) {
+            auto position = std::array<std::size_t, Rank>{};
+            auto linearId = std::size_t{0};
+            for (std::size_t dim = 0; dim < Rank; ++dim) {
+              position[dim] = idx[dim];
+              linearId = linearId * iterationSpace[dim] + idx[dim];
+            }
+            REQUIRE(idx.linear_id() == linearId);
+            order.push_back(position);
+          },
+          iterationSpace);
+  return order;
+}
+
+class value_receiver {
+ public:
+  value_receiver(std::atomic<int> *result) : result_{result} {}
+
+  void value(int value) { *result_ = value; }
+
+  void done() {}
+
+  void error(std::exception_ptr) noexcept {}
+
+ private:
+  std::atomic<int> *result_;
+};
+
+}  // namespace
+
+TEST_CASE("require_mapping", "mapping") {
+  enzen::inline_context inlineContext{};
+
+  auto exec = inlineContext.executor();
+  REQUIRE(enzen::query(exec, enzen::mapping) == enzen::mapping.row_major);
+
+  auto tiledExec = enzen::require(exec, enzen::mapping.tiled(4, 2));
+  REQUIRE(enzen::query(tiledExec, enzen::mapping) ==
+          enzen::mapping.tiled(4, 2));
+  REQUIRE(enzen::query(tiledExec, enzen::mapping) !=
+          enzen::mapping.tiled(4, 4));
+  REQUIRE(enzen::query(tiledExec, enzen::mapping).tile_extent(2) == 2);
+
+  // The mapping is kept when requiring other properties.
+  auto bulkExec = enzen::require(
+      enzen::require_concept(tiledExec, enzen::bulk_oneway),
+      enzen::blocking.always);
+  REQUIRE(enzen::query(bulkExec, enzen::mapping) ==
+          enzen::mapping.tiled(4, 2));
+
+  auto mortonExec = enzen::require(bulkExec, enzen::mapping.morton);
+  REQUIRE(enzen::query(mortonExec, enzen::mapping) == enzen::mapping.morton);
+}
+
+TEST_CASE("row_major", "mapping") {
+  enzen::inline_context inlineContext{};
+
+  auto order = inline_visit_order(inlineContext.executor(),
+                                  enzen::shape{2, 3});
+
+  REQUIRE(order == visit_order<2>{{0, 0}, {0, 1}, {0, 2},
+                                  {1, 0}, {1, 1}, {1, 2}});
+}
+
+TEST_CASE("column_major", "mapping") {
+  enzen::inline_context inlineContext{};
+
+  auto order = inline_visit_order(
+      enzen::require(inlineContext.executor(), enzen::mapping.column_major),
+      enzen::shape{2, 3});
+
+  REQUIRE(order == visit_order<2>{{0, 0}, {1, 0}, {0, 1},
+                                  {1, 1}, {0, 2}, {1, 2}});
+}
+
+TEST_CASE("tiled", "mapping") {
+  enzen::inline_context inlineContext{};
+
+  auto order = inline_visit_order(
+      enzen::require(inlineContext.executor(), enzen::mapping.tiled(2)),
+      enzen::shape{3, 4});
+
+  // Tiles of 2x2, with the tiles at the last row clipped to 1x2.
+  REQUIRE(order == visit_order<2>{{0, 0}, {0, 1}, {1, 0}, {1, 1},
+                                  {0, 2}, {0, 3}, {1, 2}, {1, 3},
+                                  {2, 0}, {2, 1}, {2, 2}, {2, 3}});
+}
+
+TEST_CASE("morton", "mapping") {
+  enzen::inline_context inlineContext{};
+
+  // Morton tiles of a 2-D space are 32x32, so a 64x64 space has four tiles
+  // visited in Z-order.
+  auto order = inline_visit_order(
+      enzen::require(inlineContext.executor(), enzen::mapping.morton),
+      enzen::shape{64, 64});
+
+  REQUIRE(order.size() == 64 * 64);
+  REQUIRE(order[0] == std::array<std::size_t, 2>{0, 0});
+  REQUIRE(order[1] == std::array<std::size_t, 2>{0, 1});
+  REQUIRE(order[1 * 1024] == std::array<std::size_t, 2>{0, 32});
+  REQUIRE(order[2 * 1024] == std::array<std::size_t, 2>{32, 0});
+  REQUIRE(order[3 * 1024] == std::array<std::size_t, 2>{32, 32});
+}
+
+TEST_CASE("morton_code", "mapping") {
+  REQUIRE(enzen::detail::morton_code<2>({0, 0}) == 0);
+  REQUIRE(enzen::detail::morton_code<2>({0, 1}) == 1);
+  REQUIRE(enzen::detail::morton_code<2>({1, 0}) == 2);
+  REQUIRE(enzen::detail::morton_code<2>({1, 1}) == 3);
+  REQUIRE(enzen::detail::morton_code<2>({0, 2}) == 4);
+  REQUIRE(enzen::detail::morton_code<3>({1, 1, 1}) == 7);
+}
+
+TEST_CASE("range_kernel", "mapping") {
+  enzen::inline_context inlineContext{};
+
+  auto bulkExec = enzen::require_concept(
+      enzen::require(inlineContext.executor(), enzen::mapping.tiled(2, 3)),
+      enzen::bulk_oneway);
+
+  auto ranges = std::vector<enzen::index_range<2>>{};
+  bulkExec.bulk_execute(enzen::range_kernel([&](enzen::index_range<2> range) {
+                          ranges.push_back(range);
+                        }),
+                        enzen::shape{2, 5});
+
+  // One range per row of each tile: 2 rows of [0, 3) then 2 rows of [3, 5).
+  REQUIRE(ranges.size() == 4);
+  REQUIRE(ranges[0].begin() == 0);
+  REQUIRE(ranges[0].end() == 3);
+  REQUIRE(ranges[1][0] == 1);
+  REQUIRE(ranges[1].linear_begin() == 5);
+  REQUIRE(ranges[2].begin() == 3);
+  REQUIRE(ranges[2].end() == 5);
+  REQUIRE(ranges[3].linear_begin() == 8);
+}
+
+TEST_CASE("thread_pool_tiles", "mapping") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto bulkExec = enzen::require_concept(
+      enzen::require(threadPool.executor(), enzen::blocking.always),
+      enzen::bulk_oneway);
+
+  auto execs = {enzen::require(bulkExec, enzen::mapping.column_major),
+                enzen::require(bulkExec, enzen::mapping.tiled(4, 8, 16)),
+                enzen::require(bulkExec, enzen::mapping.morton)};
+
+  for (auto exec : execs) {
+    auto visited = std::vector<std::atomic<int>>(20 * 30 * 40);
+    auto workers = std::vector<std::thread::id>(20 * 30 * 40);
+
+    exec.bulk_execute(
+        [&](enzen::index<3> idx) {
+          visited[idx.linear_id()]++;
+          workers[idx.linear_id()] = std::this_thread::get_id();
+        },
+        enzen::shape{20, 30, 40});
+
+    for (auto &count : visited) {
+      REQUIRE(count == 1);
+    }
+
+    if (enzen::query(exec, enzen::mapping) == enzen::mapping.tiled(4, 8, 16)) {
+      // Every index of a tile runs on the same worker.
+      for (std::size_t i = 0; i < 20; ++i) {
+        for (std::size_t j = 0; j < 30; ++j) {
+          for (std::size_t k = 0; k < 40; ++k) {
+            auto origin = ((i / 4 * 4) * 30 + j / 8 * 8) * 40 + k / 16 * 16;
+            REQUIRE(workers[(i * 30 + j) * 40 + k] == workers[origin]);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("bulk_sender", "mapping") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require_concept(
+      enzen::require(threadPool.executor(), enzen::mapping.morton),
+      enzen::lazy);
+
+  auto visited = std::vector<std::atomic<int>>(100 * 70);
+
+  auto s1 = enzen::via(lazyExec, enzen::just(1));
+  auto s2 = enzen::bulk(s1, enzen::shape{100, 70},
+                        [&visited](enzen::index<2> idx, int value) {
+                          visited[idx[0] * 70 + idx[1]] += value;
+                        });
+
+  auto result = std::atomic<int>{0};
+  enzen::submit(s2, value_receiver{&result});
+
+  threadPool.wait();
+
+  for (auto &count : visited) {
+    REQUIRE(count == 1);
+  }
+  REQUIRE(result == 1);
+}
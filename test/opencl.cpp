@@ -263,7 +263,7 @@ TEST_CASE("bulk_oneway_execute", "opencl") {
 
   bulkOnewayExec.require(enzen::name<kernel<4>>)
       .bulk_execute(
-          [resPtr](enzen ::index idx) {
+          [resPtr](enzen::index<3> idx) {
             resPtr[idx[0]] = static_cast<int>(idx[0]);
           },
           enzen::shape{32, 1, 1});
@@ -288,7 +288,7 @@ TEST_CASE("always_blocking_bulk_oneway_execute", "opencl") {
 
   alwaysBlockingBulkOnewayExec.require(enzen::name<kernel<5>>)
       .bulk_execute(
-          [resPtr](enzen ::index idx) {
+          [resPtr](enzen::index<3> idx) {
             resPtr[idx[0]] = static_cast<int>(idx[0]);
           },
           enzen::shape{32, 1, 1});
@@ -313,7 +313,7 @@ TEST_CASE("never_blocking_bulk_oneway_execute", "opencl") {
 
   neverBlockingBulkOnewayExec.require(enzen::name<kernel<6>>)
       .bulk_execute(
-          [resPtr](enzen ::index idx) {
+          [resPtr](enzen::index<3> idx) {
             resPtr[idx[0]] = static_cast<int>(idx[0]);
           },
           enzen::shape{32, 1, 1});
@@ -0,0 +1,180 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <execution>
+#include <thread>
+
+template <typename ValueType>
+class value_receiver {
+ public:
+  value_receiver(ValueType *valuePtr) : valuePtr_{valuePtr} {};
+
+  void value(ValueType value) { *valuePtr_ = value; }
+
+  template <typename Error>
+  void error(Error &&error) noexcept {}
+
+  void done() {}
+
+ private:
+  ValueType *valuePtr_;
+};
+
+TEST_CASE("poll", "run_loop") {
+  enzen::run_loop runLoop{};
+
+  auto exec = runLoop.executor();
+
+  int res = 0;
+
+  exec.execute([&res]() { res++; });
+  exec.execute([&res]() { res++; });
+
+  REQUIRE(res == 0);
+  REQUIRE(runLoop.poll() == 2);
+  REQUIRE(res == 2);
+  REQUIRE(runLoop.poll() == 0);
+}
+
+TEST_CASE("run_one", "run_loop") {
+  enzen::run_loop runLoop{};
+
+  auto exec = runLoop.executor();
+
+  int res = 0;
+
+  exec.execute([&res]() { res++; });
+  exec.execute([&res]() { res++; });
+
+  REQUIRE(runLoop.run_one() == 1);
+  REQUIRE(res == 1);
+
+  runLoop.finish();
+
+  REQUIRE(runLoop.run_one() == 1);
+  REQUIRE(res == 2);
+  REQUIRE(runLoop.run_one() == 0);
+}
+
+TEST_CASE("run_driving_thread", "run_loop") {
+  enzen::run_loop runLoop{};
+
+  auto exec = runLoop.executor();
+
+  auto drivingThread = std::this_thread::get_id();
+
+  auto numProducers = size_t{4};
+  auto numTasks = size_t{1000};
+
+  std::atomic<size_t> tasksRun = 0;
+  std::atomic<bool> onDrivingThread = true;
+
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < numProducers; ++p) {
+    producers.emplace_back([&]() {
+      for (size_t i = 0; i < numTasks; ++i) {
+        exec.execute([&]() {
+          if (std::this_thread::get_id() != drivingThread) {
+            onDrivingThread = false;
+          }
+          if (++tasksRun == numProducers * numTasks) {
+            runLoop.finish();
+          }
+        });
+      }
+    });
+  }
+
+  runLoop.run();
+
+  for (auto &producer : producers) {
+    producer.join();
+  }
+
+  REQUIRE(tasksRun == numProducers * numTasks);
+  REQUIRE(onDrivingThread);
+}
+
+TEST_CASE("always_blocking_execute", "run_loop") {
+  enzen::run_loop runLoop{};
+
+  auto exec = enzen::require(runLoop.executor(), enzen::blocking.always);
+
+  int res = 0;
+
+  std::thread producer([&]() {
+    exec.execute([&res]() { res = 1234; });
+    runLoop.finish();
+  });
+
+  runLoop.run();
+  producer.join();
+
+  REQUIRE(res == 1234);
+}
+
+TEST_CASE("bulk_oneway_execute", "run_loop") {
+  enzen::run_loop runLoop{};
+
+  auto bulkOnewayExec =
+      enzen::require_concept(runLoop.executor(), enzen::bulk_oneway);
+
+  int res[32] = {-1};
+
+  bulkOnewayExec.bulk_execute(
+      [&res](enzen::index<3> idx) { res[idx[0]] = static_cast<int>(idx[0]); },
+      enzen::shape{32, 1, 1});
+
+  runLoop.poll();
+
+  for (int i = 0; i < 32; ++i) {
+    REQUIRE(res[i] == i);
+  }
+}
+
+TEST_CASE("twoway_execute", "run_loop") {
+  enzen::run_loop runLoop{};
+
+  auto twowayExec = enzen::require_concept(runLoop.executor(), enzen::twoway);
+
+  auto fut = twowayExec.twoway_execute([]() { return 1234; });
+
+  runLoop.poll();
+
+  REQUIRE(fut.get() == 1234);
+}
+
+TEST_CASE("via_and_transform", "run_loop") {
+  enzen::run_loop runLoop{};
+
+  auto lazyExec = enzen::require_concept(runLoop.executor(), enzen::lazy);
+
+  auto s1 = enzen::via(lazyExec, enzen::just(21));
+
+  auto s2 = enzen::transform(s1, [=](int value) { return value * 2; });
+
+  int res = 0;
+  submit(s2, value_receiver{&res});
+
+  REQUIRE(res == 0);
+
+  runLoop.poll();
+
+  REQUIRE(res == 42);
+}
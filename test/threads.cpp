@@ -19,8 +19,12 @@ limitations under the License.
 
 // #define ENZEN_VERBOSE
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <execution>
+#include <mutex>
+#include <set>
 #include <thread>
 
 using namespace std::chrono_literals;
@@ -170,6 +174,41 @@ TEST_CASE("require_blocking_never", "thread_pool") {
           enzen::blocking.always);
 }
 
+TEST_CASE("static_query_blocking", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto exec = threadPool.executor();
+
+  auto neverBlockingExec = enzen::require(exec, enzen::blocking.never);
+
+  using executor_t = decltype(exec);
+  using never_blocking_executor_t = decltype(neverBlockingExec);
+
+  static_assert(!std::is_same_v<executor_t, never_blocking_executor_t>);
+  static_assert(enzen::blocking_t::static_query_v<executor_t> ==
+                enzen::blocking.possibly);
+  static_assert(enzen::blocking_t::static_query_v<never_blocking_executor_t> ==
+                enzen::blocking.never);
+  static_assert(enzen::blocking_t::never_t::static_query_v<
+                    never_blocking_executor_t> == enzen::blocking.never);
+
+  REQUIRE(enzen::query(neverBlockingExec, enzen::blocking.never) ==
+          enzen::blocking.never);
+}
+
+TEST_CASE("executor_equality", "thread_pool") {
+  auto threadPool = enzen::static_thread_pool{1};
+  auto otherThreadPool = enzen::static_thread_pool{1};
+
+  auto exec = threadPool.executor();
+  auto execCopy = exec;
+
+  REQUIRE(exec == execCopy);
+  REQUIRE(exec == threadPool.executor());
+  REQUIRE(!(exec == otherThreadPool.executor()));
+}
+
 TEST_CASE("require_blocking_possibly", "thread_pool") {
   auto threadPool =
       enzen::static_thread_pool{std::thread::hardware_concurrency()};
@@ -275,7 +314,7 @@ TEST_CASE("bulk_oneway_execute", "thread_pool") {
   int res[32] = {-1};
 
   bulkOnewayExec.bulk_execute(
-      [&res](enzen ::index idx) { res[idx[0]] = static_cast<int>(idx[0]); },
+      [&res](enzen::index<3> idx) { res[idx[0]] = static_cast<int>(idx[0]); },
       enzen::shape{32, 1, 1});
 
   for (int i = 0; i < 32; ++i) {
@@ -297,7 +336,7 @@ TEST_CASE("always_blocking_bulk_oneway_execute", "thread_pool") {
   int res[32] = {-1};
 
   alwaysBlockingBulkOnewayExec.bulk_execute(
-      [&res](enzen ::index idx) {
+      [&res](enzen::index<3> idx) {
         res[idx[0]] = static_cast<int>(idx[0]);
         std::this_thread::sleep_for(1s);
       },
@@ -322,7 +361,7 @@ TEST_CASE("never_blocking_bulk_oneway_execute", "thread_pool") {
   int res[32] = {-1};
 
   neverBlockingBulkOnewayExec.bulk_execute(
-      [&res](enzen ::index idx) {
+      [&res](enzen::index<3> idx) {
         res[idx[0]] = static_cast<int>(idx[0]);
         std::this_thread::sleep_for(1s);
       },
@@ -381,3 +420,430 @@ TEST_CASE("via_and_transform", "thread_pool") {
 
   REQUIRE(res == 42);
 }
+
+TEST_CASE("chained_transform", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto exec = threadPool.executor();
+
+  auto lazyExec = enzen::require_concept(exec, enzen::lazy);
+
+  auto s1 = enzen::via(lazyExec, enzen::just(2));
+
+  auto s2 = enzen::transform(s1, [=](int value) { return value * 3; });
+
+  auto s3 = enzen::transform(s2, [=](int value) { return value + 1; });
+
+  auto s4 = enzen::transform(s3, [=](int value) { return value * 6; });
+
+  REQUIRE(std::is_same_v<typename decltype(s4)::value_t, int>);
+
+  int res = 0;
+  submit(s4, value_receiver{&res});
+
+  REQUIRE(res == 42);
+}
+
+TEST_CASE("bulk_sender", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto exec = threadPool.executor();
+
+  auto lazyExec = enzen::require_concept(exec, enzen::lazy);
+
+  std::atomic<int> visited[32] = {};
+
+  auto s1 = enzen::via(lazyExec, enzen::just(2));
+
+  auto s2 = enzen::bulk(s1, enzen::shape{4, 4, 2},
+                        [&visited](enzen::index<3> idx, int value) {
+                          visited[(idx[0] * 4 + idx[1]) * 2 + idx[2]] += value;
+                        });
+
+  auto s3 = enzen::transform(s2, [=](int value) { return value * 21; });
+
+  int res = 0;
+  submit(s3, value_receiver{&res});
+
+  threadPool.wait();
+
+  for (int i = 0; i < 32; ++i) {
+    REQUIRE(visited[i] == 2);
+  }
+  REQUIRE(res == 42);
+}
+
+TEST_CASE("bulk_1d", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec =
+      enzen::require_concept(threadPool.executor(), enzen::lazy);
+
+  std::atomic<int> visited[37] = {};
+
+  auto s1 = enzen::via(lazyExec, enzen::just(3));
+
+  auto s2 = enzen::bulk(s1, enzen::shape{37},
+                        [&visited](enzen::index<1> idx, int value) {
+                          visited[idx.linear_id()] += value;
+                        });
+
+  int res = 0;
+  submit(s2, value_receiver{&res});
+
+  threadPool.wait();
+
+  for (int i = 0; i < 37; ++i) {
+    REQUIRE(visited[i] == 3);
+  }
+  REQUIRE(res == 3);
+}
+
+TEST_CASE("bulk_oneway_execute_range", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto bulkOnewayExec =
+      enzen::require_concept(threadPool.executor(), enzen::bulk_oneway);
+
+  auto res = std::vector<float>(1000, 1.0f);
+
+  bulkOnewayExec.bulk_execute(
+      enzen::range_kernel(
+          [ptr = res.data()](enzen::index_range<1> range) {
+            for (auto i = range.begin(); i < range.end(); ++i) {
+              ptr[i] = static_cast<float>(i) * 2.0f;
+            }
+          }),
+      enzen::shape{res.size()});
+
+  for (std::size_t i = 0; i < res.size(); ++i) {
+    REQUIRE(res[i] == static_cast<float>(i) * 2.0f);
+  }
+}
+
+TEST_CASE("bulk_range", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec =
+      enzen::require_concept(threadPool.executor(), enzen::lazy);
+
+  std::atomic<int> visited[6][7] = {};
+
+  auto s1 = enzen::via(lazyExec, enzen::just(5));
+
+  auto s2 = enzen::bulk(
+      s1, enzen::shape{6, 7},
+      enzen::range_kernel([&visited](enzen::index_range<2> range, int value) {
+        for (auto j = range.begin(); j < range.end(); ++j) {
+          visited[range[0]][j] += value;
+        }
+      }));
+
+  int res = 0;
+  submit(s2, value_receiver{&res});
+
+  threadPool.wait();
+
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j < 7; ++j) {
+      REQUIRE(visited[i][j] == 5);
+    }
+  }
+  REQUIRE(res == 5);
+}
+
+TEST_CASE("let_value", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto exec = threadPool.executor();
+
+  auto lazyExec = enzen::require_concept(exec, enzen::lazy);
+
+  auto neverBlockingLazyExec = enzen::require(lazyExec, enzen::blocking.never);
+
+  auto s1 = enzen::via(neverBlockingLazyExec, enzen::just(7));
+
+  auto s2 = enzen::let_value(s1, [=](int value) {
+    return enzen::transform(
+        enzen::via(neverBlockingLazyExec, enzen::just(value * 3)),
+        [=](int value) { return value * 2; });
+  });
+
+  REQUIRE(std::is_same_v<typename decltype(s2)::value_t, int>);
+
+  int res = 0;
+  submit(s2, value_receiver{&res});
+
+  threadPool.wait();
+
+  REQUIRE(res == 42);
+}
+
+TEST_CASE("let_value_error", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto lazyExec = enzen::require(
+      enzen::require_concept(threadPool.executor(), enzen::lazy),
+      enzen::blocking.never);
+
+  auto s1 = enzen::via(lazyExec, enzen::just(7));
+
+  auto s2 = enzen::let_value(s1, [=](int value) {
+    if (value == 7) {
+      throw std::runtime_error("error");
+    }
+    return enzen::via(lazyExec, enzen::just(value));
+  });
+
+  REQUIRE_THROWS_AS(enzen::sync_wait(s2), std::runtime_error);
+}
+
+TEST_CASE("sync_get", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto exec = threadPool.executor();
+
+  auto lazyExec =
+      enzen::require(enzen::require_concept(exec, enzen::lazy),
+                     enzen::blocking.never);
+
+  auto s1 = enzen::via(lazyExec, enzen::just(21));
+
+  auto s2 = enzen::transform(s1, [=](int value) { return value * 2; });
+
+  REQUIRE(enzen::sync_get(s2) == 42);
+}
+
+TEST_CASE("sync_wait_error", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto exec = threadPool.executor();
+
+  auto lazyExec =
+      enzen::require(enzen::require_concept(exec, enzen::lazy),
+                     enzen::blocking.never);
+
+  auto s1 = enzen::via(lazyExec, enzen::just(21));
+
+  auto s2 = enzen::transform(s1, [=](int value) -> int {
+    throw std::runtime_error("error");
+  });
+
+  REQUIRE_THROWS_AS(enzen::sync_wait(s2), std::runtime_error);
+}
+
+namespace {
+
+// Task which completes inline, and records an exception thrown by the
+// receiver instead of propagating it.
+class throwing_upstream_task {
+ public:
+  using executor_t = enzen::static_thread_pool_executor;
+  using value_t = int;
+
+  throwing_upstream_task(std::atomic<int> *escaped) : escaped_{escaped} {}
+
+  template <typename Receiver>
+  void submit(Receiver receiver) {
+    try {
+      enzen::set_value(receiver, 21);
+    } catch (...) {
+      (*escaped_)++;
+    }
+  }
+
+ private:
+  std::atomic<int> *escaped_;
+};
+
+class throwing_receiver {
+ public:
+  throwing_receiver(std::atomic<int> *values, std::atomic<int> *errors)
+      : values_{values}, errors_{errors} {}
+
+  void value(int) {
+    (*values_)++;
+    throw std::runtime_error("error");
+  }
+
+  template <typename Error>
+  void error(Error &&) noexcept {
+    (*errors_)++;
+  }
+
+  void done() {}
+
+ private:
+  std::atomic<int> *values_;
+  std::atomic<int> *errors_;
+};
+
+}  // namespace
+
+TEST_CASE("transform_receiver_throws", "thread_pool") {
+  auto escaped = std::atomic<int>{0};
+  auto values = std::atomic<int>{0};
+  auto errors = std::atomic<int>{0};
+
+  auto function = [](int value) { return value * 2; };
+  auto s1 = enzen::thread_pool_transform_task<throwing_upstream_task,
+                                              decltype(function)>{
+      throwing_upstream_task{&escaped}, function};
+
+  // An exception thrown by the downstream receiver is not also delivered to
+  // it as an error.
+  enzen::submit(s1, throwing_receiver{&values, &errors});
+
+  REQUIRE(values == 1);
+  REQUIRE(errors == 0);
+  REQUIRE(escaped == 1);
+}
+
+TEST_CASE("stats", "thread_pool") {
+  auto threadPool = enzen::static_thread_pool{2};
+
+  auto exec = enzen::require(threadPool.executor(), enzen::blocking.never);
+
+  for (int i = 0; i < 16; ++i) {
+    exec.execute(
+        []() { std::this_thread::sleep_for(std::chrono::microseconds(100)); });
+  }
+  threadPool.wait();
+
+  auto stats = threadPool.stats();
+
+  REQUIRE(stats.workers.size() == 2);
+  REQUIRE(stats.queue_depth == 0);
+  REQUIRE(stats.running_tasks == 0);
+  REQUIRE(stats.tasks_executed() == 16);
+
+  auto busyTime = std::chrono::nanoseconds{0};
+  for (auto &worker : stats.workers) {
+    busyTime += worker.busy_time;
+  }
+  REQUIRE(busyTime >= std::chrono::microseconds(16 * 100));
+}
+
+TEST_CASE("auto_partition_claims", "thread_pool") {
+  auto learnedGrainSize = std::atomic<std::size_t>{0};
+  auto partition = enzen::detail::auto_partition{1000, 4, learnedGrainSize};
+
+  REQUIRE(partition.num_tasks() == 4);
+
+  // Chunks cover the iteration space in order, starting coarse and shrinking
+  // as it runs out.
+  auto begin = std::size_t{0};
+  auto end = std::size_t{0};
+  auto chunks = std::vector<std::size_t>{};
+  auto next = std::size_t{0};
+  while (partition.claim(begin, end)) {
+    REQUIRE(begin == next);
+    chunks.push_back(end - begin);
+    next = end;
+  }
+  REQUIRE(next == 1000);
+  REQUIRE(chunks.front() == 125);
+  REQUIRE(chunks.back() == 1);
+  for (std::size_t i = 1; i < chunks.size(); ++i) {
+    REQUIRE(chunks[i] <= chunks[i - 1]);
+  }
+
+  // A learned grain size bounds the size of the chunks and the number of
+  // tasks.
+  learnedGrainSize = 400;
+  auto coarsePartition =
+      enzen::detail::auto_partition{1000, 4, learnedGrainSize};
+  REQUIRE(coarsePartition.num_tasks() == 3);
+  REQUIRE(coarsePartition.claim(begin, end));
+  REQUIRE(end - begin == 400);
+  REQUIRE(coarsePartition.claim(begin, end));
+  REQUIRE(end - begin == 400);
+  REQUIRE(coarsePartition.claim(begin, end));
+  REQUIRE(end - begin == 200);
+  REQUIRE(!coarsePartition.claim(begin, end));
+}
+
+TEST_CASE("auto_partition_grain_feedback", "thread_pool") {
+  auto threadPool =
+      enzen::static_thread_pool{std::thread::hardware_concurrency()};
+
+  auto bulkExec = enzen::require(
+      enzen::require_concept(threadPool.executor(), enzen::bulk_oneway),
+      enzen::blocking.always);
+
+  auto cheapExec = enzen::require(bulkExec, enzen::name<kernel<100>>);
+  auto costlyExec = enzen::require(bulkExec, enzen::name<kernel<101>>);
+
+  auto &cheapGrainSize = enzen::detail::learned_grain_size<kernel<100>>();
+  auto &costlyGrainSize = enzen::detail::learned_grain_size<kernel<101>>();
+  REQUIRE(cheapGrainSize == 0);
+  REQUIRE(costlyGrainSize == 0);
+
+  auto cheap = std::vector<int>(1 << 20);
+  auto costly = std::vector<int>(256);
+  for (int launch = 0; launch < 3; ++launch) {
+    cheapExec.bulk_execute(
+        [ptr = cheap.data()](enzen::index<1> idx) { ptr[idx[0]] += 1; },
+        enzen::shape{cheap.size()});
+    costlyExec.bulk_execute(
+        [ptr = costly.data()](enzen::index<1> idx) {
+          std::this_thread::sleep_for(std::chrono::microseconds(10));
+          ptr[idx[0]] += 1;
+        },
+        enzen::shape{costly.size()});
+  }
+
+  REQUIRE(std::count(cheap.begin(), cheap.end(), 3) ==
+          static_cast<std::ptrdiff_t>(cheap.size()));
+  REQUIRE(std::count(costly.begin(), costly.end(), 3) ==
+          static_cast<std::ptrdiff_t>(costly.size()));
+
+  // Each kernel keeps its own grain size, which is smaller the longer an
+  // invocation takes.
+  REQUIRE(cheapGrainSize > 0);
+  REQUIRE(costlyGrainSize > 0);
+  REQUIRE(costlyGrainSize < 100);
+  REQUIRE(cheapGrainSize > costlyGrainSize);
+}
+
+TEST_CASE("auto_partition_never_blocking", "thread_pool") {
+  auto threadPool = enzen::static_thread_pool{4};
+
+  auto bulkExec = enzen::require(
+      enzen::require_concept(threadPool.executor(), enzen::bulk_oneway),
+      enzen::blocking.never);
+
+  auto mutex = std::mutex{};
+  auto workers = std::set<std::thread::id>{};
+  auto completed = std::atomic<std::size_t>{0};
+
+  // Once the workers have parked, the launch wakes more than one of them
+  // without the host waiting on the pool.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  bulkExec.bulk_execute(
+      [&](enzen::index<1>) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        {
+          auto lock = std::lock_guard<std::mutex>{mutex};
+          workers.insert(std::this_thread::get_id());
+        }
+        completed++;
+      },
+      enzen::shape{2000});
+
+  while (completed < 2000) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  REQUIRE(workers.size() > 1);
+  threadPool.wait();
+}
@@ -0,0 +1,96 @@
+/*
+Copyright 2018 - 2019 Gordon Brown
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <execution>
+
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::size_t count_occurrences(const std::string &str, const std::string &sub) {
+  auto count = std::size_t{0};
+  for (auto pos = str.find(sub); pos != std::string::npos;
+       pos = str.find(sub, pos + sub.size())) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST_CASE("thread_pool_events", "trace") {
+  enzen::clear_trace();
+
+  {
+    enzen::static_thread_pool threadPool{2};
+
+    auto exec = enzen::require(threadPool.executor(), enzen::blocking.never);
+    for (int i = 0; i < 8; ++i) {
+      exec.execute([]() {});
+    }
+    threadPool.wait();
+  }
+
+  auto os = std::ostringstream{};
+  enzen::write_trace(os);
+  auto trace = os.str();
+
+  REQUIRE(trace.rfind("{\"traceEvents\":[", 0) == 0);
+  REQUIRE(count_occurrences(trace, "\"name\":\"enqueue\"") == 8);
+  REQUIRE(count_occurrences(trace, "\"name\":\"dequeue\"") == 8);
+  REQUIRE(count_occurrences(trace, "\"ph\":\"B\"") == 8);
+  REQUIRE(count_occurrences(trace, "\"ph\":\"E\"") == 8);
+  REQUIRE(count_occurrences(trace, "\"name\":\"park\"") > 0);
+  REQUIRE(count_occurrences(trace, "\"name\":\"worker 0\"") == 1);
+  REQUIRE(count_occurrences(trace, "\"name\":\"worker 1\"") == 1);
+}
+
+TEST_CASE("clear", "trace") {
+  {
+    enzen::static_thread_pool threadPool{1};
+    enzen::require(threadPool.executor(), enzen::blocking.always)
+        .execute([]() {});
+  }
+
+  enzen::clear_trace();
+
+  auto os = std::ostringstream{};
+  enzen::write_trace(os);
+
+  REQUIRE(count_occurrences(os.str(), "\"ph\":\"B\"") == 0);
+}
+
+TEST_CASE("buffer_wraps", "trace") {
+  enzen::clear_trace();
+
+  auto eventsRecorded = enzen::detail::trace_buffer::capacity + 16;
+  for (std::size_t i = 0; i < eventsRecorded; ++i) {
+    ENZEN_TRACE_EVENT(steal, i)
+  }
+
+  auto os = std::ostringstream{};
+  enzen::write_trace(os);
+  auto trace = os.str();
+
+  REQUIRE(count_occurrences(trace, "\"name\":\"steal\"") ==
+          enzen::detail::trace_buffer::capacity);
+  REQUIRE(trace.find("\"arg\":15}") == std::string::npos);
+  REQUIRE(trace.find("\"arg\":16}") != std::string::npos);
+}